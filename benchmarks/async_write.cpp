@@ -0,0 +1,125 @@
+// Overlap of chunk encoding and file output: ofstream against AsyncWriter.
+//
+// Usage: ./async_write [num_floats] [codec raw|bitpack|split|gzip] [output.lfc] [buffer_mb]
+//
+// The same array is written as an .lfc container (10 bits zeroed) by one
+// encoding thread. "compute" only encodes the chunks and "disk" only writes
+// the already encoded chunks; the other rows do both, through a blocking
+// ofstream or an AsyncWriter on each backend, with and without O_DIRECT.
+// A writer that overlaps the two approaches max(compute, disk); a blocking
+// one takes their sum. The stall column is the time the encoder waited for
+// a free buffer. Every file must be identical to the ofstream one.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lossy/container.h"
+#include "lossy/distributions.h"
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point t0) { return std::chrono::duration<double>(Clock::now() - t0).count(); }
+
+int main(int argc, char **argv) {
+    try {
+        size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(64) << 20;
+        std::string codec = argc > 2 ? argv[2] : "bitpack";
+        std::string output = argc > 3 ? argv[3] : "async_write.lfc";
+        size_t buffer_mb = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 4;
+
+        lossy::ContainerOptions opt;
+        opt.bits_to_zero = 10;
+        opt.chunk_elements = size_t(1) << 18;
+        if (codec == "raw") opt.codec = lossy::Codec::Raw;
+        else if (codec == "bitpack") opt.codec = lossy::Codec::BitPack;
+        else if (codec == "split") opt.codec = lossy::Codec::Split;
+        else if (codec == "gzip") opt.codec = lossy::Codec::Gzip;
+        else throw std::runtime_error("unknown codec " + codec);
+        if (opt.codec == lossy::Codec::BitPack || opt.codec == lossy::Codec::Split) opt.shuffle = lossy::Shuffle::None;
+
+        std::vector<float> data = lossy::generate<float, lossy::Gaussian>(N);
+        const double mb = N * sizeof(float) / 1e6;
+        std::cout << "Elements: " << N << " (" << mb << " MB), codec " << codec << ", chunk " << opt.chunk_elements
+                  << ", buffers 2 x " << buffer_mb << " MB\n\n";
+
+        auto t0 = Clock::now();
+        std::vector<lossy::EncodedChunk> chunks;
+        for (size_t first = 0; first < N; first += opt.chunk_elements)
+            chunks.push_back(lossy::encode_chunk(data.data() + first, std::min(opt.chunk_elements, N - first), first, opt));
+        double compute_s = secondsSince(t0);
+
+        t0 = Clock::now();
+        {
+            lossy::ContainerWriter writer(output, opt);
+            for (const lossy::EncodedChunk &c : chunks) writer.write_encoded(c);
+        }
+        double disk_s = secondsSince(t0);
+        chunks.clear();
+
+        std::cout << std::left << std::setw(26) << "writer" << std::right << std::setw(9) << "seconds" << std::setw(10)
+                  << "MB/s" << std::setw(9) << "stall s" << std::setw(15) << "vs max(c,d)" << "  file\n";
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << std::left << std::setw(26) << "compute only" << std::right << std::setw(9) << compute_s
+                  << std::setw(10) << std::setprecision(0) << mb / compute_s << "\n";
+        std::cout << std::left << std::setw(26) << "disk only" << std::right << std::setprecision(3) << std::setw(9)
+                  << disk_s << std::setw(10) << std::setprecision(0) << mb / disk_s << "\n";
+
+        uint32_t expected = 0;
+        bool identical = true;
+        auto row = [&](const std::string &name, const lossy::AsyncWriterOptions *io) {
+            auto start = Clock::now();
+            double stall = 0;
+            std::string label = name;
+            {
+                std::unique_ptr<lossy::ContainerWriter> writer =
+                    io ? std::make_unique<lossy::ContainerWriter>(output, opt, *io)
+                       : std::make_unique<lossy::ContainerWriter>(output, opt);
+                writer->write(data);
+                writer->close();
+                // The label names what was used: the backend and O_DIRECT fall back when refused
+                if (const lossy::AsyncWriter *a = writer->async_writer()) {
+                    stall = a->stall_seconds();
+                    label = std::string("async ") + lossy::io_backend_name(a->backend()) + (a->direct() ? " O_DIRECT" : "");
+                }
+            }
+            double s = secondsSince(start);
+            uint32_t crc = lossy::file_crc32(output);
+            if (!io) expected = crc;
+            identical = identical && crc == expected;
+            std::cout << std::left << std::setw(26) << label << std::right << std::setprecision(3) << std::setw(9) << s
+                      << std::setw(10) << std::setprecision(0) << mb / s << std::setprecision(3) << std::setw(9)
+                      << stall << std::setw(14) << std::setprecision(2) << s / std::max(compute_s, disk_s) << "x  "
+                      << std::hex << crc << std::dec << "\n";
+        };
+
+        row("ofstream", nullptr);
+        for (lossy::IoBackend backend : {lossy::IoBackend::Thread, lossy::IoBackend::IoUring}) {
+            for (bool direct : {false, true}) {
+                lossy::AsyncWriterOptions io;
+                io.backend = backend;
+                io.direct = direct;
+                io.buffer_bytes = buffer_mb << 20;
+                try {
+                    row("async", &io);
+                } catch (const std::runtime_error &e) {
+                    std::cout << "async " << lossy::io_backend_name(backend) << ": " << e.what() << "\n";
+                }
+            }
+        }
+        std::cout << std::setprecision(3) << "\nSum of compute and disk: " << compute_s + disk_s << " s\n";
+
+        std::remove(output.c_str());
+        std::cout << "Files identical to ofstream: " << (identical ? "yes" : "NO") << "\n";
+        return identical ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// Timing and report lines shared by the throughput benchmarks.
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+//This is to time `fn` and return the best of `reps` runs in seconds
+template <typename Fn>
+double bestOf(int reps, Fn &&fn) {
+    double best = 1e300;
+    for (int r = 0; r < reps; r++) {
+        auto t0 = Clock::now();
+        fn();
+        auto t1 = Clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+//This is to print one timed run: milliseconds, then `count` per second in units of `scale`
+inline void reportRate(const std::string &name, double count, double seconds, double scale, const char *unit) {
+    std::cout << std::left << std::setw(30) << name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << seconds * 1e3 << " ms" << std::setprecision(2) << std::setw(10)
+              << count / seconds / scale << " " << unit << "\n";
+}
+
+//This is to print one codec: ratio, then encode and decode GB/s of `bytes` of input
+inline void reportCodec(const std::string &name, double ratio, double bytes, double encode_s, double decode_s) {
+    std::cout << "  " << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(3)
+              << "ratio " << std::setw(7) << ratio << "  enc " << std::setw(7) << bytes / encode_s / 1e9
+              << " GB/s  dec " << std::setw(7) << bytes / decode_s / 1e9 << " GB/s\n";
+}
@@ -0,0 +1,67 @@
+// Dense bit-packing of truncated floats against gzip of the zeroed array.
+//
+// Usage: ./bitpack_throughput [num_floats] [repetitions]
+//
+// For each LSB-zeroing level the table shows the packed size (exactly
+// 32 - bits_to_zero bits per value) and the pack/unpack GB/s of the portable
+// and the BMI2 pext/pdep kernels, next to byte-shuffle + gzip of the same
+// masked array, and memcpy as the bandwidth ceiling. Every round trip is
+// checked against mask_lsb().
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lossy/bitpack.h"
+#include "lossy/deflate.h"
+#include "lossy/distributions.h"
+#include "lossy/mask.h"
+
+#include "bench_util.h"
+
+int main(int argc, char **argv) {
+    try {
+        size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(16) << 20;
+        int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+        std::vector<float> data = lossy::generate<float, lossy::Gaussian>(N);
+        std::vector<float> masked(N), restored(N);
+        std::vector<unsigned char> packed(lossy::packed_float_bytes(N, 0));
+        const double bytes = double(N) * sizeof(float);
+        const uint32_t *words = reinterpret_cast<const uint32_t *>(masked.data());
+        uint32_t *out = reinterpret_cast<uint32_t *>(restored.data());
+        bool ok = true;
+
+        std::cout << "Elements: " << N << " (" << N * sizeof(float) / (1024.0 * 1024) << " MB), gaussian, BMI2 "
+                  << (lossy::cpu_has_bmi2() ? "yes" : "no") << "\n";
+        double copy_s = bestOf(reps, [&] { std::memcpy(restored.data(), data.data(), N * sizeof(float)); });
+        reportCodec("memcpy", 1.0, bytes, copy_s, copy_s);
+        std::cout << "\n";
+
+        for (int bits : {0, 4, 8, 10, 13, 16, 20, 23}) {
+            lossy::mask_lsb(data.data(), masked.data(), N, bits);
+            const uint32_t mask = ~uint32_t(0) << bits;
+            const size_t size = lossy::packed_float_bytes(N, bits);
+            std::cout << bits << " bits zeroed (" << 32 - bits << " bits per value):\n";
+
+            for (bool bmi2 : {false, true}) {
+                if (bmi2 && !lossy::cpu_has_bmi2()) continue;
+                double encode_s = bestOf(reps, [&] { lossy::pack_fields(words, N, mask, packed.data(), bmi2); });
+                double decode_s = bestOf(reps, [&] { lossy::unpack_fields(packed.data(), size, N, mask, out, bmi2); });
+                reportCodec(bmi2 ? "pack (pext)" : "pack (shift)", bytes / size, bytes, encode_s, decode_s);
+                ok = ok && std::memcmp(masked.data(), restored.data(), N * sizeof(float)) == 0;
+            }
+            lossy::DeflateStats gz = lossy::measure_gzip(masked.data(), N, lossy::Shuffle::Byte);
+            reportCodec("shuffle-gzip", gz.ratio(), bytes, bytes / 1e6 / gz.compress_mbps,
+                        bytes / 1e6 / gz.decompress_mbps);
+        }
+        std::cout << "Bit-pack round trips exact: " << (ok ? "yes" : "NO") << "\n";
+        return ok ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,105 @@
+// Gorilla XOR codec against gzip on slowly varying and on i.i.d. data.
+//
+// Usage: ./gorilla_throughput [num_floats] [repetitions]
+//
+// For each LSB-zeroing level the table shows the compression ratio and
+// encode/decode GB/s of Gorilla, gzip and byte-shuffle + gzip (best of the
+// repetitions, buffers reused). The last lines time the bit writer/reader on
+// their own with random 1..32-bit fields, and a window header that overflows
+// 32 bits must be rejected.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lossy/deflate.h"
+#include "lossy/distributions.h"
+#include "lossy/gorilla.h"
+#include "lossy/mask.h"
+
+#include "bench_util.h"
+
+//This is to compare the codecs on one distribution; returns false if a Gorilla round trip differs
+template <typename Dist>
+bool runDistribution(size_t N, int reps) {
+    std::vector<float> data = lossy::generate<float, Dist>(N);
+    std::vector<float> masked(N), restored(N);
+    std::vector<unsigned char> packed(lossy::gorilla_bound(N));
+    const double bytes = double(N) * sizeof(float);
+    bool ok = true;
+
+    for (int bits : {0, 8, 12, 16}) {
+        lossy::mask_lsb(data.data(), masked.data(), N, bits);
+        std::cout << Dist::name << ", " << bits << " bits zeroed:\n";
+
+        size_t size = 0;
+        double encode_s = bestOf(reps, [&] { size = lossy::gorilla_encode(masked.data(), N, packed.data()); });
+        double decode_s = bestOf(reps, [&] { lossy::gorilla_decode(packed.data(), size, restored.data(), N); });
+        reportCodec("gorilla", bytes / size, bytes, encode_s, decode_s);
+        ok = ok && std::memcmp(masked.data(), restored.data(), N * sizeof(float)) == 0;
+
+        for (lossy::Shuffle mode : {lossy::Shuffle::None, lossy::Shuffle::Byte}) {
+            lossy::DeflateStats gz = lossy::measure_gzip(masked.data(), N, mode);
+            std::string name = mode == lossy::Shuffle::None ? "gzip" : "shuffle-gzip";
+            reportCodec(name, gz.ratio(), bytes, bytes / 1e6 / gz.compress_mbps, bytes / 1e6 / gz.decompress_mbps);
+        }
+    }
+    std::cout << "\n";
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(16) << 20;
+    int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+    std::cout << "Elements: " << N << " (" << N * sizeof(float) / (1024.0 * 1024) << " MB)\n\n";
+    bool ok = runDistribution<lossy::Timeseries>(N, reps);
+    ok = runDistribution<lossy::Gaussian>(N, reps) && ok;
+
+    // Bit I/O alone: random field widths like the Gorilla codes
+    std::vector<int> widths(N);
+    std::vector<uint32_t> words(N);
+    lossy::fill_uniform(lossy::kDefaultSeed, reinterpret_cast<float *>(words.data()), N);
+    size_t total_bits = 0;
+    for (size_t i = 0; i < N; i++) {
+        words[i] = lossy::float_bits(reinterpret_cast<float *>(words.data())[i]);
+        widths[i] = 1 + int(words[i] % 32);
+        total_bits += size_t(widths[i]);
+    }
+    std::vector<unsigned char> stream(total_bits / 8 + 16);
+    double write_s = bestOf(reps, [&] {
+        lossy::BitWriter writer(stream.data());
+        for (size_t i = 0; i < N; i++) writer.put(words[i] & lossy::BitReader::low_bits(widths[i]), widths[i]);
+        writer.finish();
+    });
+    volatile uint64_t sink = 0;
+    double read_s = bestOf(reps, [&] {
+        lossy::BitReader reader(stream.data(), stream.size());
+        uint64_t sum = 0;
+        for (size_t i = 0; i < N; i++) sum += reader.get(widths[i]);
+        sink = sum;
+    });
+    (void)sink;
+    std::cout << "Bit I/O, 1..32-bit fields: write " << std::setprecision(2) << N / write_s / 1e6 << " M fields/s ("
+              << total_bits / 8.0 / write_s / 1e9 << " GB/s), read " << N / read_s / 1e6 << " M fields/s ("
+              << total_bits / 8.0 / read_s / 1e9 << " GB/s)\n";
+    std::cout << "Gorilla round trips exact: " << (ok ? "yes" : "NO") << "\n";
+
+    // A zero first value, then a new window with lead 31 and len 32
+    std::vector<unsigned char> bad(16, 0);
+    bad[4] = 0xff;
+    bad[5] = 0x0f;
+    bool rejected = false;
+    try {
+        float restored[2];
+        lossy::gorilla_decode(bad.data(), bad.size(), restored, 2);
+    } catch (const std::runtime_error &) {
+        rejected = true;
+    }
+    std::cout << "Malformed window rejected: " << (rejected ? "yes" : "NO") << "\n";
+    return ok && rejected ? 0 : 1;
+}
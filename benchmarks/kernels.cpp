@@ -0,0 +1,346 @@
+// Microbenchmark of every hot kernel across cache levels, with JSON output.
+//
+// Usage: ./kernels [--sizes 16K,256K,4M,64M,256M] [--reps 11] [--warmup 2]
+//                  [--filter mask] [--dir /tmp] [--out kernels] [--baseline old.json]
+//
+// Each size is the float32 input of one call (K/M/G suffixes are powers of
+// two), from L1-resident up to DRAM-sized. Every (kernel, size) point is
+// warmed up, then timed `reps` times; a sample repeats the call until it
+// covers at least 200 us, so L1-sized points are not timer noise. The table
+// and <out>.json give the median, 10th and 90th percentile and best time
+// per element and the traffic GB/s at the median, next to a memcpy of the
+// same buffer. --filter keeps kernels whose name contains the text. With
+// --baseline, the speedup of each median over a previous JSON file (another
+// build or CPU) is printed, and points slower by more than 5% are flagged.
+//
+// Kernels: the legacy compress() loop and mask_lsb() at every SIMD level,
+// truncate<10>, round_lsb() RNE, float_to_half()/half_to_float() on every
+// path, the legacy MSE + mean/std loops and compute_metrics(), and the file
+// writers write_binary() and an .lfc ContainerWriter (bitpack). The writers
+// go to --dir and mostly measure the page cache.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "lossy/container.h"
+#include "lossy/distributions.h"
+#include "lossy/experiments.h"
+#include "lossy/half.h"
+#include "lossy/mask.h"
+#include "lossy/metrics.h"
+#include "lossy/rounding.h"
+#include "lossy/truncate.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Shortest sample; shorter calls are repeated inside one sample
+constexpr double kMinSampleSeconds = 200e-6;
+
+struct Kernel {
+    std::string name;
+    double bytes_per_element; // traffic of one element: bytes read + bytes written
+    std::function<void(size_t)> run;
+};
+
+struct Point {
+    std::string kernel;
+    size_t bytes = 0;    // float32 input of one call
+    size_t elements = 0;
+    int reps = 0;
+    size_t calls_per_rep = 0;
+    double median_ns = 0, p10_ns = 0, p90_ns = 0, min_ns = 0; // per call
+    double gbps = 0;     // traffic at the median
+};
+
+//This is the compress() loop of og-vs-com_gzip.cpp before the kernels existed
+std::vector<float> legacyCompress(const float *data, size_t n, int bits_to_zero) {
+    std::vector<float> compressed;
+    uint32_t mask = ~((1u << bits_to_zero) - 1);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, &data[i], sizeof bits);
+        bits &= mask;
+        float out;
+        std::memcpy(&out, &bits, sizeof out);
+        compressed.push_back(out);
+    }
+    return compressed;
+}
+
+//This is calculateMSE() + compute_stats() of both arrays from distributions_mse.cpp
+double legacyMetrics(const float *a, const float *b, size_t n) {
+    double mse = 0.0, mean_a = 0.0, mean_b = 0.0, var_a = 0.0, var_b = 0.0;
+    for (size_t i = 0; i < n; i++) mse += (double(a[i]) - b[i]) * (double(a[i]) - b[i]);
+    for (size_t i = 0; i < n; i++) mean_a += a[i];
+    for (size_t i = 0; i < n; i++) mean_b += b[i];
+    mean_a /= n;
+    mean_b /= n;
+    for (size_t i = 0; i < n; i++) var_a += (a[i] - mean_a) * (a[i] - mean_a);
+    for (size_t i = 0; i < n; i++) var_b += (b[i] - mean_b) * (b[i] - mean_b);
+    return mse / n + std::sqrt(var_a / n) + std::sqrt(var_b / n);
+}
+
+//This is to parse "16K,4M,1G" into byte counts
+std::vector<size_t> parseSizes(const std::string &arg) {
+    std::vector<size_t> out;
+    std::stringstream ss(arg);
+    for (std::string item; std::getline(ss, item, ',');) {
+        if (item.empty()) continue;
+        size_t end = 0;
+        double value = std::stod(item, &end);
+        char unit = end < item.size() ? char(std::toupper(item[end])) : 0;
+        int shift = unit == 'K' ? 10 : unit == 'M' ? 20 : unit == 'G' ? 30 : 0;
+        out.push_back(size_t(value * double(size_t(1) << shift)));
+    }
+    return out;
+}
+
+std::string formatBytes(size_t bytes) {
+    if (bytes >= (size_t(1) << 30) && bytes % (size_t(1) << 30) == 0) return std::to_string(bytes >> 30) + "G";
+    if (bytes >= (size_t(1) << 20) && bytes % (size_t(1) << 20) == 0) return std::to_string(bytes >> 20) + "M";
+    if (bytes >= (size_t(1) << 10) && bytes % (size_t(1) << 10) == 0) return std::to_string(bytes >> 10) + "K";
+    return std::to_string(bytes);
+}
+
+//This is the linearly interpolated percentile of sorted samples
+double percentile(const std::vector<double> &sorted, double p) {
+    double pos = p * double(sorted.size() - 1);
+    size_t lo = size_t(pos);
+    size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (pos - double(lo)) * (sorted[hi] - sorted[lo]);
+}
+
+//This is to warm up, calibrate and time one kernel on n elements
+Point measure(const Kernel &k, size_t n, int warmup, int reps) {
+    for (int w = 0; w < warmup; w++) k.run(n);
+    auto t0 = Clock::now();
+    k.run(n);
+    double once = std::chrono::duration<double>(Clock::now() - t0).count();
+    size_t calls = once >= kMinSampleSeconds ? 1 : size_t(std::ceil(kMinSampleSeconds / std::max(once, 1e-9)));
+
+    std::vector<double> samples;
+    for (int r = 0; r < reps; r++) {
+        auto s0 = Clock::now();
+        for (size_t c = 0; c < calls; c++) k.run(n);
+        samples.push_back(std::chrono::duration<double>(Clock::now() - s0).count() * 1e9 / double(calls));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Point p;
+    p.kernel = k.name;
+    p.bytes = n * sizeof(float);
+    p.elements = n;
+    p.reps = reps;
+    p.calls_per_rep = calls;
+    p.median_ns = percentile(samples, 0.5);
+    p.p10_ns = percentile(samples, 0.1);
+    p.p90_ns = percentile(samples, 0.9);
+    p.min_ns = samples.front();
+    p.gbps = k.bytes_per_element * double(n) / p.median_ns;
+    return p;
+}
+
+std::string cpuModel() {
+    std::ifstream in("/proc/cpuinfo");
+    for (std::string line; std::getline(in, line);) {
+        if (line.rfind("model name", 0) != 0) continue;
+        size_t colon = line.find(':');
+        return colon == std::string::npos ? line : line.substr(line.find_first_not_of(' ', colon + 1));
+    }
+    return "unknown";
+}
+
+//This is to escape the few characters a CPU or kernel name can contain
+std::string jsonString(const std::string &s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// One point per line, so --baseline can read the file back without a JSON parser
+void writeJson(const std::string &filename, const std::vector<Point> &points, double memcpy_gbps) {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("cannot open " + filename);
+    out.precision(10);
+    out << "{\n  \"machine\": {\"cpu\": " << jsonString(cpuModel()) << ", \"simd\": \""
+        << lossy::simd_name(lossy::detect_simd()) << "\", \"half_path\": \""
+        << lossy::half_path_name(lossy::detect_half_path()) << "\", \"compiler\": " << jsonString(__VERSION__)
+        << ", \"memcpy_gbps\": " << memcpy_gbps << "},\n  \"results\": [\n";
+    for (size_t i = 0; i < points.size(); i++) {
+        const Point &p = points[i];
+        out << "    {\"kernel\": " << jsonString(p.kernel) << ", \"bytes\": " << p.bytes << ", \"elements\": "
+            << p.elements << ", \"reps\": " << p.reps << ", \"calls_per_rep\": " << p.calls_per_rep
+            << ", \"median_ns\": " << p.median_ns << ", \"p10_ns\": " << p.p10_ns << ", \"p90_ns\": " << p.p90_ns
+            << ", \"min_ns\": " << p.min_ns << ", \"ns_per_element\": " << p.median_ns / double(p.elements)
+            << ", \"gbps\": " << p.gbps << "}" << (i + 1 < points.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    if (!out) throw std::runtime_error("write failed: " + filename);
+}
+
+//This is to read (kernel, bytes) -> median_ns back from a file written by writeJson()
+std::map<std::pair<std::string, size_t>, double> readBaseline(const std::string &filename) {
+    std::ifstream in(filename);
+    if (!in) throw std::runtime_error("cannot open " + filename);
+    auto field = [](const std::string &line, const std::string &key) {
+        size_t at = line.find("\"" + key + "\": ");
+        if (at == std::string::npos) throw std::runtime_error("bad baseline row: " + line);
+        return line.substr(at + key.size() + 4);
+    };
+    std::map<std::pair<std::string, size_t>, double> medians;
+    for (std::string line; std::getline(in, line);) {
+        if (line.find("\"kernel\": ") == std::string::npos) continue;
+        std::string kernel = field(line, "kernel");
+        kernel = kernel.substr(1, kernel.find('"', 1) - 1);
+        medians[{kernel, std::stoull(field(line, "bytes"))}] = std::stod(field(line, "median_ns"));
+    }
+    return medians;
+}
+
+int main(int argc, char **argv) {
+    std::string sizes = "16K,256K,4M,64M,256M", filter, out = "kernels", baseline;
+    std::string dir = std::filesystem::temp_directory_path().string();
+    int reps = 11, warmup = 2;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string key = argv[i], value = argv[i + 1];
+        if (key == "--sizes") sizes = value;
+        else if (key == "--reps") reps = std::max(1, std::atoi(value.c_str()));
+        else if (key == "--warmup") warmup = std::max(0, std::atoi(value.c_str()));
+        else if (key == "--filter") filter = value;
+        else if (key == "--dir") dir = value;
+        else if (key == "--out") out = value;
+        else if (key == "--baseline") baseline = value;
+        else {
+            std::cerr << "Unknown option " << key << "\n";
+            return 1;
+        }
+    }
+
+    try {
+        std::vector<size_t> byte_sizes = parseSizes(sizes);
+        size_t max_n = 0;
+        for (size_t b : byte_sizes) max_n = std::max(max_n, b / sizeof(float));
+        std::map<std::pair<std::string, size_t>, double> previous;
+        if (!baseline.empty()) previous = readBaseline(baseline);
+
+        // Buffers are shared by every size, so a point only touches its first n elements
+        std::vector<float> data = lossy::generate<float, lossy::Gaussian>(max_n);
+        std::vector<float> masked(max_n), scratch(max_n);
+        std::vector<uint16_t> half(max_n);
+        lossy::mask_lsb(data.data(), masked.data(), max_n, 10);
+        lossy::float_to_half(data.data(), half.data(), max_n);
+        const std::string bin_path = dir + "/lossy_kernels.bin", lfc_path = dir + "/lossy_kernels.lfc";
+        volatile double sink = 0; // keeps the results of the value-returning kernels alive
+
+        std::vector<Kernel> kernels;
+        kernels.push_back({"memcpy", 8, [&](size_t n) { std::memcpy(scratch.data(), data.data(), n * sizeof(float)); }});
+        kernels.push_back({"compress legacy", 8, [&](size_t n) {
+                               sink = legacyCompress(data.data(), n, 10).back();
+                           }});
+        const lossy::SimdLevel levels[] = {lossy::SimdLevel::Scalar, lossy::SimdLevel::SSE2, lossy::SimdLevel::AVX2,
+                                           lossy::SimdLevel::AVX512};
+        for (lossy::SimdLevel level : levels) {
+            if (level > lossy::detect_simd()) break;
+            kernels.push_back({std::string("mask_lsb ") + lossy::simd_name(level), 8, [&, level](size_t n) {
+                                   lossy::mask_lsb(data.data(), scratch.data(), n, 10, level);
+                               }});
+        }
+        kernels.push_back({"truncate<10>", 8, [&](size_t n) { lossy::truncate<10>(data.data(), scratch.data(), n); }});
+        kernels.push_back({"round_lsb rne", 8, [&](size_t n) {
+                               lossy::round_lsb(data.data(), scratch.data(), n, 10, lossy::Rounding::NearestEven);
+                           }});
+        for (lossy::HalfPath path : {lossy::HalfPath::Table, lossy::HalfPath::F16C, lossy::HalfPath::AVX512}) {
+            if (path > lossy::detect_half_path()) break;
+            std::string suffix = lossy::half_path_name(path);
+            kernels.push_back({"float_to_half " + suffix, 6, [&, path](size_t n) {
+                                   lossy::float_to_half(data.data(), half.data(), n, path);
+                               }});
+            kernels.push_back({"half_to_float " + suffix, 6, [&, path](size_t n) {
+                                   lossy::half_to_float(half.data(), scratch.data(), n, path);
+                               }});
+        }
+        kernels.push_back({"metrics legacy", 8, [&](size_t n) { sink = legacyMetrics(data.data(), masked.data(), n); }});
+        for (lossy::SimdLevel level : {lossy::SimdLevel::Scalar, lossy::SimdLevel::AVX2, lossy::SimdLevel::AVX512}) {
+            if (level > lossy::detect_simd()) break;
+            kernels.push_back({std::string("compute_metrics ") + lossy::simd_name(level), 8, [&, level](size_t n) {
+                                   lossy::MetricsAccumulator acc;
+                                   acc.add(data.data(), masked.data(), n, level);
+                                   sink = acc.result().mse;
+                               }});
+        }
+        kernels.push_back({"write_binary", 4, [&](size_t n) {
+                               std::vector<float> view(masked.begin(), masked.begin() + n);
+                               lossy::write_binary("", bin_path, view);
+                           }});
+        kernels.push_back({"lfc write bitpack", 4, [&](size_t n) {
+                               lossy::ContainerOptions opt;
+                               opt.codec = lossy::Codec::BitPack;
+                               opt.shuffle = lossy::Shuffle::None;
+                               opt.bits_to_zero = 10;
+                               lossy::ContainerWriter writer(lfc_path, opt);
+                               writer.write(data.data(), n);
+                               writer.close();
+                           }});
+
+        std::cout << "CPU: " << cpuModel() << ", SIMD " << lossy::simd_name(lossy::detect_simd()) << ", half path "
+                  << lossy::half_path_name(lossy::detect_half_path()) << "\n";
+        std::cout << "Reps " << reps << " after " << warmup << " warm-up calls; times are per element\n\n";
+        std::cout << std::left << std::setw(26) << "kernel" << std::right << std::setw(7) << "size" << std::setw(11)
+                  << "median ns" << std::setw(10) << "p10" << std::setw(10) << "p90" << std::setw(9) << "GB/s"
+                  << std::setw(10) << "% memcpy" << (previous.empty() ? "" : "   speedup") << "\n";
+
+        std::vector<Point> points;
+        double memcpy_gbps = 0;
+        for (size_t bytes : byte_sizes) {
+            size_t n = bytes / sizeof(float);
+            if (n == 0) continue;
+            double reference = 0;
+            for (const Kernel &k : kernels) {
+                if (!filter.empty() && k.name != "memcpy" && k.name.find(filter) == std::string::npos) continue;
+                Point p = measure(k, n, warmup, reps);
+                if (k.name == "memcpy") {
+                    reference = p.gbps;
+                    memcpy_gbps = std::max(memcpy_gbps, p.gbps);
+                }
+                double per = 1.0 / double(n);
+                std::cout << std::left << std::setw(26) << p.kernel << std::right << std::setw(7) << formatBytes(p.bytes)
+                          << std::fixed << std::setprecision(3) << std::setw(11) << p.median_ns * per << std::setw(10)
+                          << p.p10_ns * per << std::setw(10) << p.p90_ns * per << std::setprecision(2) << std::setw(9)
+                          << p.gbps << std::setprecision(0) << std::setw(10) << 100.0 * p.gbps / reference;
+                auto it = previous.find({p.kernel, p.bytes});
+                if (it != previous.end()) {
+                    double speedup = it->second / p.median_ns;
+                    std::cout << std::setprecision(2) << std::setw(9) << speedup << "x"
+                              << (speedup < 0.95 ? "  SLOWER" : "");
+                }
+                std::cout << "\n";
+                points.push_back(p);
+            }
+        }
+        std::filesystem::remove(bin_path);
+        std::filesystem::remove(lfc_path);
+
+        writeJson(out + ".json", points, memcpy_gbps);
+        std::cout << "\nWrote " << points.size() << " points to " << out << ".json\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+// Throughput of the LSB-masking kernel against the original scalar loop.
+//
+// Usage: ./mask_throughput [num_floats] [bits_to_zero] [repetitions]
+//
+// A plain memcpy of the same buffer is timed as the memory-bandwidth reference:
+// a kernel that is bandwidth bound reaches ~100% of it out of place. The
+// round_lsb rows time round-to-nearest-even and stochastic rounding. The
+// last check rounds a block at the level choose_bits_to_zero() picks for a
+// tolerance and checks that every rounding mode stays within it.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "lossy/adaptive.h"
+#include "lossy/mask.h"
+#include "lossy/rounding.h"
+
+#include "bench_util.h"
+
+//This is the loop the tools used before the kernel existed (push_back per float)
+std::vector<float> legacyCompress(const std::vector<float> &data, int bits_to_zero) {
+    std::vector<float> compressed;
+    compressed.reserve(data.size());
+    uint32_t mask = ~((1u << bits_to_zero) - 1);
+    for (float val : data) {
+        uint32_t bits;
+        std::memcpy(&bits, &val, sizeof bits);
+        bits &= mask;
+        float out;
+        std::memcpy(&out, &bits, sizeof out);
+        compressed.push_back(out);
+    }
+    return compressed;
+}
+
+void report(const char *name, double bytes, double seconds, double reference_gbs) {
+    double gbs = bytes / seconds / 1e9;
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(9) << gbs << " GB/s";
+    if (reference_gbs > 0) std::cout << std::setw(8) << std::setprecision(0) << 100.0 * gbs / reference_gbs << "% of memcpy";
+    std::cout << "\n";
+}
+
+int main(int argc, char **argv) {
+    size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(64) << 20;
+    int bits_to_zero = argc > 2 ? std::atoi(argv[2]) : 10;
+    int reps = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    std::vector<float> data(N);
+    std::mt19937 gen(42);
+    std::normal_distribution<float> distribution(0.0f, 1.0f);
+    for (float &x : data) x = distribution(gen);
+    std::vector<float> out(N);
+
+    // Traffic per run: read N floats + write N floats
+    const double bytes = 2.0 * N * sizeof(float);
+    std::cout << "Elements: " << N << " (" << N * sizeof(float) / (1024.0 * 1024) << " MB), bits_to_zero = "
+              << bits_to_zero << ", detected: " << lossy::simd_name(lossy::detect_simd()) << "\n\n";
+
+    double memcpy_s = bestOf(reps, [&] { std::memcpy(out.data(), data.data(), N * sizeof(float)); });
+    double reference = bytes / memcpy_s / 1e9;
+    report("memcpy (reference)", bytes, memcpy_s, 0);
+
+    report("legacy push_back loop", bytes, bestOf(reps, [&] {
+               std::vector<float> c = legacyCompress(data, bits_to_zero);
+               out.swap(c);
+           }), reference);
+
+    const lossy::SimdLevel levels[] = {lossy::SimdLevel::Scalar, lossy::SimdLevel::SSE2,
+                                       lossy::SimdLevel::AVX2, lossy::SimdLevel::AVX512};
+    for (lossy::SimdLevel level : levels) {
+        if (level > lossy::detect_simd()) break;
+        std::string name = std::string("mask_lsb ") + lossy::simd_name(level);
+        report((name + " out-of-place").c_str(), bytes, bestOf(reps, [&] {
+                   lossy::mask_lsb(data.data(), out.data(), N, bits_to_zero, level);
+               }), reference);
+        report((name + " in-place").c_str(), bytes, bestOf(reps, [&] {
+                   lossy::mask_lsb(out.data(), out.data(), N, bits_to_zero, level);
+               }), reference);
+    }
+
+    for (lossy::SimdLevel level : levels) {
+        if (level > lossy::detect_simd()) break;
+        for (lossy::Rounding mode : {lossy::Rounding::NearestEven, lossy::Rounding::Stochastic}) {
+            std::string name = std::string("round_lsb ") + lossy::rounding_name(mode) + " " + lossy::simd_name(level);
+            report(name.c_str(), bytes, bestOf(reps, [&] {
+                       lossy::round_lsb(data.data(), out.data(), N, bits_to_zero, mode, level);
+                   }), reference);
+        }
+    }
+
+    // This is to check the dispatched path against scalar with misaligned input and output
+    size_t len = N > 8 ? N - 8 : 0;
+    std::vector<float> expect(N), got(N);
+    lossy::mask_lsb(data.data() + 3, expect.data(), len, bits_to_zero, lossy::SimdLevel::Scalar);
+    lossy::mask_lsb(data.data() + 3, got.data() + 1, len, bits_to_zero);
+    bool ok = std::memcmp(expect.data(), got.data() + 1, len * sizeof(float)) == 0;
+    for (lossy::Rounding mode : {lossy::Rounding::NearestEven, lossy::Rounding::Stochastic}) {
+        lossy::round_lsb(data.data() + 3, expect.data(), len, bits_to_zero, mode, lossy::SimdLevel::Scalar);
+        lossy::round_lsb(data.data() + 3, got.data() + 1, len, bits_to_zero, mode);
+        ok = ok && std::memcmp(expect.data(), got.data() + 1, len * sizeof(float)) == 0;
+    }
+    std::cout << "\nUnaligned result matches scalar: " << (ok ? "yes" : "NO") << "\n";
+
+    // Values just above 1, 2 and 3: truncation is exact to 2^-13, but rounding up a step is not
+    std::vector<float> block(65536), rounded(block.size());
+    for (size_t i = 0; i < block.size(); i++) block[i] = float((1.0 + std::ldexp(1.0, -13)) * double(1 + i % 3));
+    bool bounded = true;
+    for (lossy::ErrorBound bound : {lossy::ErrorBound::Absolute, lossy::ErrorBound::Relative, lossy::ErrorBound::MSE}) {
+        lossy::Tolerance tol{bound, bound == lossy::ErrorBound::MSE ? 1e-8 : 1.3e-4, false};
+        for (lossy::Rounding mode : {lossy::Rounding::Truncate, lossy::Rounding::NearestEven, lossy::Rounding::Stochastic}) {
+            int bits = lossy::choose_bits_to_zero(block.data(), block.size(), tol, mode);
+            lossy::round_lsb(block.data(), rounded.data(), block.size(), bits, mode);
+            double max_abs = 0, max_rel = 0, sum_sq = 0;
+            for (size_t i = 0; i < block.size(); i++) {
+                double err = std::fabs(double(block[i]) - double(rounded[i]));
+                max_abs = std::max(max_abs, err);
+                max_rel = std::max(max_rel, err / std::fabs(double(block[i])));
+                sum_sq += err * err;
+            }
+            double measured = bound == lossy::ErrorBound::Absolute ? max_abs
+                            : bound == lossy::ErrorBound::Relative ? max_rel : sum_sq / double(block.size());
+            bounded = bounded && measured <= tol.value;
+        }
+    }
+    std::cout << "Chosen levels stay within the tolerance: " << (bounded ? "yes" : "NO") << "\n";
+    return ok && bounded ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// Throughput of the fused metrics pass against the separate loops the tools used.
+//
+// Usage: ./metrics_throughput [num_floats] [max_threads] [repetitions]
+//
+// The legacy column is compute_mse() + compute_stats() on both arrays + the
+// MSE/MAE/max loop: five streams over the data. The fused pass reads each
+// array once and also returns PSNR.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lossy/mask.h"
+#include "lossy/metrics.h"
+
+#include "bench_util.h"
+
+//This is the MSE loop from distributions_mse.cpp
+double legacyMSE(const std::vector<float> &original, const std::vector<float> &compressed) {
+    double mse = 0.0;
+    for (size_t i = 0; i < original.size(); i++) {
+        double diff = original[i] - compressed[i];
+        mse += diff * diff;
+    }
+    return mse / original.size();
+}
+
+//This is compute_stats() from distributions_mse.cpp (two passes)
+std::pair<double, double> legacyStats(const std::vector<float> &data) {
+    double mean = std::accumulate(data.begin(), data.end(), 0.0) / data.size();
+    double variance = 0.0;
+    for (float val : data) variance += (val - mean) * (val - mean);
+    return {mean, std::sqrt(variance / data.size())};
+}
+
+//This is the MSE/MAE/max loop the old per-folder 32-16bit_MSE.cpp used
+double legacyErrors(const std::vector<float> &data, const std::vector<float> &reconstructed) {
+    double mse = 0.0, mae = 0.0, max_error = 0.0;
+    for (size_t i = 0; i < data.size(); i++) {
+        double diff = data[i] - reconstructed[i];
+        mse += diff * diff;
+        mae += std::abs(diff);
+        max_error = std::max(max_error, std::abs(diff));
+    }
+    return mse + mae + max_error;
+}
+
+int main(int argc, char **argv) {
+    size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(64) << 20;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    int reps = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    std::vector<float> data(N), reconstructed(N);
+    std::mt19937 gen(42);
+    std::normal_distribution<float> distribution(0.0f, 1.0f);
+    for (float &x : data) x = distribution(gen);
+    lossy::mask_lsb(data.data(), reconstructed.data(), N, 10);
+
+    std::cout << "Elements: " << N << ", detected: " << lossy::simd_name(lossy::detect_simd()) << "\n\n";
+
+    volatile double sink = 0;
+    reportRate("legacy (5 passes)", N, bestOf(reps, [&] {
+                   sink = legacyMSE(data, reconstructed) + legacyStats(data).second +
+                          legacyStats(reconstructed).second + legacyErrors(data, reconstructed);
+               }), 1e9, "Gelem/s");
+
+    const lossy::SimdLevel levels[] = {lossy::SimdLevel::Scalar, lossy::SimdLevel::AVX2, lossy::SimdLevel::AVX512};
+    for (lossy::SimdLevel level : levels) {
+        if (level > lossy::detect_simd()) break;
+        reportRate(std::string("fused ") + lossy::simd_name(level), N, bestOf(reps, [&] {
+                       lossy::MetricsAccumulator acc;
+                       acc.add(data.data(), reconstructed.data(), N, level);
+                       sink = acc.result().mse;
+                   }), 1e9, "Gelem/s");
+    }
+
+    lossy::ErrorMetrics reference = lossy::compute_metrics(data, reconstructed);
+    bool identical = true;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        lossy::ThreadPool pool(threads);
+        lossy::ErrorMetrics m;
+        reportRate("fused, " + std::to_string(threads) + " threads", N,
+                   bestOf(reps, [&] { m = lossy::compute_metrics(data, reconstructed, pool); }), 1e9, "Gelem/s");
+        identical = identical && m.mse == reference.mse && m.std_original == reference.std_original;
+    }
+    (void)sink;
+
+    std::cout << "\nMSE " << std::scientific << reference.mse << ", MAE " << reference.mae << ", max "
+              << reference.max_abs_error << ", PSNR " << std::fixed << reference.psnr << " dB\n";
+    std::cout << "Same result for every thread count: " << (identical ? "yes" : "NO") << "\n";
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// Thread scaling of the chunk-parallel mask -> shuffle -> gzip -> write pipeline.
+//
+// Usage: ./pipeline_scaling [num_floats] [bits_to_zero] [max_threads] [output.lfc]
+//
+// Runs the pipeline with 1, 2, 4, ... max_threads workers, prints throughput,
+// speedup and parallel efficiency, then the per-thread busy/idle split of the
+// largest run. The output file must be identical for every thread count,
+// and an encoding error on a worker must reach the caller as an exception.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lossy/pipeline.h"
+
+int main(int argc, char **argv) {
+    size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(32) << 20;
+    int bits_to_zero = argc > 2 ? std::atoi(argv[2]) : 10;
+    size_t max_threads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    std::string output = argc > 4 ? argv[4] : "pipeline_scaling.lfc";
+
+    std::vector<float> data(N);
+    std::mt19937 gen(42);
+    std::normal_distribution<float> distribution(0.0f, 1.0f);
+    for (float &x : data) x = distribution(gen);
+
+    lossy::ContainerOptions options;
+    options.bits_to_zero = bits_to_zero;
+    options.chunk_elements = size_t(1) << 18;
+
+    std::vector<size_t> counts;
+    for (size_t t = 1; t < max_threads; t *= 2) counts.push_back(t);
+    counts.push_back(max_threads);
+
+    std::cout << "Elements: " << N << ", bits_to_zero = " << bits_to_zero << ", chunk = " << options.chunk_elements << "\n\n";
+    std::cout << "threads      MB/s   speedup  efficiency  ratio   file crc\n";
+    double base_mbps = 0.0;
+    uint32_t first_crc = 0;
+    bool identical = true;
+    std::vector<lossy::WorkerStats> last_stats;
+    for (size_t threads : counts) {
+        lossy::ThreadPool pool(threads);
+        lossy::PipelineStats stats;
+        {
+            lossy::ContainerWriter writer(output, options);
+            pool.reset_stats();
+            stats = lossy::write_parallel(writer, data, pool);
+            writer.close();
+        }
+        last_stats = pool.stats();
+        uint32_t crc = lossy::file_crc32(output);
+        if (threads == counts.front()) {
+            base_mbps = stats.mbps();
+            first_crc = crc;
+        }
+        identical = identical && crc == first_crc;
+        double speedup = stats.mbps() / base_mbps;
+        std::cout << std::setw(7) << threads << std::fixed << std::setprecision(1) << std::setw(10) << stats.mbps()
+                  << std::setprecision(2) << std::setw(10) << speedup << std::setw(11) << std::setprecision(0)
+                  << 100.0 * speedup / threads << "%" << std::setprecision(2) << std::setw(8)
+                  << double(stats.raw_bytes) / stats.written_bytes << "   " << std::hex << crc << std::dec << "\n";
+    }
+
+    std::cout << "\nPer-thread time with " << counts.back() << " threads:\n";
+    std::cout << "thread  tasks  steals   busy s   idle s   busy %\n";
+    for (size_t i = 0; i < last_stats.size(); i++) {
+        const lossy::WorkerStats &w = last_stats[i];
+        double total = w.busy_seconds + w.idle_seconds;
+        std::cout << std::setw(6) << i << std::setw(7) << w.tasks << std::setw(8) << w.steals << std::fixed
+                  << std::setprecision(3) << std::setw(9) << w.busy_seconds << std::setw(9) << w.idle_seconds
+                  << std::setprecision(0) << std::setw(8) << (total > 0 ? 100.0 * w.busy_seconds / total : 0.0) << "%\n";
+    }
+
+    std::remove(output.c_str());
+    std::cout << "\nOutput identical across thread counts: " << (identical ? "yes" : "NO") << "\n";
+
+    // Gorilla refuses float16 storage, so every chunk fails on the pool
+    bool reported = false;
+    {
+        lossy::ContainerOptions bad = options;
+        bad.codec = lossy::Codec::Gorilla;
+        bad.precision = lossy::Precision::Float16;
+        lossy::ThreadPool pool(max_threads);
+        lossy::ContainerWriter writer(output, bad);
+        try {
+            lossy::write_parallel(writer, data, pool);
+        } catch (const std::runtime_error &) {
+            reported = true;
+        }
+    }
+    std::remove(output.c_str());
+    std::cout << "Encoding errors reach the caller: " << (reported ? "yes" : "NO") << "\n";
+    return identical && reported ? 0 : 1;
+}
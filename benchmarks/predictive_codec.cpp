@@ -0,0 +1,116 @@
+// Lorenzo predictive coder against LSB masking + gzip on a correlated 3D grid.
+//
+// Usage: ./predictive_codec [nx[xny[xnz]]] [repetitions]
+//
+// The grid is a smooth field (separable plane waves plus a few Gaussian
+// showers) with a little normal noise, like a calorimeter or field map. For
+// each absolute error bound (a fraction of the value range) the table shows
+// ratio, MSE, max error, PSNR and encode/decode MB/s of the predictive coder
+// given the grid's shape (it picks the predictor rank), of the same coder on
+// the flattened 1D array, and of per-exponent masking to the same bound +
+// byte shuffle + gzip.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lossy/adaptive.h"
+#include "lossy/deflate.h"
+#include "lossy/metrics.h"
+#include "lossy/predictive.h"
+#include "lossy/random.h"
+
+#include "bench_util.h"
+
+//This is to build the test field; every term is separable so it costs a few passes over the grid
+std::vector<float> makeField(const lossy::GridShape &shape) {
+    const size_t n = shape.size();
+    std::vector<float> field(n);
+    lossy::fill_normal(lossy::kDefaultSeed, field.data(), n);
+    for (float &v : field) v *= 1e-3f;
+
+    lossy::PhiloxStream params(lossy::PhiloxKey{lossy::kDefaultSeed, 1, 0});
+    auto axis = [&](size_t len, bool wave) {
+        std::vector<double> values(len);
+        double a = params.uniform_open0(), b = params.uniform_open0();
+        for (size_t i = 0; i < len; i++) {
+            double t = double(i) / double(len);
+            values[i] = wave ? std::sin(2 * M_PI * (1 + 3 * a) * t + 2 * M_PI * b)
+                             : std::exp(-0.5 * (t - a) * (t - a) / (0.002 + 0.01 * b));
+        }
+        return values;
+    };
+    for (int term = 0; term < 10; term++) {
+        bool wave = term < 6;
+        double amplitude = wave ? 1.0 + params.uniform_open0() : 20.0 * params.uniform_open0();
+        std::vector<double> fx = axis(shape.nx, wave), fy = axis(shape.ny, wave), fz = axis(shape.nz, wave);
+        size_t i = 0;
+        for (size_t z = 0; z < shape.nz; z++)
+            for (size_t y = 0; y < shape.ny; y++) {
+                double yz = amplitude * fy[y] * fz[z];
+                for (size_t x = 0; x < shape.nx; x++) field[i++] += float(yz * fx[x]);
+            }
+    }
+    return field;
+}
+
+void report(const std::string &name, double ratio, const lossy::ErrorMetrics &m, double mb, double encode_s,
+            double decode_s) {
+    std::cout << "  " << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(8) << ratio << std::scientific << std::setprecision(3) << std::setw(12) << m.mse
+              << std::setw(12) << m.max_abs_error << std::fixed << std::setprecision(1) << std::setw(8) << m.psnr
+              << std::setprecision(0) << std::setw(9) << mb / encode_s << std::setw(9) << mb / decode_s << "\n";
+}
+
+int main(int argc, char **argv) {
+    try {
+        lossy::GridShape shape = lossy::parse_shape(argc > 1 ? argv[1] : "256x256x64");
+        int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+        const size_t n = shape.size();
+        const double mb = n * sizeof(float) / 1e6;
+
+        std::vector<float> field = makeField(shape);
+        auto [lo, hi] = std::minmax_element(field.begin(), field.end());
+        const double range = double(*hi) - double(*lo);
+        std::cout << "Grid " << lossy::shape_name(shape) << " (" << mb << " MB), value range " << range << "\n";
+        std::cout << "  " << std::left << std::setw(20) << "codec" << std::right << std::setw(8) << "ratio"
+                  << std::setw(12) << "MSE" << std::setw(12) << "max err" << std::setw(8) << "PSNR" << std::setw(9)
+                  << "enc MB/s" << std::setw(9) << "dec MB/s" << "\n";
+
+        bool ok = true;
+        std::vector<float> restored(n), masked(n);
+        for (double relative : {1e-2, 1e-3, 1e-4, 1e-5}) {
+            const double bound = relative * range;
+            std::cout << "Bound " << std::scientific << std::setprecision(1) << bound << " (" << relative
+                      << " of range):\n";
+
+            for (lossy::GridShape grid : {shape, lossy::GridShape{n, 1, 1}}) {
+                std::vector<unsigned char> packed;
+                double encode_s = bestOf(reps, [&] { packed = lossy::predictive_encode(field.data(), grid, bound); });
+                double decode_s =
+                    bestOf(reps, [&] { lossy::predictive_decode(packed.data(), packed.size(), restored.data(), n); });
+                lossy::ErrorMetrics m = lossy::compute_metrics(field, restored);
+                ok = ok && m.max_abs_error <= bound;
+                std::string name = "lorenzo " + std::to_string(grid.rank()) + "D (rank " +
+                                   std::to_string(lossy::predictive_rank(packed.data(), packed.size())) + ")";
+                report(name, double(n * sizeof(float)) / packed.size(), m,
+                       mb, encode_s, decode_s);
+                if (shape.rank() == 1) break;
+            }
+
+            double mask_s = bestOf(reps, [&] { lossy::mask_to_abs_error(field.data(), masked.data(), n, bound); });
+            lossy::DeflateStats gz = lossy::measure_gzip(masked, lossy::Shuffle::Byte);
+            report("mask+shuffle-gzip", gz.ratio(), lossy::compute_metrics(field, masked), mb,
+                   mask_s + mb / gz.compress_mbps, mb / gz.decompress_mbps);
+        }
+        std::cout << "All predictive reconstructions within bound: " << (ok ? "yes" : "NO") << "\n";
+        return ok ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,78 @@
+// Throughput of the counter-based generators against <random>.
+//
+// Usage: ./rng_throughput [num_samples] [max_threads] [repetitions]
+//
+// The std column is std::mt19937 with the matching std:: distribution, as the
+// tools used before. The Philox columns fill the same number of floats
+// serially and on 1, 2, 4, ... threads, and the output of every thread count
+// is compared with the serial one.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lossy/distributions.h"
+
+#include "bench_util.h"
+
+//This is to fill with std::mt19937 and the std:: distribution of the same shape
+void fillStd(const std::string &name, std::vector<float> &data) {
+    std::mt19937 gen(42);
+    if (name == "uniform") {
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        for (float &x : data) x = dist(gen);
+    } else if (name == "gaussian") {
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        for (float &x : data) x = dist(gen);
+    } else {
+        std::exponential_distribution<float> dist(1.0f);
+        for (float &x : data) x = dist(gen);
+    }
+}
+
+//This is to benchmark one distribution policy; returns false if a thread count changed the output
+template <typename Dist>
+bool runDistribution(size_t N, size_t max_threads, int reps) {
+    std::vector<float> reference(N), data(N);
+    std::cout << Dist::name << ":\n";
+    reportRate("  std::mt19937", N, bestOf(reps, [&] { fillStd(Dist::name, data); }), 1e6, "Msamples/s");
+    reportRate("  philox serial", N, bestOf(reps, [&] { Dist::fill(lossy::kDefaultSeed, reference.data(), N); }), 1e6,
+               "Msamples/s");
+
+    bool identical = true;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        lossy::ThreadPool pool(threads);
+        reportRate("  philox, " + std::to_string(threads) + " threads", N,
+                   bestOf(reps, [&] { Dist::fill(lossy::kDefaultSeed, data.data(), N, pool); }), 1e6, "Msamples/s");
+        identical = identical && data == reference;
+    }
+
+    double mean = 0.0, m2 = 0.0;
+    for (size_t i = 0; i < N; i++) {
+        double delta = reference[i] - mean;
+        mean += delta / double(i + 1);
+        m2 += delta * (reference[i] - mean);
+    }
+    std::cout << "  mean " << std::setprecision(5) << mean << ", std " << std::sqrt(m2 / N) << "\n\n";
+    return identical;
+}
+
+int main(int argc, char **argv) {
+    size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(64) << 20;
+    size_t max_threads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+    int reps = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    std::cout << "Samples: " << N << ", detected: " << lossy::simd_name(lossy::detect_simd()) << "\n\n";
+    bool identical = runDistribution<lossy::Uniform>(N, max_threads, reps);
+    identical = runDistribution<lossy::Gaussian>(N, max_threads, reps) && identical;
+    identical = runDistribution<lossy::Exponential>(N, max_threads, reps) && identical;
+
+    std::cout << "Same output for every thread count: " << (identical ? "yes" : "NO") << "\n";
+    return identical ? 0 : 1;
+}
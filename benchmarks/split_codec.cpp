@@ -0,0 +1,82 @@
+// Sign/exponent/mantissa split + rANS against the gzip baseline of og-vs-com_gzip.
+//
+// Usage: ./split_codec [num_floats] [repetitions]
+//
+// For every distribution and LSB-zeroing level the table shows the ratio
+// and encode/decode GB/s of the split codec next to plain gzip and
+// byte-shuffle + gzip of the same masked array (the og-vs-com_gzip
+// measurements), plus the dense bit-packing it builds on. The plane line
+// gives the Shannon entropy of the exponent bytes, the bits per value rANS
+// spent on them and the stored size of each plane. Every split round trip
+// is checked against mask_lsb().
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lossy/bitpack.h"
+#include "lossy/deflate.h"
+#include "lossy/distributions.h"
+#include "lossy/mask.h"
+#include "lossy/split.h"
+
+#include "bench_util.h"
+
+//This is to compare the codecs on one distribution; returns false if a split round trip differs
+template <typename Dist>
+bool runDistribution(size_t N, int reps) {
+    std::vector<float> data = lossy::generate<float, Dist>(N);
+    std::vector<float> masked(N), restored(N);
+    const double bytes = double(N) * sizeof(float);
+    bool ok = true;
+
+    for (int bits : {0, 8, 10, 12, 16}) {
+        lossy::mask_lsb(data.data(), masked.data(), N, bits);
+        std::cout << Dist::name << ", " << bits << " bits zeroed:\n";
+
+        std::vector<unsigned char> packed;
+        double encode_s = bestOf(reps, [&] { packed = lossy::split_encode(masked.data(), N, bits); });
+        double decode_s = bestOf(reps, [&] { lossy::split_decode(packed.data(), packed.size(), restored.data(), N); });
+        reportCodec("split + rANS", bytes / packed.size(), bytes, encode_s, decode_s);
+        ok = ok && std::memcmp(masked.data(), restored.data(), N * sizeof(float)) == 0;
+
+        lossy::DeflateStats bp = lossy::measure_bitpack(masked, bits);
+        reportCodec("bitpack", bp.ratio(), bytes, bytes / 1e6 / bp.compress_mbps, bytes / 1e6 / bp.decompress_mbps);
+        for (lossy::Shuffle mode : {lossy::Shuffle::None, lossy::Shuffle::Byte}) {
+            lossy::DeflateStats gz = lossy::measure_gzip(masked.data(), N, mode);
+            std::string name = mode == lossy::Shuffle::None ? "gzip" : "shuffle-gzip";
+            reportCodec(name, gz.ratio(), bytes, bytes / 1e6 / gz.compress_mbps, bytes / 1e6 / gz.decompress_mbps);
+        }
+
+        std::vector<unsigned char> exponents(N);
+        for (size_t i = 0; i < N; i++) exponents[i] = uint8_t(lossy::float_bits(masked[i]) >> 23);
+        lossy::SplitHeader h = lossy::split_header(packed.data(), packed.size(), N);
+        std::cout << "  planes: exponent entropy " << std::setprecision(3) << lossy::byte_entropy(exponents.data(), N)
+                  << " bits, coded " << h.exponent_bytes * 8.0 / N << " bits; sign " << h.sign_bytes
+                  << " B, exponent " << h.exponent_bytes << " B, mantissa "
+                  << lossy::packed_bytes(N, h.mantissa_bits) * (h.mantissa_bits > 0) << " B\n";
+    }
+    std::cout << "\n";
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    try {
+        size_t N = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : size_t(1) << 22;
+        int reps = argc > 2 ? std::atoi(argv[2]) : 3;
+
+        std::cout << "Elements: " << N << " (" << N * sizeof(float) / (1024.0 * 1024) << " MB)\n\n";
+        bool ok = runDistribution<lossy::Uniform>(N, reps);
+        ok = runDistribution<lossy::Gaussian>(N, reps) && ok;
+        ok = runDistribution<lossy::Exponential>(N, reps) && ok;
+        std::cout << "Split round trips exact: " << (ok ? "yes" : "NO") << "\n";
+        return ok ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
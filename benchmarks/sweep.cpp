@@ -0,0 +1,119 @@
+// Parametric sweep over distribution x N x bits_to_zero x codec x threads.
+//
+// Usage: ./sweep [--dist uniform,gaussian,exponential] [--n 1000000] [--bits 0-22]
+//                [--codec raw,gzip,shuffle-gzip,bitshuffle-gzip,gorilla,bitpack,split,f16,f16-gzip]
+//                (append :rne or :stochastic to a float32 codec to round instead of truncate;
+//                 bf16, e8m15, e5m2, e4m3 and their -gzip forms store minifloats;
+//                 gzip may be replaced by zstd, zstd-long, lz4, lz4hc or libdeflate when
+//                 built in, and @level, @lo..hi or @all picks or sweeps its levels)
+//                [--threads 1,2,4] [--reps 3] [--out sweep]
+//
+// Every list accepts comma-separated values; --n and --bits also take ranges
+// (a-b). Writes <out>.csv and <out>.json with one row per configuration:
+// ratio, MSE/MAE/max error, PSNR, encode/decode MB/s and the number of values
+// clipped by the storage format. Float16 and minifloat codecs do not depend on
+// bits_to_zero and are measured once per (distribution, N, threads).
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "lossy/distributions.h"
+#include "lossy/sweep.h"
+
+//This is to split "a,b,c" into its fields
+std::vector<std::string> splitList(const std::string &arg) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start <= arg.size()) {
+        size_t comma = arg.find(',', start);
+        if (comma == std::string::npos) comma = arg.size();
+        if (comma > start) out.push_back(arg.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return out;
+}
+
+//This is to expand "0-22,24" style lists of integers
+std::vector<size_t> parseNumbers(const std::string &arg) {
+    std::vector<size_t> out;
+    for (const std::string &item : splitList(arg)) {
+        size_t dash = item.find('-');
+        if (dash == std::string::npos) {
+            out.push_back(size_t(std::stod(item)));
+        } else {
+            size_t lo = size_t(std::stod(item.substr(0, dash))), hi = size_t(std::stod(item.substr(dash + 1)));
+            for (size_t v = lo; v <= hi; v++) out.push_back(v);
+        }
+    }
+    return out;
+}
+
+//This is to generate the dataset of one distribution (fixed seed, so runs are comparable)
+std::vector<float> generateData(const std::string &name, size_t n) {
+    std::vector<float> data;
+    bool known = lossy::with_distribution(name, [&](auto dist) { data = lossy::generate<float, decltype(dist)>(n); });
+    if (!known) throw std::runtime_error("unknown distribution: " + name);
+    return data;
+}
+
+int main(int argc, char **argv) {
+    std::string dists = "uniform,gaussian,exponential", sizes = "1000000", bits = "0-22", threads = "1";
+    std::string codecs = "raw,gzip,shuffle-gzip,bitshuffle-gzip,gorilla,f16,f16-gzip", out = "sweep";
+    int reps = 3;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string key = argv[i], value = argv[i + 1];
+        if (key == "--dist") dists = value;
+        else if (key == "--n") sizes = value;
+        else if (key == "--bits") bits = value;
+        else if (key == "--codec") codecs = value;
+        else if (key == "--threads") threads = value;
+        else if (key == "--reps") reps = std::atoi(value.c_str());
+        else if (key == "--out") out = value;
+        else {
+            std::cerr << "Unknown option " << key << "\n";
+            return 1;
+        }
+    }
+
+    try {
+        std::vector<lossy::CodecConfig> codec_list;
+        for (const std::string &spec : splitList(codecs))
+            for (const std::string &name : lossy::expand_codec_levels(spec))
+                codec_list.push_back(lossy::parse_codec_config(name));
+
+        std::vector<lossy::SweepResult> rows;
+        for (size_t thread_count : parseNumbers(threads)) {
+            lossy::ThreadPool pool(thread_count);
+            for (const std::string &dist : splitList(dists)) {
+                for (size_t n : parseNumbers(sizes)) {
+                    std::vector<float> data = generateData(dist, n);
+                    for (const lossy::CodecConfig &codec : codec_list) {
+                        bool narrow = codec.options.precision != lossy::Precision::Float32;
+                        for (size_t b : parseNumbers(bits)) {
+                            if (b > 23) continue;
+                            lossy::SweepResult r = lossy::run_sweep_point(dist, data, int(b), codec, pool, reps);
+                            rows.push_back(r);
+                            std::cout << std::left << std::setw(12) << dist << std::setw(10) << n << " bits "
+                                      << std::setw(3) << r.bits_to_zero << std::setw(27) << codec.name << r.threads
+                                      << " thr  ratio " << std::setw(8) << r.ratio << " MSE " << std::setw(12) << r.mse
+                                      << " enc " << std::setw(8) << r.encode_mbps << " dec " << r.decode_mbps
+                                      << " MB/s" << (r.clipped ? "  clipped " + std::to_string(r.clipped) : "")
+                                      << "\n";
+                            if (narrow) break;
+                        }
+                    }
+                }
+            }
+        }
+        lossy::write_sweep_csv(out + ".csv", rows);
+        lossy::write_sweep_json(out + ".json", rows);
+        std::cout << "\nWrote " << rows.size() << " rows to " << out << ".csv and " << out << ".json\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
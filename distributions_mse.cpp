@@ -1,73 +1,65 @@
 #include <iostream>
 #include <vector>
-#include <random>
 #include <fstream>
 #include <cmath>
 #include <bitset>
-#include <numeric>
 #include <filesystem>
+#include "lossy/container.h"
+#include "lossy/distributions.h"
+#include "lossy/mask.h"
+#include "lossy/metrics.h"
+#include "lossy/pipeline.h"
+#include "lossy/rounding.h"
 
 using namespace std;
 namespace fs = std::filesystem;
 
-// This is a Function to generate random numbers from a given distribution
+// This is a Function to generate random numbers from a given distribution (same data for a seed on any thread count)
 template <typename Distribution>
-vector<float> generate_data(size_t n, Distribution dist) {
-    random_device rd;
-    mt19937 gen(rd());
-    vector<float> data(n);
-    for (size_t i = 0; i < n; i++) {
-        data[i] = dist(gen);
-    }
-    return data;
+vector<float> generate_data(size_t n, uint64_t seed, lossy::ThreadPool& pool) {
+    return lossy::generate<float, Distribution>(n, seed, pool);
 }
 
 // This is a Function to compress floating-point numbers by zeroing out the least significant bits
 float compress(float value, int bits_to_zero) {
     if (bits_to_zero <= 0 || bits_to_zero >= 23) return value; 
     
-    uint32_t int_rep = *reinterpret_cast<uint32_t*>(&value);
-    int_rep &= ~((1 << bits_to_zero) - 1); 
-    
-    return *reinterpret_cast<float*>(&int_rep);
+    return lossy::bits_float(lossy::float_bits(value) & lossy::lsb_mask(bits_to_zero));
 }
 
-// This is a Function to compress a vector of floating points
-vector<float> compress_data(const vector<float>& data, int bits_to_zero) {
-    vector<float> compressed;
-    compressed.reserve(data.size());
-    for (float val : data) {
-        compressed.push_back(compress(val, bits_to_zero));
-    }
+// This is a Function to compress a vector of floating points (truncation by default, or round-to-nearest-even / stochastic)
+vector<float> compress_data(const vector<float>& data, int bits_to_zero, lossy::Rounding rounding = lossy::Rounding::Truncate) {
+    vector<float> compressed(data.size());
+    if (bits_to_zero <= 0 || bits_to_zero >= 23) bits_to_zero = 0;
+    lossy::round_lsb(data.data(), compressed.data(), data.size(), bits_to_zero, rounding);
     return compressed;
 }
 
 //This is a Function to save data in binary format
 void save_binary(const string& filename, const vector<float>& data) {
+    lossy::ScopedStage stage("write", data.size(), data.size() * sizeof(float), data.size() * sizeof(float));
     ofstream file(filename, ios::binary);
     file.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
     file.close();
 }
 
-//This is a Function to compute Mean Squared Error (MSE)
-double compute_mse(const vector<float>& original, const vector<float>& compressed) {
-    double mse = 0.0;
-    for (size_t i = 0; i < original.size(); i++) {
-        double diff = original[i] - compressed[i];
-        mse += diff * diff;
-    }
-    return mse / original.size();
+//This is a Function to save data in the chunked .lfc container (truncated, byte-shuffled and gzipped per chunk)
+void save_container(const string& filename, const vector<float>& data, const lossy::ContainerOptions& options, lossy::ThreadPool& pool) {
+    lossy::ContainerWriter writer(filename, options);
+    lossy::write_parallel(writer, data, pool);
+    writer.close();
 }
 
-//This is a Compute mean and standard deviation
-pair<double, double> compute_stats(const vector<float>& data) {
-    double mean = accumulate(data.begin(), data.end(), 0.0) / data.size();
-    double variance = 0.0;
-    for (float val : data) {
-        variance += (val - mean) * (val - mean);
+//This is a Function to print the range of mantissa bits kept over the chunks of a container
+void print_bits_kept(const string& label, const string& filename) {
+    lossy::ContainerReader reader(filename);
+    int lo = 23, hi = 0;
+    for (size_t i = 0; i < reader.chunk_count(); i++) {
+        int kept = reader.chunk_header(i).bits_kept;
+        lo = min(lo, kept);
+        hi = max(hi, kept);
     }
-    variance /= data.size();
-    return {mean, sqrt(variance)};
+    cout << label << ": mantissa bits kept per chunk = " << lo << ".." << hi << " of 23\n";
 }
 
 // This is a Function to get file size
@@ -75,13 +67,20 @@ size_t get_file_size(const string& filename) {
     return fs::exists(filename) ? fs::file_size(filename) : 0;
 }
 
-int main() {
+int main(int argc, char** argv) {
     size_t n = 1e6; 
+    // Number of compression threads (default: all cores)
+    lossy::ThreadPool pool(argc > 1 ? stoul(argv[1]) : 0);
+    // Optional error bound for the .lfc files: abs|rel|mse <tolerance>
+    lossy::Tolerance tolerance;
+    if (argc > 3) tolerance = {lossy::parse_error_bound(argv[2]), stod(argv[3])};
+    // Seed of the synthetic data, so a run can be reproduced
+    uint64_t seed = argc > 4 ? stoull(argv[4]) : lossy::kDefaultSeed;
     
     // This Generate random numbers from different distributions
-    vector<float> uniform_data = generate_data(n, uniform_real_distribution<float>(0.0, 1.0));
-    vector<float> gaussian_data = generate_data(n, normal_distribution<float>(0.0, 1.0));
-    vector<float> exponential_data = generate_data(n, exponential_distribution<float>(1.0));
+    vector<float> uniform_data = generate_data<lossy::Uniform>(n, seed, pool);
+    vector<float> gaussian_data = generate_data<lossy::Gaussian>(n, seed, pool);
+    vector<float> exponential_data = generate_data<lossy::Exponential>(n, seed, pool);
     
     // To Apply lossy compression (zero out 10 least significant bits)
     int bits_to_zero = 10;
@@ -98,21 +97,39 @@ int main() {
     save_binary("gaussian_compressed.bin", compressed_gaussian);
     save_binary("exponential_original.bin", exponential_data);
     save_binary("exponential_compressed.bin", compressed_exponential);
+
+    // To Save the chunked containers: fixed bits_to_zero, or chosen per chunk from the error bound
+    lossy::ContainerOptions options;
+    options.bits_to_zero = bits_to_zero;
+    options.tolerance = tolerance;
+    options.chunk_elements = 1 << 16;
+    save_container("uniform_compressed.lfc", uniform_data, options, pool);
+    save_container("gaussian_compressed.lfc", gaussian_data, options, pool);
+    save_container("exponential_compressed.lfc", exponential_data, options, pool);
     
-    // To Compute statistics before and after compression
-    auto [mean_u, stddev_u] = compute_stats(uniform_data);
-    auto [mean_cu, stddev_cu] = compute_stats(compressed_uniform);
-    cout << "Uniform Distribution: Mean = " << mean_u << ", Std Dev = " << stddev_u << endl;
-    cout << "Compressed Uniform: Mean = " << mean_cu << ", Std Dev = " << stddev_cu << endl;
+    // To Compute statistics and errors before and after compression (one fused pass per distribution)
+    lossy::ErrorMetrics metrics_u = lossy::compute_metrics(uniform_data, compressed_uniform, pool);
+    lossy::ErrorMetrics metrics_g = lossy::compute_metrics(gaussian_data, compressed_gaussian, pool);
+    lossy::ErrorMetrics metrics_e = lossy::compute_metrics(exponential_data, compressed_exponential, pool);
+    cout << "Uniform Distribution: Mean = " << metrics_u.mean_original << ", Std Dev = " << metrics_u.std_original << endl;
+    cout << "Compressed Uniform: Mean = " << metrics_u.mean_reconstructed << ", Std Dev = " << metrics_u.std_reconstructed << endl;
     
     // To Compute MSE
-    double mse_uniform = compute_mse(uniform_data, compressed_uniform);
-    double mse_gaussian = compute_mse(gaussian_data, compressed_gaussian);
-    double mse_exponential = compute_mse(exponential_data, compressed_exponential);
+    double mse_uniform = metrics_u.mse;
+    double mse_gaussian = metrics_g.mse;
+    double mse_exponential = metrics_e.mse;
     
     cout << "MSE (Uniform): " << mse_uniform << endl;
     cout << "MSE (Gaussian): " << mse_gaussian << endl;
     cout << "MSE (Exponential): " << mse_exponential << endl;
+    cout << "PSNR (Uniform / Gaussian / Exponential): " << metrics_u.psnr << " / " << metrics_g.psnr << " / " << metrics_e.psnr << " dB" << endl;
+
+    // To Compare rounding modes at the same bits_to_zero (truncation moves every value toward zero)
+    for (lossy::Rounding mode : {lossy::Rounding::Truncate, lossy::Rounding::NearestEven, lossy::Rounding::Stochastic}) {
+        lossy::ErrorMetrics m = lossy::compute_metrics(uniform_data, compress_data(uniform_data, bits_to_zero, mode), pool);
+        cout << "Rounding " << lossy::rounding_name(mode) << " (Uniform): MSE = " << m.mse
+             << ", Mean Shift = " << m.mean_reconstructed - m.mean_original << endl;
+    }
     
     // To Measure file sizes and calculate storage savings
     size_t original_size_u = get_file_size("uniform_original.bin");
@@ -129,6 +146,20 @@ int main() {
          << (1.0 - (double)compressed_size_g / original_size_g) * 100 << "%\n";
     cout << "Exponential: Original = " << original_size_e / 1024 << " KB, Compressed = " << compressed_size_e / 1024 << " KB, Savings = " 
          << (1.0 - (double)compressed_size_e / original_size_e) * 100 << "%\n";
+
+    // To Measure the chunked container files (zeroed bits actually removed by shuffle + gzip)
+    size_t container_size_u = get_file_size("uniform_compressed.lfc");
+    size_t container_size_g = get_file_size("gaussian_compressed.lfc");
+    size_t container_size_e = get_file_size("exponential_compressed.lfc");
+    cout << "Container (.lfc) Savings";
+    if (tolerance.bound != lossy::ErrorBound::None) cout << " (" << lossy::error_bound_name(tolerance.bound) << " error <= " << tolerance.value << ")";
+    cout << ":\n";
+    cout << "Uniform: " << container_size_u / 1024 << " KB, Savings = " << (1.0 - (double)container_size_u / original_size_u) * 100 << "%\n";
+    cout << "Gaussian: " << container_size_g / 1024 << " KB, Savings = " << (1.0 - (double)container_size_g / original_size_g) * 100 << "%\n";
+    cout << "Exponential: " << container_size_e / 1024 << " KB, Savings = " << (1.0 - (double)container_size_e / original_size_e) * 100 << "%\n";
+    print_bits_kept("Uniform", "uniform_compressed.lfc");
+    print_bits_kept("Gaussian", "gaussian_compressed.lfc");
+    print_bits_kept("Exponential", "exponential_compressed.lfc");
     
     return 0;
 }
@@ -7,7 +7,7 @@ void simulation() {
 
     const char* techniques[n] = {"Uncompressed", "Gzip", "8 bit+gzip","10 bit+gzip",  "12bit+Gzip", "16bit+Gzip","32-16 bit"};
 
-    double mse[n] = {0, 0 , 3.33151e-10, 5.33735e-09,8.55999e-08, 2.18084e-05 , 1.40414e-04 }; 
+    double mse[n] = {0, 0 , 3.33151e-10, 5.33735e-09,8.55999e-08, 2.18084e-05 , 8.62463e-08 }; 
 
     TCanvas *c1 = new TCanvas("c1", "MSE vs. Compression Techniques", 800, 600);
     gStyle->SetOptStat(0); 
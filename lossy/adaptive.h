@@ -0,0 +1,148 @@
+#pragma once
+
+// Error-bounded choice of bits_to_zero.
+//
+// Given a block of values and a tolerance (maximum absolute error, maximum
+// relative error, or an MSE budget), choose_bits_to_zero() returns the
+// largest number of mantissa LSBs that can be cleared while the block still
+// meets the tolerance. The error of LSB masking only grows with the number
+// of bits cleared, so a binary search over 0..23 with an exact error pass at
+// each step finds the most aggressive level that is guaranteed to hold.
+// NaNs must stay NaN; +-Inf are never changed by masking.
+//
+// For an absolute bound the level can also be chosen per exponent band:
+// mask_to_abs_error() clears, for each value, as many bits as its own
+// exponent allows, so small values lose more bits than large ones.
+//
+// Both take the rounding mode of rounding.h. Round-to-nearest-even halves
+// the worst-case error, so it is checked exactly and usually allows one more
+// bit. Stochastic rounding ends on either neighbour of a value, so every
+// value is checked at the farther of the two (a full step at worst).
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "common.h"
+#include "mask.h"
+#include "rounding.h"
+
+namespace lossy {
+
+enum class ErrorBound { None, Absolute, Relative, MSE };
+
+inline const char *error_bound_name(ErrorBound bound) {
+    switch (bound) {
+    case ErrorBound::Absolute: return "abs";
+    case ErrorBound::Relative: return "rel";
+    case ErrorBound::MSE: return "mse";
+    default: return "none";
+    }
+}
+
+// This is to parse "abs", "rel" or "mse" (anything else gives None)
+inline ErrorBound parse_error_bound(const std::string &name) {
+    if (name == "abs") return ErrorBound::Absolute;
+    if (name == "rel") return ErrorBound::Relative;
+    if (name == "mse") return ErrorBound::MSE;
+    return ErrorBound::None;
+}
+
+struct Tolerance {
+    ErrorBound bound = ErrorBound::None;
+    double value = 0.0;
+    bool per_exponent = true; // Absolute only: choose the level per exponent, not per block
+};
+
+namespace detail {
+
+// This is to check whether clearing `bits` LSBs keeps data within the tolerance
+inline bool masking_within(const float *data, size_t n, int bits, const Tolerance &tol, Rounding rounding) {
+    const uint32_t mask = lsb_mask(bits);
+    double max_abs = 0.0, max_rel = 0.0, sum_sq = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = float_bits(data[i]);
+        uint32_t m = rounding == Rounding::NearestEven ? round_word(x, mask, nearest_even_add(x, mask)) : x & mask;
+        if ((x & 0x7F800000u) == 0x7F800000u) {
+            // Inf is unchanged; a NaN must keep a non-zero mantissa
+            if ((x & 0x007FFFFFu) != 0 && (m & 0x007FFFFFu) == 0) return false;
+            continue;
+        }
+        double err = std::fabs(double(data[i]) - double(bits_float(m)));
+        // Stochastic noise can also carry the value up to the next step
+        if (rounding == Rounding::Stochastic)
+            err = std::max(err, std::fabs(double(data[i]) - double(bits_float(round_word(x, mask, ~mask)))));
+        max_abs = std::max(max_abs, err);
+        if (data[i] != 0.0f) max_rel = std::max(max_rel, err / std::fabs(double(data[i])));
+        sum_sq += err * err;
+    }
+    switch (tol.bound) {
+    case ErrorBound::Absolute: return max_abs <= tol.value;
+    case ErrorBound::Relative: return max_rel <= tol.value;
+    case ErrorBound::MSE: return n == 0 || sum_sq / double(n) <= tol.value;
+    default: return bits == 0;
+    }
+}
+
+} // namespace detail
+
+// This is to pick the largest bits_to_zero (0..23) whose error stays within tol
+inline int choose_bits_to_zero(const float *data, size_t n, const Tolerance &tol,
+                               Rounding rounding = Rounding::Truncate) {
+    if (tol.bound == ErrorBound::None || !(tol.value >= 0.0)) return 0;
+    int lo = 0, hi = 23; // lo always satisfies the bound (no bits cleared = no error)
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (detail::masking_within(data, n, mid, tol, rounding)) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+// This is to build, for every exponent field value, the widest mask whose error stays <= max_abs
+inline void abs_error_masks(double max_abs, uint32_t masks[256], Rounding rounding = Rounding::Truncate) {
+    // Worst error of clearing `bits` bits, in mantissa units
+    auto units = [rounding](int bits) {
+        return rounding == Rounding::NearestEven ? std::ldexp(1.0, bits - 1) : std::ldexp(1.0, bits) - 1.0;
+    };
+    for (int e = 0; e < 256; e++) {
+        // One mantissa unit is 2^(e - 150) for normals and 2^-149 for subnormals
+        double ulp = std::ldexp(1.0, (e == 0 ? 1 : e) - 150);
+        int bits = 0;
+        if (e != 255) {
+            bits = 23;
+            while (bits > 0 && units(bits) * ulp > max_abs) bits--;
+        }
+        masks[e] = lsb_mask(bits);
+    }
+}
+
+// This is to mask each value to its own exponent's level; returns the most mantissa bits any value kept.
+// Stochastic noise comes from (seed, stream) as in round_lsb().
+inline int mask_to_abs_error(const float *in, float *out, size_t n, double max_abs,
+                             Rounding rounding = Rounding::Truncate, uint64_t seed = kDefaultSeed, uint64_t stream = 0) {
+    uint32_t masks[256];
+    abs_error_masks(max_abs, masks, rounding);
+    PhiloxStream noise(PhiloxKey{seed, stream, detail::kRoundingSubstream});
+    uint32_t used = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = float_bits(in[i]);
+        uint32_t m = masks[(x >> 23) & 0xFF];
+        used |= m;
+        switch (rounding) {
+        case Rounding::NearestEven: x = detail::round_word(x, m, detail::nearest_even_add(x, m)); break;
+        case Rounding::Stochastic: x = detail::round_word(x, m, noise.next() & ~m); break;
+        default: x &= m; break;
+        }
+        out[i] = bits_float(x);
+    }
+    // Bits cleared by every mask used give the least aggressive level in the block
+    int cleared = 0;
+    while (n > 0 && cleared < 23 && !((used >> cleared) & 1u)) cleared++;
+    return 23 - cleared;
+}
+
+} // namespace lossy
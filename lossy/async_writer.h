@@ -0,0 +1,435 @@
+#pragma once
+
+// Asynchronous, double-buffered file output.
+//
+// AsyncWriter copies what it is given into page-aligned buffers and hands
+// every full buffer to the kernel without waiting for it, so the caller goes
+// back to encoding while the previous buffer is on its way to disk. The
+// caller only blocks when every buffer is still in flight, which is when the
+// disk, not the encoder, is the bottleneck; stall_seconds() reports that
+// time. End-to-end time therefore approaches max(compute, disk) instead of
+// their sum.
+//
+// Buffers are submitted through io_uring (raw system calls, no liburing)
+// where the kernel allows it, and otherwise to one I/O thread that pwrite()s
+// them in order. With `direct` the file is opened O_DIRECT and bypasses the
+// page cache; a filesystem that refuses O_DIRECT (tmpfs) gets buffered I/O.
+// The last buffer is padded to the alignment and the file truncated back.
+// Errors, including those of an earlier buffer, are reported as
+// std::runtime_error from write() or close().
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define LOSSY_HAVE_IO_URING 1
+#else
+#define LOSSY_HAVE_IO_URING 0
+#endif
+
+namespace lossy {
+
+enum class IoBackend { Auto, IoUring, Thread };
+
+inline const char *io_backend_name(IoBackend backend) {
+    switch (backend) {
+    case IoBackend::IoUring: return "io_uring";
+    case IoBackend::Thread: return "thread";
+    default: return "auto";
+    }
+}
+
+struct AsyncWriterOptions {
+    size_t buffer_bytes = size_t(4) << 20; // rounded up to the alignment
+    size_t buffers = 2;                    // 2 = double buffering
+    bool direct = false;                   // O_DIRECT, bypassing the page cache
+    IoBackend backend = IoBackend::Auto;   // Auto = io_uring when available, else the thread
+};
+
+// O_DIRECT needs buffer addresses, lengths and offsets aligned to the logical block size
+constexpr size_t kIoAlignment = 4096;
+
+namespace detail {
+
+// Writes of whole buffers at file offsets; wait() returns the tag of a finished one and its errno (0 = written)
+class IoQueue {
+public:
+    virtual ~IoQueue() = default;
+    virtual void submit(const unsigned char *data, size_t bytes, uint64_t offset, size_t tag) = 0;
+    virtual size_t wait(int &error) = 0;
+};
+
+// One thread pwrite()s the submitted buffers in order
+class ThreadIoQueue : public IoQueue {
+public:
+    explicit ThreadIoQueue(int fd) : fd_(fd), thread_([this] { run(); }) {}
+
+    ~ThreadIoQueue() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    void submit(const unsigned char *data, size_t bytes, uint64_t offset, size_t tag) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back({data, bytes, offset, tag});
+        }
+        cv_.notify_all();
+    }
+
+    size_t wait(int &error) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !done_.empty(); });
+        Request r = done_.front();
+        done_.pop_front();
+        error = r.error;
+        return r.tag;
+    }
+
+private:
+    struct Request {
+        const unsigned char *data;
+        size_t bytes;
+        uint64_t offset;
+        size_t tag;
+        int error = 0;
+    };
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            Request r = queue_.front();
+            queue_.pop_front();
+            lock.unlock();
+            size_t done = 0;
+            while (done < r.bytes) {
+                ssize_t n = ::pwrite(fd_, r.data + done, r.bytes - done, off_t(r.offset + done));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    r.error = n < 0 ? errno : EIO;
+                    break;
+                }
+                done += size_t(n);
+            }
+            lock.lock();
+            done_.push_back(r);
+            cv_.notify_all();
+        }
+    }
+
+    int fd_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request> queue_, done_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+#if LOSSY_HAVE_IO_URING
+// A minimal io_uring over the raw system calls: one IORING_OP_WRITE per buffer
+class UringIoQueue : public IoQueue {
+public:
+    // This is to set up a ring of `entries`; throws if the kernel (or a seccomp filter) refuses
+    UringIoQueue(int fd, unsigned entries) : fd_(fd) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof p);
+        ring_ = int(syscall(SYS_io_uring_setup, entries, &p));
+        if (ring_ < 0) throw std::runtime_error("io_uring_setup failed");
+        sq_bytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_bytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);
+        sq_ = map(sq_bytes_, IORING_OFF_SQ_RING);
+        cq_ = (p.features & IORING_FEAT_SINGLE_MMAP) ? sq_ : map(cq_bytes_, IORING_OFF_CQ_RING);
+        sqes_bytes_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(map(sqes_bytes_, IORING_OFF_SQES));
+        if (!sq_ || !cq_ || !sqes_) {
+            release();
+            throw std::runtime_error("io_uring mmap failed");
+        }
+        auto at = [](void *base, unsigned off) { return reinterpret_cast<unsigned *>(static_cast<char *>(base) + off); };
+        sq_tail_ = at(sq_, p.sq_off.tail);
+        sq_mask_ = *at(sq_, p.sq_off.ring_mask);
+        sq_array_ = at(sq_, p.sq_off.array);
+        cq_head_ = at(cq_, p.cq_off.head);
+        cq_tail_ = at(cq_, p.cq_off.tail);
+        cq_mask_ = *at(cq_, p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(cq_) + p.cq_off.cqes);
+    }
+
+    ~UringIoQueue() override {
+        // Buffers must not be freed under the kernel
+        try {
+            int error;
+            while (!pending_.empty()) wait(error);
+        } catch (...) {
+        }
+        release();
+    }
+
+    void submit(const unsigned char *data, size_t bytes, uint64_t offset, size_t tag) override {
+        pending_.push_back({data, bytes, offset, tag, 0});
+        push(pending_.back());
+    }
+
+    size_t wait(int &error) override {
+        for (;;) {
+            io_uring_cqe cqe;
+            while (!pop(cqe)) {
+                if (syscall(SYS_io_uring_enter, ring_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+                    throw std::runtime_error("io_uring_enter failed");
+            }
+            auto it = std::find_if(pending_.begin(), pending_.end(), [&](const Request &r) { return r.id == cqe.user_data; });
+            if (it == pending_.end()) throw std::runtime_error("io_uring completion for an unknown request");
+            // A short write resubmits the rest
+            error = cqe.res < 0 ? -cqe.res : cqe.res == 0 ? EIO : 0;
+            if (!error) it->done += size_t(cqe.res);
+            if (!error && it->done < it->bytes) {
+                push(*it);
+                continue;
+            }
+            size_t tag = it->tag;
+            pending_.erase(it);
+            return tag;
+        }
+    }
+
+private:
+    struct Request {
+        const unsigned char *data;
+        size_t bytes;
+        uint64_t offset;
+        size_t tag;
+        size_t done;
+        uint64_t id = 0;
+    };
+
+    void *map(size_t bytes, off_t what) {
+        void *p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_, what);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void release() {
+        if (sqes_) ::munmap(sqes_, sqes_bytes_);
+        if (cq_ && cq_ != sq_) ::munmap(cq_, cq_bytes_);
+        if (sq_) ::munmap(sq_, sq_bytes_);
+        if (ring_ >= 0) ::close(ring_);
+        sq_ = cq_ = nullptr;
+        sqes_ = nullptr;
+        ring_ = -1;
+    }
+
+    void push(Request &r) {
+        r.id = next_id_++;
+        unsigned tail = *sq_tail_;
+        unsigned index = tail & sq_mask_;
+        io_uring_sqe &sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof sqe);
+        sqe.opcode = IORING_OP_WRITE;
+        sqe.fd = fd_;
+        sqe.addr = uint64_t(reinterpret_cast<uintptr_t>(r.data + r.done));
+        sqe.len = unsigned(r.bytes - r.done);
+        sqe.off = r.offset + r.done;
+        sqe.user_data = r.id;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        while (syscall(SYS_io_uring_enter, ring_, 1, 0, 0, nullptr, 0) < 0) {
+            if (errno != EINTR) throw std::runtime_error("io_uring_enter failed");
+        }
+    }
+
+    bool pop(io_uring_cqe &out) {
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+        out = cqes_[head & cq_mask_];
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    int fd_;
+    int ring_ = -1;
+    void *sq_ = nullptr, *cq_ = nullptr;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sq_bytes_ = 0, cq_bytes_ = 0, sqes_bytes_ = 0;
+    unsigned *sq_tail_ = nullptr, *sq_array_ = nullptr, *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned sq_mask_ = 0, cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+    std::vector<Request> pending_;
+    uint64_t next_id_ = 1;
+};
+#endif
+
+struct AlignedFree {
+    void operator()(unsigned char *p) const { std::free(p); }
+};
+
+} // namespace detail
+
+class AsyncWriter {
+public:
+    AsyncWriter(const std::string &filename, const AsyncWriterOptions &opt = {}) : opt_(opt) {
+        opt_.buffers = std::max<size_t>(opt_.buffers, 1);
+        opt_.buffer_bytes = std::max(kIoAlignment, (opt_.buffer_bytes + kIoAlignment - 1) / kIoAlignment * kIoAlignment);
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+        if (opt_.direct) {
+            fd_ = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+            if (fd_ < 0 && errno != EINVAL) throw std::runtime_error("cannot open " + filename);
+        }
+#endif
+        direct_ = fd_ >= 0;
+        if (fd_ < 0) fd_ = ::open(filename.c_str(), flags, 0644);
+        if (fd_ < 0) throw std::runtime_error("cannot open " + filename);
+
+        for (size_t i = 0; i < opt_.buffers; i++) {
+            void *p = std::aligned_alloc(kIoAlignment, opt_.buffer_bytes);
+            if (!p) {
+                ::close(fd_);
+                throw std::runtime_error("cannot allocate I/O buffers");
+            }
+            buffers_.emplace_back(static_cast<unsigned char *>(p));
+        }
+        busy_.assign(opt_.buffers, false);
+        queue_ = make_queue();
+    }
+
+    ~AsyncWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+        queue_.reset();
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    AsyncWriter(const AsyncWriter &) = delete;
+    AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+    // This is to append bytes; blocks only while every buffer is still being written
+    void write(const void *data, size_t bytes) {
+        if (closed_) throw std::runtime_error("write to a closed AsyncWriter");
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        while (bytes > 0) {
+            size_t take = std::min(bytes, opt_.buffer_bytes - fill_);
+            std::memcpy(buffers_[current_].get() + fill_, p, take);
+            fill_ += take;
+            p += take;
+            bytes -= take;
+            if (fill_ == opt_.buffer_bytes) submit_current();
+        }
+    }
+
+    // This is to write the buffered tail, wait for every write and set the final size
+    void close() {
+        if (closed_) return;
+        closed_ = true;
+        uint64_t size = submitted_ + fill_;
+        if (fill_ > 0) {
+            // O_DIRECT writes whole blocks; the padding is cut off below
+            if (direct_) {
+                size_t padded = (fill_ + kIoAlignment - 1) / kIoAlignment * kIoAlignment;
+                std::memset(buffers_[current_].get() + fill_, 0, padded - fill_);
+                fill_ = padded;
+            }
+            submit_current();
+        }
+        for (size_t i = 0; i < busy_.size(); i++) {
+            while (busy_[i]) reap();
+        }
+        if (direct_ && ::ftruncate(fd_, off_t(size)) != 0) throw std::runtime_error("ftruncate failed");
+        submitted_ = size;
+        int rc = ::close(fd_);
+        fd_ = -1;
+        if (rc != 0) throw std::runtime_error("close failed");
+    }
+
+    uint64_t bytes_written() const { return submitted_ + fill_; }
+    IoBackend backend() const { return backend_; }
+    bool direct() const { return direct_; }
+    // Time write() spent waiting for a free buffer, i.e. not overlapped with the caller's work
+    double stall_seconds() const { return stall_seconds_; }
+
+private:
+    std::unique_ptr<detail::IoQueue> make_queue() {
+#if LOSSY_HAVE_IO_URING
+        if (opt_.backend != IoBackend::Thread) {
+            try {
+                backend_ = IoBackend::IoUring;
+                return std::make_unique<detail::UringIoQueue>(fd_, unsigned(std::max<size_t>(opt_.buffers, 2)));
+            } catch (const std::runtime_error &) {
+                if (opt_.backend == IoBackend::IoUring) {
+                    ::close(fd_);
+                    throw;
+                }
+            }
+        }
+#else
+        if (opt_.backend == IoBackend::IoUring) {
+            ::close(fd_);
+            throw std::runtime_error("io_uring is not available in this build");
+        }
+#endif
+        backend_ = IoBackend::Thread;
+        return std::make_unique<detail::ThreadIoQueue>(fd_);
+    }
+
+    // This is to wait for one write to finish and free its buffer
+    void reap() {
+        int error = 0;
+        busy_[queue_->wait(error)] = false;
+        if (error) throw std::runtime_error(std::string("write failed: ") + std::strerror(error));
+    }
+
+    void submit_current() {
+        busy_[current_] = true;
+        queue_->submit(buffers_[current_].get(), fill_, submitted_, current_);
+        submitted_ += fill_;
+        fill_ = 0;
+        current_ = (current_ + 1) % buffers_.size();
+        if (busy_[current_]) {
+            using Clock = std::chrono::steady_clock;
+            auto t0 = Clock::now();
+            while (busy_[current_]) reap();
+            stall_seconds_ += std::chrono::duration<double>(Clock::now() - t0).count();
+        }
+    }
+
+    AsyncWriterOptions opt_;
+    int fd_ = -1;
+    bool direct_ = false;
+    IoBackend backend_ = IoBackend::Thread;
+    std::vector<std::unique_ptr<unsigned char, detail::AlignedFree>> buffers_;
+    std::vector<bool> busy_;
+    std::unique_ptr<detail::IoQueue> queue_;
+    size_t current_ = 0;
+    size_t fill_ = 0;
+    uint64_t submitted_ = 0;
+    double stall_seconds_ = 0.0;
+    bool closed_ = false;
+};
+
+} // namespace lossy
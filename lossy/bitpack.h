@@ -0,0 +1,219 @@
+#pragma once
+
+// Dense bit-packing of fixed-width fields.
+//
+// A zeroed mantissa LSB still costs a bit in a float32 file: mask_lsb()
+// clears bits, it does not remove them. pack_floats() stores only the sign,
+// the exponent and the kept mantissa bits of each value (22 bits for
+// bits_to_zero = 10) back to back, LSB-first, so the size is exactly
+// ceil(n * (32 - bits_to_zero) / 8) bytes with no entropy coder involved.
+// unpack_floats() puts the fields back with zeros below them, which is the
+// same array mask_lsb() produced.
+//
+// The general form, pack_fields() / unpack_fields(), takes any contiguous
+// field mask of a 32-bit word; minifloat.h uses it for codes that are not a
+// whole number of bytes wide. Values are handled in pairs: one 64-bit load
+// holds two words, the BMI2 kernel squeezes both fields out with a single
+// pext (and puts them back with a single pdep), the portable kernel does the
+// same with shifts. The packed pairs go through a 64-bit accumulator that is
+// stored a full word at a time. The BMI2 kernel is picked at runtime.
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "bitstream.h"
+#include "common.h"
+#include "deflate.h"
+
+namespace lossy {
+
+// This is to check for the BMI2 pext/pdep instructions
+inline bool cpu_has_bmi2() {
+#if LOSSY_X86
+    static const bool has = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("bmi2");
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+// This is to get the packed size of n fields of `width` bits
+inline size_t packed_bytes(size_t n, int width) { return (n * size_t(width) + 7) / 8; }
+
+namespace detail {
+
+// A field mask must be one run of set bits
+inline void check_field_mask(uint32_t mask) {
+    if (mask == 0 || ((mask >> __builtin_ctz(mask)) & ((mask >> __builtin_ctz(mask)) + 1u)) != 0)
+        throw std::runtime_error("bit-pack field mask must be contiguous and non-empty");
+}
+
+// Appends `bits` (<= 64) bits to the accumulator, storing it whenever 64 bits are full
+struct PackSink {
+    unsigned char *ptr;
+    uint64_t acc = 0;
+    int used = 0;
+
+    void put(uint64_t value, int bits) {
+        acc |= value << used;
+        used += bits;
+        if (used >= 64) {
+            std::memcpy(ptr, &acc, sizeof acc);
+            ptr += sizeof acc;
+            used -= 64;
+            // The high bits of value that did not fit start the next word
+            acc = used ? value >> (bits - used) : 0;
+        }
+    }
+
+    void finish() {
+        std::memcpy(ptr, &acc, size_t(used + 7) / 8);
+        ptr += (used + 7) / 8;
+    }
+};
+
+// Reads bits LSB-first; get() loads 16 bytes so a 64-bit field can start anywhere in a byte
+struct UnpackSource {
+    const unsigned char *data;
+    size_t pos = 0;
+
+    uint64_t get(int bits) {
+        unsigned __int128 window;
+        std::memcpy(&window, data + (pos >> 3), sizeof window);
+        uint64_t value = uint64_t(window >> (pos & 7));
+        pos += size_t(bits);
+        return bits == 64 ? value : value & ((uint64_t(1) << bits) - 1);
+    }
+};
+
+inline void pack_fields_scalar(const uint32_t *words, size_t n, uint32_t mask, unsigned char *out) {
+    const int shift = __builtin_ctz(mask), width = __builtin_popcount(mask);
+    PackSink sink{out};
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint64_t pair = uint64_t((words[i] & mask) >> shift) | uint64_t((words[i + 1] & mask) >> shift) << width;
+        sink.put(pair, 2 * width);
+    }
+    if (i < n) sink.put((words[i] & mask) >> shift, width);
+    sink.finish();
+}
+
+// `bytes` is the size of the packed buffer; the last 16 bytes are read through the bounded tail
+inline void unpack_fields_scalar(const unsigned char *in, size_t bytes, size_t n, uint32_t mask, uint32_t *words) {
+    const int shift = __builtin_ctz(mask), width = __builtin_popcount(mask);
+    const uint64_t low = (uint64_t(1) << width) - 1;
+    UnpackSource source{in};
+    size_t i = 0;
+    for (; i + 2 <= n && (source.pos >> 3) + 16 <= bytes; i += 2) {
+        uint64_t pair = source.get(2 * width);
+        words[i] = uint32_t(pair & low) << shift;
+        words[i + 1] = uint32_t((pair >> width) & low) << shift;
+    }
+    BitReader tail(in + (source.pos >> 3), bytes - (source.pos >> 3));
+    tail.skip(int(source.pos & 7));
+    for (; i < n; i++) words[i] = uint32_t(tail.get(width)) << shift;
+}
+
+#if LOSSY_X86
+__attribute__((target("bmi2")))
+inline void pack_fields_bmi2(const uint32_t *words, size_t n, uint32_t mask, unsigned char *out) {
+    const int width = __builtin_popcount(mask);
+    const uint64_t pair_mask = uint64_t(mask) | uint64_t(mask) << 32;
+    PackSink sink{out};
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint64_t pair;
+        std::memcpy(&pair, words + i, sizeof pair);
+        sink.put(_pext_u64(pair, pair_mask), 2 * width);
+    }
+    if (i < n) sink.put(_pext_u32(words[i], mask), width);
+    sink.finish();
+}
+
+__attribute__((target("bmi2")))
+inline void unpack_fields_bmi2(const unsigned char *in, size_t bytes, size_t n, uint32_t mask, uint32_t *words) {
+    const int width = __builtin_popcount(mask);
+    const uint64_t pair_mask = uint64_t(mask) | uint64_t(mask) << 32;
+    UnpackSource source{in};
+    size_t i = 0;
+    for (; i + 2 <= n && (source.pos >> 3) + 16 <= bytes; i += 2) {
+        uint64_t pair = _pdep_u64(source.get(2 * width), pair_mask);
+        std::memcpy(words + i, &pair, sizeof pair);
+    }
+    BitReader tail(in + (source.pos >> 3), bytes - (source.pos >> 3));
+    tail.skip(int(source.pos & 7));
+    for (; i < n; i++) words[i] = _pdep_u32(uint32_t(tail.get(width)), mask);
+}
+#endif
+
+} // namespace detail
+
+// This is to pack the `mask` bits of n words into packed_bytes(n, popcount(mask)) bytes, choosing the kernel
+inline void pack_fields(const uint32_t *words, size_t n, uint32_t mask, unsigned char *out, bool use_bmi2) {
+    detail::check_field_mask(mask);
+#if LOSSY_X86
+    if (use_bmi2) return detail::pack_fields_bmi2(words, n, mask, out);
+#endif
+    (void)use_bmi2;
+    detail::pack_fields_scalar(words, n, mask, out);
+}
+
+inline void pack_fields(const uint32_t *words, size_t n, uint32_t mask, unsigned char *out) {
+    pack_fields(words, n, mask, out, cpu_has_bmi2());
+}
+
+// This is to put n packed fields back at their `mask` position (other bits zero); throws if `bytes` is too short
+inline void unpack_fields(const unsigned char *in, size_t bytes, size_t n, uint32_t mask, uint32_t *words,
+                          bool use_bmi2) {
+    detail::check_field_mask(mask);
+    if (bytes < packed_bytes(n, __builtin_popcount(mask))) throw std::runtime_error("bit-packed payload truncated");
+#if LOSSY_X86
+    if (use_bmi2) return detail::unpack_fields_bmi2(in, bytes, n, mask, words);
+#endif
+    (void)use_bmi2;
+    detail::unpack_fields_scalar(in, bytes, n, mask, words);
+}
+
+inline void unpack_fields(const unsigned char *in, size_t bytes, size_t n, uint32_t mask, uint32_t *words) {
+    unpack_fields(in, bytes, n, mask, words, cpu_has_bmi2());
+}
+
+// This is to get the packed size of n floats with bits_to_zero mantissa LSBs dropped
+inline size_t packed_float_bytes(size_t n, int bits_to_zero) { return packed_bytes(n, 32 - bits_to_zero); }
+
+// This is to store sign, exponent and the top 23 - bits_to_zero mantissa bits of n floats (the rest is truncated)
+inline void pack_floats(const float *in, size_t n, int bits_to_zero, unsigned char *out) {
+    if (bits_to_zero < 0 || bits_to_zero > 23) throw std::runtime_error("bits_to_zero must be in [0, 23]");
+    static_assert(sizeof(float) == sizeof(uint32_t), "float32 expected");
+    pack_fields(reinterpret_cast<const uint32_t *>(in), n, ~uint32_t(0) << bits_to_zero, out);
+}
+
+inline std::vector<unsigned char> pack_floats(const float *in, size_t n, int bits_to_zero) {
+    std::vector<unsigned char> out(packed_float_bytes(n, bits_to_zero));
+    pack_floats(in, n, bits_to_zero, out.data());
+    return out;
+}
+
+// This is to restore n floats from pack_floats() output, with the dropped bits zero
+inline void unpack_floats(const unsigned char *in, size_t bytes, size_t n, int bits_to_zero, float *out) {
+    if (bits_to_zero < 0 || bits_to_zero > 23) throw std::runtime_error("bits_to_zero must be in [0, 23]");
+    unpack_fields(in, bytes, n, ~uint32_t(0) << bits_to_zero, reinterpret_cast<uint32_t *>(out));
+}
+
+// This is to measure the packed size and pack/unpack speed of a buffer
+inline DeflateStats measure_bitpack(const float *data, size_t n, int bits_to_zero) {
+    std::vector<unsigned char> packed;
+    std::vector<float> restored(n);
+    return measure_codec(n * sizeof(float), [&] { return (packed = pack_floats(data, n, bits_to_zero)).size(); },
+                         [&] { unpack_floats(packed.data(), packed.size(), n, bits_to_zero, restored.data()); });
+}
+
+inline DeflateStats measure_bitpack(const std::vector<float> &data, int bits_to_zero) {
+    return measure_bitpack(data.data(), data.size(), bits_to_zero);
+}
+
+} // namespace lossy
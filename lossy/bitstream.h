@@ -0,0 +1,90 @@
+#pragma once
+
+// Word-at-a-time bit writer and reader.
+//
+// Bits are packed LSB-first into a 64-bit accumulator. BitWriter::put()
+// ORs the new field in and stores the whole accumulator with one unaligned
+// 8-byte write, then advances by the complete bytes; BitReader::peek() loads
+// the 8 bytes at the current byte offset and shifts. Neither has a branch per
+// bit or per byte, so variable-length codes cost a few instructions each.
+// Fields are at most 56 bits. The writer needs 8 bytes of slack past the
+// last byte it will produce; the reader handles the end of its buffer.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace lossy {
+
+class BitWriter {
+public:
+    // `out` must have room for the bits written plus 8 bytes
+    explicit BitWriter(unsigned char *out) : begin_(out), ptr_(out) {}
+
+    // This is to append a field of `bits` (<= 56) bits; value must not have higher bits set
+    void put(uint64_t value, int bits) {
+        acc_ |= value << used_;
+        used_ += bits;
+        std::memcpy(ptr_, &acc_, sizeof acc_);
+        // At most 63 bits are pending, so the shift below stays under 64
+        int bytes = used_ >> 3;
+        ptr_ += bytes;
+        acc_ >>= bytes * 8;
+        used_ &= 7;
+    }
+
+    // This is to flush the last partial byte; returns the bytes written
+    size_t finish() {
+        if (used_ > 0) {
+            *ptr_++ = static_cast<unsigned char>(acc_);
+            acc_ = 0;
+            used_ = 0;
+        }
+        return size_t(ptr_ - begin_);
+    }
+
+private:
+    unsigned char *begin_;
+    unsigned char *ptr_;
+    uint64_t acc_ = 0;
+    int used_ = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const unsigned char *data, size_t bytes) : data_(data), bytes_(bytes) {}
+
+    // This is to look at the next 56+ bits without consuming them (zeros past the end)
+    uint64_t peek() const {
+        size_t byte = pos_ >> 3;
+        uint64_t word = 0;
+        if (byte + 8 <= bytes_) {
+            std::memcpy(&word, data_ + byte, sizeof word);
+        } else if (byte < bytes_) {
+            std::memcpy(&word, data_ + byte, bytes_ - byte);
+        }
+        return word >> (pos_ & 7);
+    }
+
+    void skip(int bits) { pos_ += size_t(bits); }
+
+    // This is to read the next `bits` (<= 56) bits
+    uint64_t get(int bits) {
+        uint64_t value = peek() & low_bits(bits);
+        skip(bits);
+        return value;
+    }
+
+    // True once more bits were consumed than the buffer holds
+    bool overrun() const { return pos_ > bytes_ * 8; }
+    size_t position() const { return pos_; }
+
+    static uint64_t low_bits(int bits) { return bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1; }
+
+private:
+    const unsigned char *data_;
+    size_t bytes_;
+    size_t pos_ = 0;
+};
+
+} // namespace lossy
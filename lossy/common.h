@@ -0,0 +1,72 @@
+#pragma once
+
+// Platform helpers shared by the lossy/ kernels: CPU feature detection for
+// runtime SIMD dispatch and aliasing-safe float <-> bit pattern casts.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LOSSY_X86 1
+#else
+#define LOSSY_X86 0
+#endif
+
+namespace lossy {
+
+enum class SimdLevel { Scalar, SSE2, AVX2, AVX512 };
+
+inline const char *simd_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::SSE2: return "sse2";
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::AVX512: return "avx512";
+    default: return "scalar";
+    }
+}
+
+// This is to find the widest instruction set usable on the running CPU
+inline SimdLevel detect_simd() {
+#if LOSSY_X86
+    static const SimdLevel level = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+// This is to check for the F16C half-precision conversion instructions
+inline bool cpu_has_f16c() {
+#if LOSSY_X86
+    static const bool has = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+// Bit pattern <-> float without the aliasing UB of reinterpret_cast
+inline uint32_t float_bits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof bits);
+    return bits;
+}
+
+inline float bits_float(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof value);
+    return value;
+}
+
+} // namespace lossy
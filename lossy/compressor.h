@@ -0,0 +1,328 @@
+#pragma once
+
+// Pluggable lossless backends behind one interface.
+//
+// A Compressor encodes and decodes into caller-provided buffers and tells
+// how large the output buffer must be (bound()). make_compressor() builds
+// one from a backend name and a level:
+//
+//   gzip        zlib deflate with the gzip wrapper, levels 0..9 (always built)
+//   zstd        levels -5..19 (negative = fast modes); "zstd-long" adds
+//               long-distance matching with a 128 MiB window
+//   lz4         LZ4 fast mode; the level is the acceleration (1 = default)
+//   lz4hc       LZ4 high compression, levels 1..12
+//   libdeflate  raw deflate, levels 1..12
+//
+// zstd, LZ4 and libdeflate are optional: each is compiled in when
+// LOSSY_HAVE_ZSTD / LOSSY_HAVE_LZ4 / LOSSY_HAVE_LIBDEFLATE is defined (the
+// Makefile does this when the library's header is found, and adds
+// -lzstd / -llz4 / -ldeflate). compressor_available() reports what this
+// build has. Every call makes its own library context, so one Compressor
+// may be shared by the threads of a pool. Errors are std::runtime_error.
+// compress() and decompress() are the "compress"/"decompress" stages of
+// profile.h for every backend.
+
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "deflate.h"
+#include "profile.h"
+
+#if LOSSY_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#if LOSSY_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#if LOSSY_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+namespace lossy {
+
+// Stands for the backend's own default level
+constexpr int kDefaultLevel = INT_MIN;
+
+class Compressor {
+public:
+    virtual ~Compressor() = default;
+
+    // Backend and level, e.g. "zstd@19"
+    virtual std::string name() const = 0;
+    // Largest output compress() can produce for `bytes` of input
+    virtual size_t bound(size_t bytes) const = 0;
+
+    // This is to compress into out (capacity >= bound(bytes)); returns the compressed size
+    size_t compress(const void *in, size_t bytes, unsigned char *out, size_t capacity) const {
+        ScopedStage stage("compress", bytes / sizeof(float), bytes);
+        size_t produced = compress_block(in, bytes, out, capacity);
+        stage.set_bytes_out(produced);
+        return produced;
+    }
+
+    // This is to decompress into out, which must hold exactly the original size; returns the bytes written
+    size_t decompress(const unsigned char *in, size_t bytes, void *out, size_t capacity) const {
+        ScopedStage stage("decompress", capacity / sizeof(float), bytes, capacity);
+        return decompress_block(in, bytes, out, capacity);
+    }
+
+    std::vector<unsigned char> compress(const void *in, size_t bytes) const {
+        std::vector<unsigned char> out(bound(bytes));
+        out.resize(compress(in, bytes, out.data(), out.size()));
+        return out;
+    }
+
+protected:
+    // The backend itself; compress() and decompress() add the stage timing of profile.h
+    virtual size_t compress_block(const void *in, size_t bytes, unsigned char *out, size_t capacity) const = 0;
+    virtual size_t decompress_block(const unsigned char *in, size_t bytes, void *out, size_t capacity) const = 0;
+};
+
+namespace detail {
+
+inline std::string backend_label(const std::string &backend, int level) {
+    return backend + "@" + std::to_string(level);
+}
+
+inline void check_level(const std::string &backend, int level, int lowest, int highest) {
+    if (level < lowest || level > highest)
+        throw std::runtime_error(backend + " level must be in [" + std::to_string(lowest) + ", " +
+                                 std::to_string(highest) + "]: " + std::to_string(level));
+}
+
+class GzipCompressor : public Compressor {
+public:
+    explicit GzipCompressor(int level) : level_(level) { check_level("gzip", level, 0, 9); }
+    std::string name() const override { return backend_label("gzip", level_); }
+    size_t bound(size_t bytes) const override {
+        size_t total = 32; // gzip header and trailer
+        for (size_t left = bytes; left > 0; left -= std::min(left, kZlibSlice))
+            total += compressBound(uLong(std::min(left, kZlibSlice)));
+        return std::max<size_t>(total, compressBound(0) + 32);
+    }
+
+protected:
+    size_t compress_block(const void *in, size_t bytes, unsigned char *out, size_t capacity) const override {
+        size_t produced = 0;
+        GzipDeflater deflater(level_);
+        deflater.feed(in, bytes, true, [&](const unsigned char *p, size_t n) {
+            if (produced + n > capacity) throw std::runtime_error("gzip output buffer too small");
+            std::memcpy(out + produced, p, n);
+            produced += n;
+        });
+        return produced;
+    }
+    size_t decompress_block(const unsigned char *in, size_t bytes, void *out, size_t capacity) const override {
+        return detail::gzip_inflate(in, bytes, out, capacity);
+    }
+
+private:
+    int level_;
+};
+
+#if LOSSY_HAVE_ZSTD
+class ZstdCompressor : public Compressor {
+public:
+    ZstdCompressor(int level, bool long_mode) : level_(level), long_(long_mode) { check_level("zstd", level, -5, 19); }
+    std::string name() const override { return backend_label(long_ ? "zstd-long" : "zstd", level_); }
+    size_t bound(size_t bytes) const override { return ZSTD_compressBound(bytes); }
+
+protected:
+    size_t compress_block(const void *in, size_t bytes, unsigned char *out, size_t capacity) const override {
+        std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx *)> cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        if (!cctx) throw std::runtime_error("ZSTD_createCCtx failed");
+        ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, level_);
+        if (long_) {
+            ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_enableLongDistanceMatching, 1);
+            ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_windowLog, kLongWindowLog);
+        }
+        size_t rc = ZSTD_compress2(cctx.get(), out, capacity, in, bytes);
+        if (ZSTD_isError(rc)) throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(rc));
+        return rc;
+    }
+    size_t decompress_block(const unsigned char *in, size_t bytes, void *out, size_t capacity) const override {
+        std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        if (!dctx) throw std::runtime_error("ZSTD_createDCtx failed");
+        // Long mode frames may use a window above the decoder's default limit
+        ZSTD_DCtx_setParameter(dctx.get(), ZSTD_d_windowLogMax, kLongWindowLog);
+        size_t rc = ZSTD_decompressDCtx(dctx.get(), out, capacity, in, bytes);
+        if (ZSTD_isError(rc)) throw std::runtime_error(std::string("zstd: ") + ZSTD_getErrorName(rc));
+        return rc;
+    }
+
+private:
+    static constexpr int kLongWindowLog = 27;
+    int level_;
+    bool long_;
+};
+#endif
+
+#if LOSSY_HAVE_LZ4
+// LZ4 counts in int, so buffers are limited to LZ4_MAX_INPUT_SIZE
+inline int lz4_size(size_t bytes) {
+    if (bytes > size_t(LZ4_MAX_INPUT_SIZE)) throw std::runtime_error("buffer too large for lz4");
+    return int(bytes);
+}
+
+class Lz4Compressor : public Compressor {
+public:
+    Lz4Compressor(int level, bool hc) : level_(level), hc_(hc) {
+        if (hc) check_level("lz4hc", level, 1, LZ4HC_CLEVEL_MAX);
+        else check_level("lz4", level, 1, 65537);
+    }
+    std::string name() const override { return backend_label(hc_ ? "lz4hc" : "lz4", level_); }
+    size_t bound(size_t bytes) const override { return size_t(LZ4_compressBound(lz4_size(bytes))); }
+
+protected:
+    size_t compress_block(const void *in, size_t bytes, unsigned char *out, size_t capacity) const override {
+        const char *src = static_cast<const char *>(in);
+        char *dst = reinterpret_cast<char *>(out);
+        int cap = int(std::min(capacity, size_t(INT_MAX)));
+        int rc = hc_ ? LZ4_compress_HC(src, dst, lz4_size(bytes), cap, level_)
+                     : LZ4_compress_fast(src, dst, lz4_size(bytes), cap, level_);
+        if (rc <= 0 && bytes > 0) throw std::runtime_error("lz4 compression failed");
+        return size_t(rc);
+    }
+    size_t decompress_block(const unsigned char *in, size_t bytes, void *out, size_t capacity) const override {
+        int rc = LZ4_decompress_safe(reinterpret_cast<const char *>(in), static_cast<char *>(out), lz4_size(bytes),
+                                     lz4_size(capacity));
+        if (rc < 0) throw std::runtime_error("lz4 stream corrupt");
+        return size_t(rc);
+    }
+
+private:
+    int level_;
+    bool hc_;
+};
+#endif
+
+#if LOSSY_HAVE_LIBDEFLATE
+class LibdeflateCompressor : public Compressor {
+public:
+    explicit LibdeflateCompressor(int level) : level_(level) { check_level("libdeflate", level, 1, 12); }
+    std::string name() const override { return backend_label("libdeflate", level_); }
+    size_t bound(size_t bytes) const override { return libdeflate_deflate_compress_bound(nullptr, bytes); }
+
+protected:
+    size_t compress_block(const void *in, size_t bytes, unsigned char *out, size_t capacity) const override {
+        std::unique_ptr<libdeflate_compressor, void (*)(libdeflate_compressor *)> c(
+            libdeflate_alloc_compressor(level_), libdeflate_free_compressor);
+        if (!c) throw std::runtime_error("libdeflate_alloc_compressor failed");
+        size_t rc = libdeflate_deflate_compress(c.get(), in, bytes, out, capacity);
+        if (rc == 0 && bytes > 0) throw std::runtime_error("libdeflate output buffer too small");
+        return rc;
+    }
+    size_t decompress_block(const unsigned char *in, size_t bytes, void *out, size_t capacity) const override {
+        std::unique_ptr<libdeflate_decompressor, void (*)(libdeflate_decompressor *)> d(
+            libdeflate_alloc_decompressor(), libdeflate_free_decompressor);
+        if (!d) throw std::runtime_error("libdeflate_alloc_decompressor failed");
+        size_t produced = 0;
+        if (libdeflate_deflate_decompress(d.get(), in, bytes, out, capacity, &produced) != LIBDEFLATE_SUCCESS)
+            throw std::runtime_error("libdeflate stream corrupt");
+        return produced;
+    }
+
+private:
+    int level_;
+};
+#endif
+
+} // namespace detail
+
+// This is to list the backends of this build, in the order they are documented above
+inline std::vector<std::string> compressor_backends() {
+    std::vector<std::string> names{"gzip"};
+#if LOSSY_HAVE_ZSTD
+    names.insert(names.end(), {"zstd", "zstd-long"});
+#endif
+#if LOSSY_HAVE_LZ4
+    names.insert(names.end(), {"lz4", "lz4hc"});
+#endif
+#if LOSSY_HAVE_LIBDEFLATE
+    names.push_back("libdeflate");
+#endif
+    return names;
+}
+
+inline bool compressor_available(const std::string &backend) {
+    for (const std::string &name : compressor_backends())
+        if (name == backend) return true;
+    return false;
+}
+
+// This is to get the level a backend uses when none is given
+inline int default_level(const std::string &backend) {
+    if (backend == "gzip" || backend == "libdeflate") return kGzipDefaultLevel;
+    if (backend == "zstd" || backend == "zstd-long") return 3;
+    if (backend == "lz4") return 1;
+    if (backend == "lz4hc") return 9;
+    throw std::runtime_error("unknown compressor: " + backend);
+}
+
+// This is to get the lowest and highest level of a backend (for level sweeps)
+inline std::pair<int, int> level_range(const std::string &backend) {
+    if (backend == "gzip") return {1, 9};
+    if (backend == "zstd" || backend == "zstd-long") return {-5, 19};
+    if (backend == "lz4") return {1, 16};
+    if (backend == "lz4hc") return {1, 12};
+    if (backend == "libdeflate") return {1, 12};
+    throw std::runtime_error("unknown compressor: " + backend);
+}
+
+// This is to build a backend; throws if it is unknown or not compiled into this build
+inline std::unique_ptr<Compressor> make_compressor(const std::string &backend, int level) {
+    if (level == kDefaultLevel) level = default_level(backend);
+    if (backend == "gzip") return std::make_unique<detail::GzipCompressor>(level);
+    if (!compressor_available(backend)) {
+        default_level(backend); // unknown names throw here
+        throw std::runtime_error(backend + " support is not compiled in (install its headers and rebuild)");
+    }
+#if LOSSY_HAVE_ZSTD
+    if (backend == "zstd" || backend == "zstd-long")
+        return std::make_unique<detail::ZstdCompressor>(level, backend == "zstd-long");
+#endif
+#if LOSSY_HAVE_LZ4
+    if (backend == "lz4" || backend == "lz4hc") return std::make_unique<detail::Lz4Compressor>(level, backend == "lz4hc");
+#endif
+#if LOSSY_HAVE_LIBDEFLATE
+    if (backend == "libdeflate") return std::make_unique<detail::LibdeflateCompressor>(level);
+#endif
+    throw std::runtime_error("unknown compressor: " + backend);
+}
+
+inline std::unique_ptr<Compressor> make_compressor(const std::string &backend) {
+    return make_compressor(backend, kDefaultLevel);
+}
+
+// This is to measure (optionally shuffled) data through a backend; the speeds include the filter and its inverse
+inline DeflateStats measure_compressor(const Compressor &codec, const float *data, size_t n,
+                                       Shuffle mode = Shuffle::None) {
+    const size_t bytes = n * sizeof(float);
+    std::vector<unsigned char> shuffled(bytes), packed(codec.bound(bytes));
+    std::vector<float> restored(n);
+    size_t packed_bytes = 0;
+    return measure_codec(
+        bytes,
+        [&] {
+            shuffle4(mode, data, shuffled.data(), n);
+            return packed_bytes = codec.compress(shuffled.data(), bytes, packed.data(), packed.size());
+        },
+        [&] {
+            if (codec.decompress(packed.data(), packed_bytes, shuffled.data(), bytes) != bytes)
+                throw std::runtime_error(codec.name() + " decoded to the wrong size");
+            unshuffle4(mode, shuffled.data(), restored.data(), n);
+        });
+}
+
+inline DeflateStats measure_compressor(const Compressor &codec, const std::vector<float> &data,
+                                       Shuffle mode = Shuffle::None) {
+    return measure_compressor(codec, data.data(), data.size(), mode);
+}
+
+} // namespace lossy
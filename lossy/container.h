@@ -0,0 +1,518 @@
+#pragma once
+
+// Chunked, indexed container for lossy-compressed float arrays (.lfc files).
+//
+// Layout (all integers little-endian):
+//
+//   FileHeader                      16 bytes
+//   { ChunkHeader, payload } * N    one per chunk of up to chunk_elements values
+//   IndexEntry * N                  footer index, 24 bytes per chunk
+//   Footer                          32 bytes, always the last bytes of the file
+//
+// Every chunk header records its codec, filter, stored precision, number of
+// mantissa bits kept, element count, payload length and a CRC-32, so a chunk
+// can be decoded on its own. ContainerReader maps the file with mmap() and
+// decodes only the chunks overlapping the requested element range.
+//
+// A chunk's payload is written by one of these codecs (ContainerOptions::codec):
+//
+//   Raw         the filtered bytes as they are
+//   Gzip, Zstd, Lz4, Lz4HC, Libdeflate
+//               the filtered bytes through a lossless backend of compressor.h
+//               (the optional ones must be compiled in)
+//   Gorilla     XOR of neighbouring values (gorilla.h), unshuffled
+//   BitPack     only the bits_kept + 9 high bits of each value, densely packed (bitpack.h)
+//   Split       sign, exponent and mantissa planes, rANS on the exponents (split.h)
+//
+// The filter is a byte or bit shuffle (shuffle.h) for float32. A chunk can
+// instead be stored as float16 or any Precision of minifloat.h (bfloat16,
+// e4m3, e5m2, e8m15; saturating, default bias), which only the lossless
+// backends and Raw take.
+//
+// With ContainerOptions::tolerance set, each chunk gets the most aggressive
+// truncation that meets the error bound (per exponent band for absolute
+// bounds), and bits_kept records the widest mantissa left in the chunk.
+// ContainerOptions::rounding rounds the cleared bits away (nearest-even or
+// stochastic, rounding.h) instead of truncating; readers need not know.
+// Given AsyncWriterOptions, ContainerWriter hands its bytes to an AsyncWriter
+// (async_writer.h: io_uring or an I/O thread, optionally O_DIRECT), so
+// encoding the next chunk overlaps writing the last one.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "adaptive.h"
+#include "async_writer.h"
+#include "bitpack.h"
+#include "compressor.h"
+#include "deflate.h"
+#include "gorilla.h"
+#include "mask.h"
+#include "minifloat.h"
+#include "profile.h"
+#include "rounding.h"
+#include "shuffle.h"
+#include "split.h"
+
+namespace lossy {
+
+constexpr uint32_t kContainerVersion = 1;
+constexpr size_t kMaxChunkElements = size_t(1) << 28;
+
+enum class Codec : uint8_t {
+    Raw = 0,
+    Gzip = 1,
+    Gorilla = 2,
+    BitPack = 3,
+    Split = 4,
+    Zstd = 5,
+    Lz4 = 6,
+    Lz4HC = 7,
+    Libdeflate = 8,
+};
+
+inline const char *codec_name(Codec codec) {
+    switch (codec) {
+    case Codec::Gzip: return "gzip";
+    case Codec::Gorilla: return "gorilla";
+    case Codec::BitPack: return "bitpack";
+    case Codec::Split: return "split";
+    case Codec::Zstd: return "zstd";
+    case Codec::Lz4: return "lz4";
+    case Codec::Lz4HC: return "lz4hc";
+    case Codec::Libdeflate: return "libdeflate";
+    default: return "raw";
+    }
+}
+
+// This is to get the compressor.h backend of a codec, or nullptr for the codecs that are not lossless backends
+inline const char *codec_backend(Codec codec) {
+    switch (codec) {
+    case Codec::Gzip:
+    case Codec::Zstd:
+    case Codec::Lz4:
+    case Codec::Lz4HC:
+    case Codec::Libdeflate: return codec_name(codec);
+    default: return nullptr;
+    }
+}
+
+struct ContainerOptions {
+    size_t chunk_elements = size_t(1) << 20;
+    Codec codec = Codec::Gzip;
+    Shuffle shuffle = Shuffle::Byte;   // float32 only
+    Precision precision = Precision::Float32;
+    int bits_to_zero = 0;              // mantissa LSBs cleared before encoding
+    Tolerance tolerance;               // if set, bits_to_zero is chosen per chunk instead
+    Rounding rounding = Rounding::Truncate;
+    uint64_t seed = kDefaultSeed;      // stochastic rounding noise; each chunk uses its first element as stream
+    int level = kDefaultLevel;         // of the lossless backend; kDefaultLevel is its own default
+    bool long_window = false;          // zstd long-distance matching
+};
+
+#pragma pack(push, 1)
+struct FileHeader {
+    char magic[4];              // "LFCF"
+    uint32_t version;
+    uint32_t chunk_elements;    // nominal elements per chunk (the last one may be shorter)
+    uint32_t reserved;
+};
+
+struct ChunkHeader {
+    char magic[4];              // "LFCK"
+    uint8_t codec;
+    uint8_t shuffle;
+    uint8_t precision;
+    uint8_t bits_kept;          // most mantissa bits kept by any value (23 = lossless, 10 = float16, 3 = e4m3)
+    uint32_t element_count;
+    uint32_t crc32;             // of the payload
+    uint64_t compressed_length; // payload bytes following this header
+    uint64_t first_element;
+};
+
+struct IndexEntry {
+    uint64_t offset;            // file offset of the ChunkHeader
+    uint64_t first_element;
+    uint32_t element_count;
+    uint32_t reserved;
+};
+
+struct Footer {
+    uint64_t index_offset;
+    uint64_t chunk_count;
+    uint64_t total_elements;
+    uint32_t version;
+    char magic[4];              // "LFCX"
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FileHeader) == 16 && sizeof(ChunkHeader) == 32, "container layout");
+static_assert(sizeof(IndexEntry) == 24 && sizeof(Footer) == 32, "container layout");
+
+// One encoded chunk, ready to be written
+struct EncodedChunk {
+    ChunkHeader header{};
+    std::vector<unsigned char> payload;
+};
+
+inline int bits_kept_for(const ContainerOptions &opt) {
+    if (opt.precision != Precision::Float32) return precision_mantissa_bits(opt.precision);
+    return 23 - std::min(std::max(opt.bits_to_zero, 0), 23);
+}
+
+// This is to truncate or round one float32 chunk into out; returns the mantissa bits kept.
+// Other precisions are converted by the codec, so their values are copied unchanged.
+inline int truncate_chunk(const float *data, float *out, size_t n, uint64_t first_element, const ContainerOptions &opt) {
+    if (opt.precision != Precision::Float32) {
+        std::copy(data, data + n, out);
+        return bits_kept_for(opt);
+    }
+    if (opt.tolerance.bound == ErrorBound::Absolute && opt.tolerance.per_exponent)
+        return mask_to_abs_error(data, out, n, opt.tolerance.value, opt.rounding, opt.seed, first_element);
+    int bits_kept = bits_kept_for(opt);
+    if (opt.tolerance.bound != ErrorBound::None) bits_kept = 23 - choose_bits_to_zero(data, n, opt.tolerance, opt.rounding);
+    round_lsb(data, out, n, 23 - bits_kept, opt.rounding, opt.seed, first_element);
+    return bits_kept;
+}
+
+// This is to convert, filter and compress a chunk that truncate_chunk() produced
+inline EncodedChunk encode_truncated_chunk(const float *masked, size_t n, uint64_t first_element, int bits_kept,
+                                           const ContainerOptions &opt) {
+    if ((opt.codec == Codec::Gorilla || opt.codec == Codec::BitPack || opt.codec == Codec::Split) &&
+        opt.precision != Precision::Float32)
+        throw std::runtime_error(std::string("the ") + codec_name(opt.codec) + " codec needs float32 storage");
+    EncodedChunk chunk;
+    ChunkHeader &h = chunk.header;
+    std::memcpy(h.magic, "LFCK", 4);
+    h.codec = uint8_t(opt.codec);
+    h.precision = uint8_t(opt.precision);
+    h.bits_kept = uint8_t(bits_kept);
+    h.element_count = uint32_t(n);
+    h.first_element = first_element;
+
+    std::vector<unsigned char> raw;
+    if (opt.precision != Precision::Float32) {
+        h.shuffle = uint8_t(Shuffle::None);
+        raw.resize(n * precision_bytes(opt.precision));
+        encode_precision(opt.precision, masked, raw.data(), n);
+    } else {
+        // Gorilla XORs neighbouring values and BitPack/Split take each value apart, so they get them unshuffled
+        const bool per_value = opt.codec == Codec::Gorilla || opt.codec == Codec::BitPack || opt.codec == Codec::Split;
+        h.shuffle = uint8_t(per_value ? Shuffle::None : opt.shuffle);
+        if (per_value) {
+            ScopedStage stage("compress", n, n * sizeof(float));
+            if (opt.codec == Codec::Gorilla) chunk.payload = gorilla_encode(masked, n);
+            if (opt.codec == Codec::BitPack) chunk.payload = pack_floats(masked, n, 23 - h.bits_kept);
+            if (opt.codec == Codec::Split) chunk.payload = split_encode(masked, n, 23 - h.bits_kept);
+            stage.set_bytes_out(chunk.payload.size());
+        } else {
+            raw.resize(n * sizeof(float));
+            shuffle4(opt.shuffle, masked, raw.data(), n);
+        }
+    }
+
+    if (const char *backend = codec_backend(opt.codec)) {
+        std::string name = backend;
+        if (opt.long_window && opt.codec == Codec::Zstd) name += "-long";
+        chunk.payload = make_compressor(name, opt.level)->compress(raw.data(), raw.size());
+    } else if (opt.codec == Codec::Raw) {
+        chunk.payload = std::move(raw);
+    }
+    h.compressed_length = chunk.payload.size();
+    h.crc32 = uint32_t(::crc32(0L, chunk.payload.data(), uInt(chunk.payload.size())));
+    return chunk;
+}
+
+// This is to truncate, convert, filter and compress one chunk
+inline EncodedChunk encode_chunk(const float *data, size_t n, uint64_t first_element, const ContainerOptions &opt) {
+    if (opt.precision != Precision::Float32) return encode_truncated_chunk(data, n, first_element, bits_kept_for(opt), opt);
+    std::vector<float> masked(n);
+    int bits_kept = truncate_chunk(data, masked.data(), n, first_element, opt);
+    return encode_truncated_chunk(masked.data(), n, first_element, bits_kept, opt);
+}
+
+// This is to decode a chunk payload into h.element_count floats
+inline void decode_chunk(const ChunkHeader &h, const unsigned char *payload, float *out) {
+    if (std::memcmp(h.magic, "LFCK", 4) != 0) throw std::runtime_error("bad chunk header");
+    if (uint32_t(::crc32(0L, payload, uInt(h.compressed_length))) != h.crc32)
+        throw std::runtime_error("chunk checksum mismatch");
+    const size_t n = h.element_count;
+    if (h.precision > uint8_t(Precision::E8M15)) throw std::runtime_error("unsupported chunk precision");
+    if (h.shuffle > uint8_t(Shuffle::Bit)) throw std::runtime_error("unsupported chunk shuffle");
+    const size_t elem = precision_bytes(Precision(h.precision));
+    if (h.precision == uint8_t(Precision::Float32) &&
+        (h.codec == uint8_t(Codec::Gorilla) || h.codec == uint8_t(Codec::BitPack) || h.codec == uint8_t(Codec::Split))) {
+        ScopedStage stage("decompress", n, h.compressed_length, n * sizeof(float));
+        if (h.codec == uint8_t(Codec::Gorilla)) return gorilla_decode(payload, h.compressed_length, out, n);
+        if (h.codec == uint8_t(Codec::Split)) return split_decode(payload, h.compressed_length, out, n);
+        if (h.bits_kept > 23) throw std::runtime_error("bad chunk bits_kept");
+        return unpack_floats(payload, h.compressed_length, n, 23 - h.bits_kept, out);
+    }
+
+    std::vector<unsigned char> raw;
+    const unsigned char *bytes = payload;
+    if (const char *backend = codec_backend(Codec(h.codec))) {
+        raw.resize(n * elem);
+        if (make_compressor(backend)->decompress(payload, h.compressed_length, raw.data(), raw.size()) != raw.size())
+            throw std::runtime_error("chunk decoded to the wrong size");
+        bytes = raw.data();
+    } else if (h.codec != uint8_t(Codec::Raw) || h.compressed_length != n * elem) {
+        throw std::runtime_error("unsupported chunk codec");
+    }
+
+    if (h.precision != uint8_t(Precision::Float32)) {
+        decode_precision(Precision(h.precision), bytes, out, n);
+    } else {
+        unshuffle4(Shuffle(h.shuffle), bytes, out, n);
+    }
+}
+
+// Appends values and writes a chunk each time chunk_elements are buffered
+class ContainerWriter {
+public:
+    ContainerWriter(const std::string &filename, const ContainerOptions &opt = {})
+        : file_(filename, std::ios::binary), opt_(opt) {
+        if (!file_) throw std::runtime_error("cannot open " + filename);
+        start();
+    }
+
+    // This is to write through an AsyncWriter instead of a blocking ofstream
+    ContainerWriter(const std::string &filename, const ContainerOptions &opt, const AsyncWriterOptions &io)
+        : async_(std::make_unique<AsyncWriter>(filename, io)), opt_(opt) {
+        start();
+    }
+
+    ~ContainerWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    ContainerWriter(const ContainerWriter &) = delete;
+    ContainerWriter &operator=(const ContainerWriter &) = delete;
+
+    void write(const float *data, size_t n) {
+        while (n > 0) {
+            size_t take = std::min(n, opt_.chunk_elements - pending_.size());
+            pending_.insert(pending_.end(), data, data + take);
+            data += take;
+            n -= take;
+            if (pending_.size() == opt_.chunk_elements) flush_pending();
+        }
+    }
+
+    void write(const std::vector<float> &data) { write(data.data(), data.size()); }
+
+    // This is to append a chunk that was encoded elsewhere (e.g. on another thread)
+    void write_encoded(const EncodedChunk &chunk) {
+        ScopedStage stage("write", chunk.header.element_count, sizeof chunk.header + chunk.payload.size(),
+                          sizeof chunk.header + chunk.payload.size());
+        if (!pending_.empty()) throw std::runtime_error("write_encoded with buffered values pending");
+        if (chunk.header.first_element != total_) throw std::runtime_error("chunks written out of order");
+        index_.push_back({offset_, total_, chunk.header.element_count, 0});
+        put(&chunk.header, sizeof chunk.header);
+        put(chunk.payload.data(), chunk.payload.size());
+        total_ += chunk.header.element_count;
+    }
+
+    void close() {
+        if (closed_) return;
+        closed_ = true;
+        flush_pending();
+        Footer footer{};
+        footer.index_offset = offset_;
+        footer.chunk_count = index_.size();
+        footer.total_elements = total_;
+        footer.version = kContainerVersion;
+        std::memcpy(footer.magic, "LFCX", 4);
+        put(index_.data(), index_.size() * sizeof(IndexEntry));
+        put(&footer, sizeof footer);
+        if (async_) {
+            async_->close();
+            return;
+        }
+        file_.close();
+        if (!file_) throw std::runtime_error("container write failed");
+    }
+
+    const ContainerOptions &options() const { return opt_; }
+    uint64_t bytes_written() const { return offset_; }
+    uint64_t elements_written() const { return total_; }
+    bool has_pending() const { return !pending_.empty(); }
+    // The asynchronous writer, if there is one (backend, stall time)
+    const AsyncWriter *async_writer() const { return async_.get(); }
+
+private:
+    void start() {
+        // zlib's crc32/deflate take 32-bit lengths, so keep chunks below 1 GiB
+        if (opt_.chunk_elements == 0 || opt_.chunk_elements > kMaxChunkElements)
+            throw std::runtime_error("chunk_elements out of range");
+        FileHeader fh{};
+        std::memcpy(fh.magic, "LFCF", 4);
+        fh.version = kContainerVersion;
+        fh.chunk_elements = uint32_t(opt_.chunk_elements);
+        put(&fh, sizeof fh);
+        pending_.reserve(opt_.chunk_elements);
+    }
+
+    void put(const void *p, size_t n) {
+        if (async_) {
+            async_->write(p, n);
+        } else {
+            file_.write(static_cast<const char *>(p), std::streamsize(n));
+        }
+        offset_ += n;
+    }
+
+    void flush_pending() {
+        if (pending_.empty()) return;
+        EncodedChunk chunk = encode_chunk(pending_.data(), pending_.size(), total_, opt_);
+        pending_.clear();
+        write_encoded(chunk);
+    }
+
+    std::ofstream file_;
+    std::unique_ptr<AsyncWriter> async_;
+    ContainerOptions opt_;
+    std::vector<float> pending_;
+    std::vector<IndexEntry> index_;
+    uint64_t offset_ = 0;
+    uint64_t total_ = 0;
+    bool closed_ = false;
+};
+
+// Random-access reader over an mmap()ed container
+class ContainerReader {
+public:
+    explicit ContainerReader(const std::string &filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open " + filename);
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(FileHeader) + sizeof(Footer)) {
+            ::close(fd);
+            throw std::runtime_error("not a container: " + filename);
+        }
+        size_ = size_t(st.st_size);
+        void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) throw std::runtime_error("mmap failed: " + filename);
+        base_ = static_cast<const unsigned char *>(p);
+        // Slices only touch a few chunks, so skip kernel read-ahead
+        ::madvise(p, size_, MADV_RANDOM);
+
+        FileHeader fh;
+        std::memcpy(&fh, base_, sizeof fh);
+        std::memcpy(&footer_, base_ + size_ - sizeof footer_, sizeof footer_);
+        // The chunk count is bounded first so the index size cannot overflow
+        if (std::memcmp(fh.magic, "LFCF", 4) != 0 || std::memcmp(footer_.magic, "LFCX", 4) != 0 ||
+            footer_.chunk_count > (size_ - sizeof(Footer)) / sizeof(IndexEntry) ||
+            footer_.index_offset != size_ - sizeof(Footer) - footer_.chunk_count * sizeof(IndexEntry) ||
+            footer_.index_offset < sizeof(FileHeader)) {
+            unmap();
+            throw std::runtime_error("corrupt container: " + filename);
+        }
+        if (fh.version > kContainerVersion || footer_.version > kContainerVersion) {
+            unmap();
+            throw std::runtime_error("unsupported container version: " + filename);
+        }
+        chunk_elements_ = fh.chunk_elements;
+        index_.resize(footer_.chunk_count);
+        std::memcpy(index_.data(), base_ + footer_.index_offset, index_.size() * sizeof(IndexEntry));
+    }
+
+    ~ContainerReader() { unmap(); }
+    ContainerReader(const ContainerReader &) = delete;
+    ContainerReader &operator=(const ContainerReader &) = delete;
+
+    size_t size() const { return size_t(footer_.total_elements); }
+    size_t chunk_count() const { return index_.size(); }
+    size_t chunk_elements() const { return chunk_elements_; }
+    size_t file_bytes() const { return size_; }
+    const IndexEntry &index(size_t i) const { return index_[i]; }
+
+    // This is to read the header of chunk i; it must lie in the data section and agree with the index
+    ChunkHeader chunk_header(size_t i) const {
+        const IndexEntry &e = index_[i];
+        if (e.offset < sizeof(FileHeader) || e.offset > footer_.index_offset ||
+            footer_.index_offset - e.offset < sizeof(ChunkHeader))
+            throw std::runtime_error("chunk header outside the data section");
+        ChunkHeader h;
+        std::memcpy(&h, base_ + e.offset, sizeof h);
+        if (h.element_count != e.element_count || h.first_element != e.first_element)
+            throw std::runtime_error("chunk header does not match the index");
+        return h;
+    }
+
+    // This is to decode chunk i into out (index(i).element_count floats)
+    void read_chunk(size_t i, float *out) const {
+        ChunkHeader h = chunk_header(i);
+        const unsigned char *payload = base_ + index_[i].offset + sizeof h;
+        if (h.compressed_length > footer_.index_offset - index_[i].offset - sizeof h)
+            throw std::runtime_error("chunk extends past the data section");
+        decode_chunk(h, payload, out);
+    }
+
+    // This is to decode elements [first, first + count) touching only the chunks needed
+    void read(size_t first, size_t count, float *out) const {
+        if (first > size() || count > size() - first) throw std::out_of_range("container read out of range");
+        if (count == 0) return;
+        // Last chunk whose first element is <= first
+        auto it = std::upper_bound(index_.begin(), index_.end(), uint64_t(first),
+                                   [](uint64_t v, const IndexEntry &e) { return v < e.first_element; });
+        if (it == index_.begin()) throw std::runtime_error("container index does not cover the range");
+        size_t c = size_t(it - index_.begin()) - 1;
+        std::vector<float> scratch;
+        while (count > 0) {
+            // Chunks must follow each other without gaps
+            if (c >= index_.size() || index_[c].first_element > first ||
+                first - index_[c].first_element >= index_[c].element_count)
+                throw std::runtime_error("container index does not cover the range");
+            const IndexEntry &e = index_[c];
+            size_t skip = first - e.first_element;
+            size_t take = std::min<size_t>(count, e.element_count - skip);
+            if (skip == 0 && take == e.element_count) {
+                read_chunk(c, out);
+            } else {
+                scratch.resize(e.element_count);
+                read_chunk(c, scratch.data());
+                std::memcpy(out, scratch.data() + skip, take * sizeof(float));
+            }
+            out += take;
+            first += take;
+            count -= take;
+            c++;
+        }
+    }
+
+    std::vector<float> read(size_t first, size_t count) const {
+        std::vector<float> out(count);
+        read(first, count, out.data());
+        return out;
+    }
+
+private:
+    void unmap() {
+        if (base_) ::munmap(const_cast<unsigned char *>(base_), size_);
+        base_ = nullptr;
+    }
+
+    const unsigned char *base_ = nullptr;
+    size_t size_ = 0;
+    size_t chunk_elements_ = 0;
+    Footer footer_{};
+    std::vector<IndexEntry> index_;
+};
+
+} // namespace lossy
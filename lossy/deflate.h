@@ -0,0 +1,218 @@
+#pragma once
+
+// In-process gzip (deflate) stage built on zlib.
+//
+// Compresses straight from memory, either into a counting sink (only the
+// compressed size is kept), into a byte vector, or into a real .gz file, so
+// measuring sizes never needs a temporary file or a `gzip` subprocess.
+// measure_gzip() can optionally run a byte/bit shuffle (shuffle.h) first,
+// and file_crc32() checksums a file of any size block by block.
+// Link with -lz. zlib errors are reported as std::runtime_error.
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "profile.h"
+#include "shuffle.h"
+
+namespace lossy {
+
+// Same default as the gzip command line tool
+constexpr int kGzipDefaultLevel = 6;
+
+struct DeflateStats {
+    size_t raw_bytes = 0;
+    size_t compressed_bytes = 0;
+    double compress_mbps = 0.0;   // raw MB per second of compression
+    double decompress_mbps = 0.0; // raw MB per second of decompression
+    double ratio() const { return compressed_bytes ? double(raw_bytes) / compressed_bytes : 0.0; }
+};
+
+namespace detail {
+
+// zlib counts in 32-bit uInt, so feed very large buffers in slices
+constexpr size_t kZlibSlice = size_t(1) << 30;
+
+class GzipDeflater {
+public:
+    explicit GzipDeflater(int level) {
+        // windowBits 15 + 16 selects the gzip wrapper instead of raw zlib
+        if (deflateInit2(&zs_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("deflateInit2 failed");
+    }
+    ~GzipDeflater() { deflateEnd(&zs_); }
+    GzipDeflater(const GzipDeflater &) = delete;
+    GzipDeflater &operator=(const GzipDeflater &) = delete;
+
+    // This is to push `bytes` of input and hand every produced block to `sink`
+    template <typename Sink>
+    void feed(const void *data, size_t bytes, bool finish, Sink &&sink) {
+        const unsigned char *in = static_cast<const unsigned char *>(data);
+        unsigned char out[1 << 16];
+        do {
+            size_t slice = std::min(bytes, kZlibSlice);
+            zs_.next_in = const_cast<Bytef *>(in);
+            zs_.avail_in = uInt(slice);
+            in += slice;
+            bytes -= slice;
+            int flush = (finish && bytes == 0) ? Z_FINISH : Z_NO_FLUSH;
+            int rc;
+            do {
+                zs_.next_out = out;
+                zs_.avail_out = sizeof out;
+                rc = deflate(&zs_, flush);
+                if (rc == Z_STREAM_ERROR) throw std::runtime_error("deflate failed");
+                sink(out, sizeof out - zs_.avail_out);
+            } while (zs_.avail_out == 0);
+            if (flush == Z_FINISH && rc != Z_STREAM_END) throw std::runtime_error("deflate did not finish");
+        } while (bytes > 0);
+    }
+
+private:
+    z_stream zs_{};
+};
+
+} // namespace detail
+
+// This is to get the gzip size of a buffer without keeping the output
+inline size_t gzip_compressed_size(const void *data, size_t bytes, int level = kGzipDefaultLevel) {
+    size_t total = 0;
+    detail::GzipDeflater deflater(level);
+    deflater.feed(data, bytes, true, [&](const unsigned char *, size_t n) { total += n; });
+    return total;
+}
+
+// This is to gzip a buffer into memory
+inline std::vector<unsigned char> gzip_compress(const void *data, size_t bytes, int level = kGzipDefaultLevel) {
+    ScopedStage stage("compress", bytes / sizeof(float), bytes);
+    std::vector<unsigned char> out;
+    out.reserve(compressBound(uLong(std::min(bytes, detail::kZlibSlice))) + 32);
+    detail::GzipDeflater deflater(level);
+    deflater.feed(data, bytes, true, [&](const unsigned char *p, size_t n) { out.insert(out.end(), p, p + n); });
+    stage.set_bytes_out(out.size());
+    return out;
+}
+
+namespace detail {
+
+inline size_t gzip_inflate(const unsigned char *data, size_t bytes, void *out, size_t out_bytes) {
+    z_stream zs{};
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) throw std::runtime_error("inflateInit2 failed");
+    unsigned char *dst = static_cast<unsigned char *>(out);
+    // zlib rejects a null next_out even with no room, and an empty vector's data() may be null
+    unsigned char spare = 0;
+    size_t produced = 0;
+    int rc = Z_OK;
+    while (rc != Z_STREAM_END) {
+        size_t in_slice = std::min(bytes, detail::kZlibSlice);
+        size_t out_slice = std::min(out_bytes - produced, detail::kZlibSlice);
+        zs.next_in = const_cast<Bytef *>(data);
+        zs.avail_in = uInt(in_slice);
+        zs.next_out = out_slice ? dst + produced : &spare;
+        zs.avail_out = uInt(out_slice);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        size_t consumed = in_slice - zs.avail_in;
+        data += consumed;
+        bytes -= consumed;
+        produced += out_slice - zs.avail_out;
+        if (rc == Z_BUF_ERROR && (produced == out_bytes || bytes == 0)) break;
+        if (rc != Z_OK && rc != Z_STREAM_END) {
+            inflateEnd(&zs);
+            throw std::runtime_error("inflate failed");
+        }
+    }
+    inflateEnd(&zs);
+    if (rc != Z_STREAM_END) throw std::runtime_error("gzip stream truncated or larger than output buffer");
+    return produced;
+}
+
+} // namespace detail
+
+// This is to inflate a gzip stream into a buffer of known size; returns bytes written
+inline size_t gzip_decompress(const unsigned char *data, size_t bytes, void *out, size_t out_bytes) {
+    ScopedStage stage("decompress", out_bytes / sizeof(float), bytes, out_bytes);
+    return detail::gzip_inflate(data, bytes, out, out_bytes);
+}
+
+// This is to write a buffer as a real .gz file
+inline void write_gzip_file(const std::string &filename, const void *data, size_t bytes,
+                            int level = kGzipDefaultLevel) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) throw std::runtime_error("cannot open " + filename);
+    detail::GzipDeflater deflater(level);
+    deflater.feed(data, bytes, true, [&](const unsigned char *p, size_t n) {
+        file.write(reinterpret_cast<const char *>(p), std::streamsize(n));
+    });
+    if (!file) throw std::runtime_error("write failed: " + filename);
+}
+
+// This is to get the CRC-32 of a whole file, read in 1 MiB blocks so runs can be compared
+inline uint32_t file_crc32(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) throw std::runtime_error("cannot open " + filename);
+    std::vector<char> block(size_t(1) << 20);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    while (file.read(block.data(), std::streamsize(block.size())) || file.gcount() > 0)
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(block.data()), uInt(file.gcount()));
+    return uint32_t(crc);
+}
+
+// This is to time encode() (which returns the compressed size) and decode() of raw_bytes of input.
+// Every codec's measure_*() is this call; buffers are allocated before it so only the codec is timed.
+template <typename Encode, typename Decode>
+DeflateStats measure_codec(size_t raw_bytes, Encode &&encode, Decode &&decode) {
+    using Clock = std::chrono::steady_clock;
+    DeflateStats stats;
+    stats.raw_bytes = raw_bytes;
+    auto t0 = Clock::now();
+    stats.compressed_bytes = encode();
+    auto t1 = Clock::now();
+    decode();
+    auto t2 = Clock::now();
+    double mb = raw_bytes / 1e6;
+    stats.compress_mbps = mb / std::chrono::duration<double>(t1 - t0).count();
+    stats.decompress_mbps = mb / std::chrono::duration<double>(t2 - t1).count();
+    return stats;
+}
+
+// This is to measure ratio and compress/decompress speed of a buffer in memory
+inline DeflateStats measure_gzip(const void *data, size_t bytes, int level = kGzipDefaultLevel) {
+    std::vector<unsigned char> packed, restored(bytes);
+    return measure_codec(bytes, [&] { return (packed = gzip_compress(data, bytes, level)).size(); },
+                         [&] { gzip_decompress(packed.data(), packed.size(), restored.data(), bytes); });
+}
+
+template <typename T>
+DeflateStats measure_gzip(const std::vector<T> &data, int level = kGzipDefaultLevel) {
+    return measure_gzip(data.data(), data.size() * sizeof(T), level);
+}
+
+// This is to measure shuffle + gzip; the speeds include the filter and its inverse
+inline DeflateStats measure_gzip(const float *data, size_t n, Shuffle mode, int level = kGzipDefaultLevel) {
+    const size_t bytes = n * sizeof(float);
+    std::vector<unsigned char> shuffled(bytes), restored(bytes), packed;
+    return measure_codec(
+        bytes,
+        [&] {
+            shuffle4(mode, data, shuffled.data(), n);
+            return (packed = gzip_compress(shuffled.data(), bytes, level)).size();
+        },
+        [&] {
+            gzip_decompress(packed.data(), packed.size(), shuffled.data(), bytes);
+            unshuffle4(mode, shuffled.data(), restored.data(), n);
+        });
+}
+
+inline DeflateStats measure_gzip(const std::vector<float> &data, Shuffle mode, int level = kGzipDefaultLevel) {
+    return measure_gzip(data.data(), data.size(), mode, level);
+}
+
+} // namespace lossy
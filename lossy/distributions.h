@@ -0,0 +1,133 @@
+#pragma once
+
+// Distribution policies for the experiments.
+//
+// Each policy names a distribution and fills an array of a value type from
+// the counter-based generators of random.h, so an experiment is written once
+// as a template and instantiated per distribution instead of being copied per
+// folder. generate() gives the same data for a seed with or without a pool,
+// and BlockGenerator gives the same data again one block at a time.
+
+#include <string>
+#include <vector>
+
+#include "profile.h"
+#include "random.h"
+
+namespace lossy {
+
+// fill(seed, out, n[, pool]) writes n values; with a ThreadPool the chunks run in parallel.
+// fill_at(seed, first, out, n, state) writes values [first, first + n) of the same output, given
+// the State left by the previous range (first a multiple of kRandomChunk).
+struct Uniform {
+    static constexpr const char *name = "uniform";
+    struct State {};
+    template <typename T, typename... Pool>
+    static void fill(uint64_t seed, T *out, size_t n, Pool &...pool) { fill_uniform(seed, out, n, pool...); }
+    template <typename T>
+    static void fill_at(uint64_t seed, uint64_t first, T *out, size_t n, State &) { fill_uniform_at(seed, first, out, n); }
+};
+
+struct Gaussian {
+    static constexpr const char *name = "gaussian";
+    struct State {};
+    template <typename T, typename... Pool>
+    static void fill(uint64_t seed, T *out, size_t n, Pool &...pool) { fill_normal(seed, out, n, pool...); }
+    template <typename T>
+    static void fill_at(uint64_t seed, uint64_t first, T *out, size_t n, State &) { fill_normal_at(seed, first, out, n); }
+};
+
+struct Exponential {
+    static constexpr const char *name = "exponential";
+    struct State {};
+    template <typename T, typename... Pool>
+    static void fill(uint64_t seed, T *out, size_t n, Pool &...pool) { fill_exponential(seed, out, n, pool...); }
+    template <typename T>
+    static void fill_at(uint64_t seed, uint64_t first, T *out, size_t n, State &) {
+        fill_exponential_at(seed, first, out, n);
+    }
+};
+
+// Slowly varying monitoring-style series: a random walk around 20 with small normal steps.
+// Not one of the per-folder distributions; it is what the Gorilla codec is aimed at.
+struct Timeseries {
+    static constexpr const char *name = "timeseries";
+    // The walk carries its level from one range to the next
+    struct State {
+        double level = 20.0;
+    };
+    template <typename T, typename... Pool>
+    static void fill(uint64_t seed, T *out, size_t n, Pool &...pool) {
+        fill_normal(seed, out, n, pool...);
+        // The running sum is serial, so the result is still the same for any pool
+        State state;
+        walk(out, n, state);
+    }
+    template <typename T>
+    static void fill_at(uint64_t seed, uint64_t first, T *out, size_t n, State &state) {
+        fill_normal_at(seed, first, out, n);
+        walk(out, n, state);
+    }
+
+private:
+    template <typename T>
+    static void walk(T *out, size_t n, State &state) {
+        for (size_t i = 0; i < n; i++) {
+            state.level += 0.01 * double(out[i]);
+            out[i] = T(state.level);
+        }
+    }
+};
+
+// This is to draw n values of type T from Dist
+template <typename T, typename Dist>
+std::vector<T> generate(size_t n, uint64_t seed = kDefaultSeed) {
+    ScopedStage stage("generate", n, 0, n * sizeof(T));
+    std::vector<T> data(n);
+    Dist::fill(seed, data.data(), n);
+    return data;
+}
+
+// This is the same on the pool; gives bit-identical data for any thread count
+template <typename T, typename Dist>
+std::vector<T> generate(size_t n, uint64_t seed, ThreadPool &pool) {
+    ScopedStage stage("generate", n, 0, n * sizeof(T));
+    std::vector<T> data(n);
+    Dist::fill(seed, data.data(), n, pool);
+    return data;
+}
+
+// Draws the values of generate<T, Dist>(n, seed) in consecutive blocks, holding none of them.
+// Every block but the last must be a multiple of kRandomChunk long.
+template <typename T, typename Dist>
+class BlockGenerator {
+public:
+    explicit BlockGenerator(uint64_t seed = kDefaultSeed) : seed_(seed) {}
+
+    // This is to write the next n values
+    void next(T *out, size_t n) {
+        ScopedStage stage("generate", n, 0, n * sizeof(T));
+        Dist::fill_at(seed_, position_, out, n, state_);
+        position_ += n;
+    }
+
+    uint64_t position() const { return position_; }
+
+private:
+    uint64_t seed_;
+    uint64_t position_ = 0;
+    typename Dist::State state_{};
+};
+
+// This is to call fn(Dist{}) for the policy called `name`; returns false for unknown names
+template <typename Fn>
+bool with_distribution(const std::string &name, Fn &&fn) {
+    if (name == Uniform::name) fn(Uniform{});
+    else if (name == Gaussian::name) fn(Gaussian{});
+    else if (name == Exponential::name) fn(Exponential{});
+    else if (name == Timeseries::name) fn(Timeseries{});
+    else return false;
+    return true;
+}
+
+} // namespace lossy
@@ -0,0 +1,245 @@
+#pragma once
+
+// Single-pass rate-distortion evaluation of many truncation levels.
+//
+// LevelEvaluator takes the original data once, in any number of add()
+// calls, and for every requested bits_to_zero level returns the error
+// metrics of the truncated (or rounded) data and its compressed size under
+// each size sink, without ever holding a truncated copy of the dataset.
+// The data is cut into cache-sized blocks; each block is truncated into a
+// per-level scratch buffer, folded into that level's metrics and fed to the
+// level's streaming compressors, so the original is read from memory once
+// and the whole curve costs about one pass plus the compressors' own work.
+// Memory is a few blocks and one zlib stream per (level, sink).
+//
+// The metrics are bit-identical to compute_metrics() on a truncated copy
+// (blocks line up with its fixed parts). SizeSink::Gzip is exactly the
+// gzip_compressed_size() of the whole truncated array; the shuffled sinks
+// shuffle each block on its own, like container chunks of block_elements,
+// and come out a little larger than a whole-array shuffle. BitPack is the
+// exact pack_floats() size. SizeSink::Entropy needs no compressor at all:
+// it is the order-0 entropy of the four byte planes (what an ideal byte
+// entropy coder after a byte shuffle would need), so a curve of entropy
+// estimates really costs one pass. With a ThreadPool the levels of each
+// block run in parallel; the results do not depend on it.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitpack.h"
+#include "deflate.h"
+#include "metrics.h"
+#include "profile.h"
+#include "rounding.h"
+#include "shuffle.h"
+#include "thread_pool.h"
+
+namespace lossy {
+
+// How the compressed size of a level is measured
+enum class SizeSink { Raw, Gzip, ShuffleGzip, BitShuffleGzip, BitPack, Entropy };
+
+inline const char *size_sink_name(SizeSink sink) {
+    switch (sink) {
+    case SizeSink::Gzip: return "gzip";
+    case SizeSink::ShuffleGzip: return "shuffle-gzip";
+    case SizeSink::BitShuffleGzip: return "bitshuffle-gzip";
+    case SizeSink::BitPack: return "bitpack";
+    case SizeSink::Entropy: return "entropy";
+    default: return "raw";
+    }
+}
+
+inline SizeSink parse_size_sink(const std::string &name) {
+    for (SizeSink sink : {SizeSink::Raw, SizeSink::Gzip, SizeSink::ShuffleGzip, SizeSink::BitShuffleGzip,
+                          SizeSink::BitPack, SizeSink::Entropy})
+        if (name == size_sink_name(sink)) return sink;
+    throw std::runtime_error("unknown size sink: " + name);
+}
+
+struct EvaluatorOptions {
+    std::vector<int> levels;                 // bits_to_zero values, 0..23
+    std::vector<SizeSink> sinks{SizeSink::Gzip};
+    size_t block_elements = size_t(1) << 15; // a multiple of 4096 that divides kMetricsPart
+    Rounding rounding = Rounding::Truncate;
+    uint64_t seed = kDefaultSeed;            // stochastic rounding; each block uses its first element as stream
+    int gzip_level = kGzipDefaultLevel;
+};
+
+struct LevelEvaluation {
+    int bits_to_zero = 0;
+    ErrorMetrics metrics;
+    std::vector<size_t> compressed_bytes;    // one per EvaluatorOptions::sinks
+};
+
+class LevelEvaluator {
+public:
+    explicit LevelEvaluator(const EvaluatorOptions &opt, ThreadPool *pool = nullptr) : opt_(opt), pool_(pool) {
+        if (opt_.block_elements == 0 || opt_.block_elements % 4096 != 0 || kMetricsPart % opt_.block_elements != 0)
+            throw std::runtime_error("block_elements must be a multiple of 4096 dividing kMetricsPart");
+        for (int bits : opt_.levels) {
+            if (bits < 0 || bits > 23) throw std::runtime_error("bits_to_zero out of range");
+            auto level = std::make_unique<Level>();
+            level->bits = bits;
+            level->scratch.resize(opt_.block_elements);
+            for (SizeSink sink : opt_.sinks) {
+                bool deflated = sink == SizeSink::Gzip || sink == SizeSink::ShuffleGzip || sink == SizeSink::BitShuffleGzip;
+                level->deflaters.push_back(deflated ? std::make_unique<detail::GzipDeflater>(opt_.gzip_level) : nullptr);
+                if (sink == SizeSink::ShuffleGzip || sink == SizeSink::BitShuffleGzip)
+                    level->shuffled.resize(opt_.block_elements * sizeof(float));
+            }
+            level->bytes.assign(opt_.sinks.size(), 0);
+            levels_.push_back(std::move(level));
+        }
+        pending_.reserve(opt_.block_elements);
+    }
+
+    // This is to feed the next n values of the original
+    void add(const float *data, size_t n) {
+        if (finished_) throw std::runtime_error("add after finish");
+        ScopedStage stage("evaluate", n, n * sizeof(float));
+        // Whole blocks are evaluated in place; only a partial block is buffered
+        while (n > 0) {
+            if (pending_.empty() && n >= opt_.block_elements) {
+                process(data, opt_.block_elements);
+                data += opt_.block_elements;
+                n -= opt_.block_elements;
+                continue;
+            }
+            size_t take = std::min(n, opt_.block_elements - pending_.size());
+            pending_.insert(pending_.end(), data, data + take);
+            data += take;
+            n -= take;
+            if (pending_.size() == opt_.block_elements) {
+                process(pending_.data(), pending_.size());
+                pending_.clear();
+            }
+        }
+    }
+
+    // This is to evaluate the buffered tail and close the compressed streams
+    std::vector<LevelEvaluation> finish() {
+        if (!finished_) {
+            if (!pending_.empty()) process(pending_.data(), pending_.size());
+            pending_.clear();
+            for_each_level([&](Level &level) {
+                level.total.merge(level.part);
+                for (size_t s = 0; s < opt_.sinks.size(); s++) {
+                    if (level.deflaters[s]) {
+                        level.deflaters[s]->feed(nullptr, 0, true,
+                                                 [&](const unsigned char *, size_t len) { level.bytes[s] += len; });
+                        level.deflaters[s].reset();
+                    } else if (opt_.sinks[s] == SizeSink::BitPack) {
+                        level.bytes[s] = packed_float_bytes(count_, level.bits);
+                    } else if (opt_.sinks[s] == SizeSink::Entropy) {
+                        level.bytes[s] = entropy_bytes(level.planes);
+                    } else {
+                        level.bytes[s] = count_ * sizeof(float);
+                    }
+                }
+            });
+            finished_ = true;
+        }
+        std::vector<LevelEvaluation> out;
+        for (const std::unique_ptr<Level> &level : levels_)
+            out.push_back({level->bits, level->total.result(), level->bytes});
+        return out;
+    }
+
+    size_t count() const { return count_ + pending_.size(); }
+
+private:
+    struct Level {
+        int bits = 0;
+        MetricsAccumulator total, part;
+        std::vector<std::unique_ptr<detail::GzipDeflater>> deflaters; // null for sinks without a stream
+        std::vector<size_t> bytes;
+        std::vector<float> scratch;
+        std::vector<unsigned char> shuffled;
+        uint64_t planes[4][256] = {}; // byte histograms of the four byte planes
+    };
+
+    // This is to turn byte-plane histograms into the order-0 entropy coded size
+    static size_t entropy_bytes(const uint64_t (&planes)[4][256]) {
+        double bits = 0;
+        for (const uint64_t(&counts)[256] : planes) {
+            uint64_t total = 0;
+            for (uint64_t c : counts) total += c;
+            for (uint64_t c : counts)
+                if (c) bits -= double(c) * std::log2(double(c) / double(total));
+        }
+        return size_t(std::ceil(bits / 8));
+    }
+
+    template <typename Fn>
+    void for_each_level(Fn &&fn) {
+        if (pool_ && pool_->size() > 1 && levels_.size() > 1) {
+            parallel_for(*pool_, levels_.size(), [&](size_t i) { fn(*levels_[i]); });
+        } else {
+            for (std::unique_ptr<Level> &level : levels_) fn(*level);
+        }
+    }
+
+    void process(const float *block, size_t len) {
+        const uint64_t first = count_;
+        const bool part_done = (first + len) % kMetricsPart == 0;
+        for_each_level([&](Level &level) {
+            round_lsb(block, level.scratch.data(), len, level.bits, opt_.rounding, opt_.seed, first);
+            level.part.add(block, level.scratch.data(), len);
+            // Parts are merged in index order, as compute_metrics() does
+            if (part_done) {
+                level.total.merge(level.part);
+                level.part = MetricsAccumulator();
+            }
+            bool histogrammed = false;
+            for (size_t s = 0; s < opt_.sinks.size(); s++) {
+                if (opt_.sinks[s] == SizeSink::Entropy && !histogrammed) {
+                    histogrammed = true;
+                    for (size_t i = 0; i < len; i++) {
+                        uint32_t w = float_bits(level.scratch[i]);
+                        level.planes[0][w & 0xFF]++;
+                        level.planes[1][w >> 8 & 0xFF]++;
+                        level.planes[2][w >> 16 & 0xFF]++;
+                        level.planes[3][w >> 24]++;
+                    }
+                }
+                if (!level.deflaters[s]) continue;
+                const void *bytes = level.scratch.data();
+                if (opt_.sinks[s] != SizeSink::Gzip) {
+                    shuffle4(opt_.sinks[s] == SizeSink::ShuffleGzip ? Shuffle::Byte : Shuffle::Bit,
+                             level.scratch.data(), level.shuffled.data(), len);
+                    bytes = level.shuffled.data();
+                }
+                level.deflaters[s]->feed(bytes, len * sizeof(float), false,
+                                         [&](const unsigned char *, size_t n) { level.bytes[s] += n; });
+            }
+        });
+        count_ += len;
+    }
+
+    EvaluatorOptions opt_;
+    ThreadPool *pool_;
+    std::vector<std::unique_ptr<Level>> levels_;
+    std::vector<float> pending_;
+    uint64_t count_ = 0;
+    bool finished_ = false;
+};
+
+// This is to evaluate every level of opt on an array held in memory
+inline std::vector<LevelEvaluation> evaluate_levels(const float *data, size_t n, const EvaluatorOptions &opt,
+                                                    ThreadPool *pool = nullptr) {
+    LevelEvaluator evaluator(opt, pool);
+    evaluator.add(data, n);
+    return evaluator.finish();
+}
+
+inline std::vector<LevelEvaluation> evaluate_levels(const std::vector<float> &data, const EvaluatorOptions &opt,
+                                                    ThreadPool *pool = nullptr) {
+    return evaluate_levels(data.data(), data.size(), opt, pool);
+}
+
+} // namespace lossy
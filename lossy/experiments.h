@@ -0,0 +1,211 @@
+#pragma once
+
+// The per-distribution experiments, written once as templates.
+//
+// run_gzip_experiment<T, Dist, Bits...>() is the former og-vs-com_gzip.cpp:
+// LSB zeroing at each compile-time level, on-disk sizes, in-memory gzip
+// (with and without shuffle), the Gorilla XOR codec, dense bit-packing of
+// the kept bits (bitpack.h, also written to disk), the sign/exponent/mantissa
+// split with rANS (split.h), the byte-shuffled array through every
+// lossless backend of this build (compressor.h) and MSE.
+// run_half_experiment<Dist>() is the former 32-16bit_MSE.cpp: float32 ->
+// binary16 storage and its error, then the same for the other minifloat
+// formats (minifloat.h) with their clipping counts. Both write their .bin
+// files into `dir`.
+// driver.cpp instantiates them for every distribution policy.
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "bitpack.h"
+#include "compressor.h"
+#include "deflate.h"
+#include "distributions.h"
+#include "gorilla.h"
+#include "metrics.h"
+#include "minifloat.h"
+#include "profile.h"
+#include "split.h"
+#include "truncate.h"
+
+namespace lossy {
+
+// This is to write a vector as raw binary into dir/filename; returns the path
+template <typename T>
+std::string write_binary(const std::string &dir, const std::string &filename, const std::vector<T> &data) {
+    ScopedStage stage("write", data.size(), data.size() * sizeof(T), data.size() * sizeof(T));
+    std::string path = dir.empty() ? filename : dir + "/" + filename;
+    std::ofstream file(path, std::ios::binary);
+    if (!file) throw std::runtime_error("cannot open " + path);
+    file.write(reinterpret_cast<const char *>(data.data()), std::streamsize(data.size() * sizeof(T)));
+    if (!file) throw std::runtime_error("write failed: " + path);
+    return path;
+}
+
+// This is to get the MSE between two arrays (fused SIMD pass for float)
+template <typename T>
+double mean_squared_error(const std::vector<T> &original, const std::vector<T> &compressed) {
+    if constexpr (std::is_same_v<T, float>) {
+        return compute_metrics(original, compressed).mse;
+    } else {
+        detail::CompensatedSum sum;
+        for (size_t i = 0; i < original.size(); i++) {
+            double diff = double(original[i]) - double(compressed[i]);
+            sum.add(diff * diff);
+        }
+        return original.empty() ? 0.0 : sum.value() / original.size();
+    }
+}
+
+template <typename T, typename Dist, int... Bits>
+void run_gzip_experiment(const std::string &dir, size_t n = 1000000) {
+    static_assert(sizeof...(Bits) > 0, "need at least one bits_to_zero level");
+    constexpr int levels[] = {Bits...};
+    constexpr size_t count = sizeof...(Bits);
+    if (!dir.empty()) std::filesystem::create_directories(dir);
+
+    std::vector<T> original = generate<T, Dist>(n);
+    std::vector<std::vector<T>> compressed(count, std::vector<T>(n));
+    size_t k = 0;
+    ((truncate<Bits>(original.data(), compressed[k++].data(), n)), ...);
+
+    double mse[count];
+    for (size_t i = 0; i < count; i++) mse[i] = mean_squared_error(original, compressed[i]);
+
+    auto mb = [](double bytes) { return bytes / (1024.0 * 1024); };
+    std::string original_path = write_binary(dir, "original.bin", original);
+    std::cout << "Original File Size: " << mb(std::filesystem::file_size(original_path)) << " MB\n";
+    for (size_t i = 0; i < count; i++) {
+        std::string path = write_binary(dir, "compressed_" + std::to_string(levels[i]) + ".bin", compressed[i]);
+        std::cout << "Compressed " << levels[i] << " Bits File Size: " << mb(std::filesystem::file_size(path)) << " MB\n";
+    }
+
+    DeflateStats original_gz = measure_gzip(original);
+    std::vector<DeflateStats> gz;
+    for (const std::vector<T> &c : compressed) gz.push_back(measure_gzip(c));
+
+    std::cout << "\nAfter gzip compression:\n";
+    std::cout << "Original Compressed: " << mb(original_gz.compressed_bytes) << " MB\n";
+    for (size_t i = 0; i < count; i++)
+        std::cout << "Compressed " << levels[i] << " Bits + (gzip): " << mb(gz[i].compressed_bytes) << " MB\n";
+
+    std::cout << "\ngzip speed (compress / decompress):\n";
+    std::cout << "Original: " << original_gz.compress_mbps << " / " << original_gz.decompress_mbps << " MB/s\n";
+    for (size_t i = 0; i < count; i++)
+        std::cout << "Compressed " << levels[i] << " Bits: " << gz[i].compress_mbps << " / " << gz[i].decompress_mbps
+                  << " MB/s\n";
+
+    // The shuffle filters work on 4-byte elements
+    if constexpr (std::is_same_v<T, float>) {
+        auto shuffle_row = [&](const std::string &label, const std::vector<float> &data) {
+            std::cout << label << ":";
+            for (Shuffle mode : {Shuffle::None, Shuffle::Byte, Shuffle::Bit}) {
+                DeflateStats stats = measure_gzip(data, mode);
+                std::cout << "  " << shuffle_name(mode) << " " << mb(stats.compressed_bytes) << " MB (ratio "
+                          << stats.ratio() << ", " << stats.compress_mbps << " / " << stats.decompress_mbps << " MB/s)";
+            }
+            std::cout << "\n";
+        };
+        std::cout << "\nShuffle + gzip (size, ratio, compress / decompress speed):\n";
+        shuffle_row("Original", original);
+        for (size_t i = 0; i < count; i++)
+            shuffle_row("Compressed " + std::to_string(levels[i]) + " Bits", compressed[i]);
+
+        auto gorilla_row = [&](const std::string &label, const std::vector<float> &data) {
+            DeflateStats stats = measure_gorilla(data);
+            std::cout << label << ": " << mb(stats.compressed_bytes) << " MB (ratio " << stats.ratio() << ", "
+                      << stats.compress_mbps << " / " << stats.decompress_mbps << " MB/s)\n";
+        };
+        std::cout << "\nGorilla XOR (size, ratio, compress / decompress speed):\n";
+        gorilla_row("Original", original);
+        for (size_t i = 0; i < count; i++) gorilla_row("Compressed " + std::to_string(levels[i]) + " Bits", compressed[i]);
+
+        // Only sign, exponent and kept mantissa bits reach the file, so the size is exact
+        std::cout << "\nBit-packed (file size, ratio, pack / unpack speed):\n";
+        for (size_t i = 0; i < count; i++) {
+            std::vector<unsigned char> packed = pack_floats(compressed[i].data(), n, levels[i]);
+            std::string path = write_binary(dir, "packed_" + std::to_string(levels[i]) + ".bin", packed);
+            DeflateStats stats = measure_bitpack(compressed[i], levels[i]);
+            std::cout << "Compressed " << levels[i] << " Bits: " << mb(std::filesystem::file_size(path)) << " MB (ratio "
+                      << stats.ratio() << ", " << stats.compress_mbps << " / " << stats.decompress_mbps << " MB/s)\n";
+        }
+
+        std::cout << "\nSign/exponent/mantissa split + rANS (size, ratio, compress / decompress speed):\n";
+        for (size_t i = 0; i < count; i++) {
+            DeflateStats stats = measure_split(compressed[i], levels[i]);
+            std::cout << "Compressed " << levels[i] << " Bits: " << mb(stats.compressed_bytes) << " MB (ratio "
+                      << stats.ratio() << ", " << stats.compress_mbps << " / " << stats.decompress_mbps << " MB/s)\n";
+        }
+
+        // Only gzip is always built; the other backends appear when compiled in (compressor.h)
+        std::cout << "\nShuffle + lossless backends at their default levels (ratio, compress / decompress speed):\n";
+        for (const std::string &backend : compressor_backends()) {
+            std::unique_ptr<Compressor> codec = make_compressor(backend);
+            std::cout << codec->name() << ":";
+            for (size_t i = 0; i < count; i++) {
+                DeflateStats stats = measure_compressor(*codec, compressed[i], Shuffle::Byte);
+                std::cout << "  " << levels[i] << " bits " << stats.ratio() << " (" << stats.compress_mbps << " / "
+                          << stats.decompress_mbps << " MB/s)";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    std::cout << "\nMean Squared Error (MSE):\n";
+    for (size_t i = 0; i < count; i++) std::cout << "MSE (" << levels[i] << "-bit zeroing): " << mse[i] << "\n";
+}
+
+template <typename Dist>
+void run_half_experiment(const std::string &dir, size_t n = 1000000) {
+    if (!dir.empty()) std::filesystem::create_directories(dir);
+    std::vector<float> data = generate<float, Dist>(n);
+    write_binary(dir, "full_precision.bin", data);
+
+    std::vector<uint16_t> half(n);
+    ToHalf::encode(data.data(), half.data(), n);
+    write_binary(dir, "compressed_half_precision.bin", half);
+
+    std::vector<float> reconstructed(n);
+    ToHalf::decode(half.data(), reconstructed.data(), n);
+    ErrorMetrics metrics = compute_metrics(data, reconstructed);
+
+    std::cout << "Original Size: " << n * sizeof(float) / 1024.0 << " KB\n";
+    std::cout << "Compressed Size: " << n * sizeof(uint16_t) / 1024.0 << " KB\n";
+    std::cout << "Storage Savings: " << 100.0 * (1 - double(n * sizeof(uint16_t)) / (n * sizeof(float))) << "%\n";
+    std::cout << "Mean Squared Error: " << metrics.mse << "\n";
+    std::cout << "Mean Absolute Error: " << metrics.mae << "\n";
+    std::cout << "Maximum Absolute Error: " << metrics.max_abs_error << "\n";
+    std::cout << "PSNR: " << metrics.psnr << " dB\n";
+
+    std::cout << "\nMinifloat formats (bits, MSE, max error, PSNR, overflowed, flushed to zero):\n";
+    auto report = [&](const std::string &label, auto format, int bias) {
+        using F = decltype(format);
+        std::vector<typename F::Storage> codes(n);
+        float_to_minifloat<F>(data.data(), codes.data(), n, bias);
+        minifloat_to_float<F>(codes.data(), reconstructed.data(), n, bias);
+        ErrorMetrics m = compute_metrics(data, reconstructed, minifloat_max<F>(bias));
+        std::cout << label << ": " << F::bits << " bits, MSE " << m.mse << ", max " << m.max_abs_error << ", PSNR "
+                  << m.psnr << " dB, " << m.overflowed << " overflowed, " << m.underflowed << " flushed\n";
+    };
+    report("float16", Binary16{}, Binary16::default_bias);
+    report("bfloat16", BFloat16{}, BFloat16::default_bias);
+    report("e8m15", E8M15{}, E8M15::default_bias);
+    report("e5m2", E5M2{}, E5M2::default_bias);
+    report("e4m3", E4M3{}, E4M3::default_bias);
+    // A bias fitted to the data moves the e4m3 range onto it
+    float peak = 0;
+    for (float x : data)
+        if (std::isfinite(x)) peak = std::max(peak, std::fabs(x));
+    int bias = choose_bias<E4M3>(peak);
+    report("e4m3 (bias " + std::to_string(bias) + ")", E4M3{}, bias);
+}
+
+} // namespace lossy
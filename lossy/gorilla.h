@@ -0,0 +1,105 @@
+#pragma once
+
+// Gorilla-style XOR codec for time-ordered float32 streams.
+//
+// Each value is XORed with the previous one (Pelkonen et al., "Gorilla",
+// VLDB 2015). Neighbours in a slowly varying series share sign, exponent and
+// leading mantissa bits, so the XOR is mostly zero at the top; LSB zeroing
+// makes it zero at the bottom as well. Codes, LSB-first (bitstream.h):
+//
+//   0                                  same value as before
+//   1 0 <meaningful bits>              XOR fits the previous window
+//   1 1 <lead:5> <len-1:5> <bits>      new window: leading zeros, length
+//
+// The first value is stored as 32 raw bits. The payload has no header: the
+// element count comes from the container chunk (or the caller).
+
+#include <stdexcept>
+#include <vector>
+
+#include "bitstream.h"
+#include "common.h"
+#include "deflate.h"
+
+namespace lossy {
+
+// This is the worst-case encoded size of n values, plus the writer's slack
+inline size_t gorilla_bound(size_t n) { return (n * 44 + 7) / 8 + 8; }
+
+// This is to encode n floats into out (gorilla_bound(n) bytes); returns the payload size
+inline size_t gorilla_encode(const float *data, size_t n, unsigned char *out) {
+    BitWriter writer(out);
+    if (n > 0) {
+        uint32_t prev = float_bits(data[0]);
+        writer.put(prev, 32);
+        // No XOR fits the initial window (33 leading zeros), so the first non-zero one opens a window
+        int lead = 33, trail = 0, len = 0;
+        for (size_t i = 1; i < n; i++) {
+            uint32_t cur = float_bits(data[i]);
+            uint32_t x = cur ^ prev;
+            prev = cur;
+            if (x == 0) {
+                writer.put(0, 1);
+                continue;
+            }
+            int lz = __builtin_clz(x), tz = __builtin_ctz(x);
+            if (lz >= lead && tz >= trail) {
+                writer.put(0x1 | uint64_t(x >> trail) << 2, 2 + len);
+            } else {
+                lead = lz;
+                trail = tz;
+                len = 32 - lz - tz;
+                writer.put(0x3 | uint64_t(lz) << 2 | uint64_t(len - 1) << 7 | uint64_t(x >> trail) << 12, 12 + len);
+            }
+        }
+    }
+    return writer.finish();
+}
+
+inline std::vector<unsigned char> gorilla_encode(const float *data, size_t n) {
+    std::vector<unsigned char> out(gorilla_bound(n));
+    out.resize(gorilla_encode(data, n, out.data()));
+    return out;
+}
+
+// This is to decode n floats from a payload; throws if the payload is too short or malformed
+inline void gorilla_decode(const unsigned char *payload, size_t bytes, float *out, size_t n) {
+    if (n == 0) return;
+    BitReader reader(payload, bytes);
+    uint32_t prev = uint32_t(reader.get(32));
+    out[0] = bits_float(prev);
+    int trail = 0, len = 0;
+    uint64_t window = 0; // mask of the meaningful bits
+    for (size_t i = 1; i < n; i++) {
+        // One load serves the whole code: control bits, header and payload are <= 44 bits
+        uint64_t w = reader.peek();
+        if (!(w & 1)) {
+            reader.skip(1);
+        } else if (!(w & 2)) {
+            prev ^= uint32_t(((w >> 2) & window) << trail);
+            reader.skip(2 + len);
+        } else {
+            len = (int(w >> 7) & 31) + 1;
+            trail = 32 - (int(w >> 2) & 31) - len;
+            // lead + len > 32 never comes out of the encoder, and would shift by a negative count
+            if (trail < 0) throw std::runtime_error("bad gorilla payload");
+            window = BitReader::low_bits(len);
+            prev ^= uint32_t(((w >> 12) & window) << trail);
+            reader.skip(12 + len);
+        }
+        out[i] = bits_float(prev);
+    }
+    if (reader.overrun()) throw std::runtime_error("gorilla payload truncated");
+}
+
+// This is to measure the Gorilla size and encode/decode speed of a buffer
+inline DeflateStats measure_gorilla(const float *data, size_t n) {
+    std::vector<unsigned char> packed;
+    std::vector<float> restored(n);
+    return measure_codec(n * sizeof(float), [&] { return (packed = gorilla_encode(data, n)).size(); },
+                         [&] { gorilla_decode(packed.data(), packed.size(), restored.data(), n); });
+}
+
+inline DeflateStats measure_gorilla(const std::vector<float> &data) { return measure_gorilla(data.data(), data.size()); }
+
+} // namespace lossy
@@ -0,0 +1,233 @@
+#pragma once
+
+// Batch float32 <-> IEEE 754 binary16 conversion.
+//
+// float_to_half() rounds to nearest, ties to even, produces half subnormals,
+// saturates to +-Inf on overflow and keeps NaN as a quiet NaN with its sign
+// and top payload bits. half_to_float() is exact for every half value
+// (signalling NaNs are returned quiet).
+// AVX-512F or F16C (vcvtps2ph / vcvtph2ps) is used when the CPU has it; the
+// fallback is a branch-free base/shift table path with identical results.
+
+#include <array>
+
+#include "common.h"
+#include "profile.h"
+
+namespace lossy {
+
+// Storage format of a float array on disk; the minifloats after Float16 are in minifloat.h
+enum class Precision : uint8_t { Float32 = 0, Float16 = 1, BFloat16 = 2, E4M3 = 3, E5M2 = 4, E8M15 = 5 };
+
+namespace detail {
+
+// Lookup tables for the portable path.
+//
+// float -> half is indexed by the top 9 bits (sign + exponent) of the float.
+// With the implicit bit made explicit, m = 1.mantissa as a 24-bit integer,
+// the unrounded result is base + (m >> shift) and the bits shifted out decide
+// the rounding. base already contains sign and (exponent - 1) so the implicit
+// bit lands in the exponent field; a round-up that overflows the mantissa
+// carries into the exponent and, at the top, into Inf, as IEEE requires.
+//
+// half -> float uses the mantissa/offset/exponent tables of J. van der Zijp,
+// "Fast Half Float Conversions" (2008).
+struct HalfTables {
+    std::array<uint16_t, 512> base{};
+    std::array<uint8_t, 512> shift{};
+    std::array<uint32_t, 2048> mantissa{};
+    std::array<uint32_t, 64> exponent{};
+    std::array<uint16_t, 64> offset{};
+
+    constexpr HalfTables() {
+        for (int i = 0; i < 256; i++) {
+            int e = i - 127;
+            uint16_t b = 0;
+            uint8_t s = 31; // shifts everything out and never rounds up
+            if (e >= -25 && e < -14) {        // half subnormal (or rounds to it)
+                s = uint8_t(-e - 1);
+            } else if (e >= -14 && e <= 15) { // half normal
+                b = uint16_t((e + 14) << 10);
+                s = 13;
+            } else if (e > 15) {              // overflow, Inf and NaN
+                b = 0x7C00;
+            }
+            base[i] = b;
+            base[i | 0x100] = uint16_t(b | 0x8000);
+            shift[i] = shift[i | 0x100] = s;
+        }
+
+        for (uint32_t i = 1; i < 1024; i++) {
+            uint32_t m = i << 13, e = 0;
+            while (!(m & 0x00800000u)) {
+                e -= 0x00800000u;
+                m <<= 1;
+            }
+            mantissa[i] = (m & ~0x00800000u) | (e + 0x38800000u);
+        }
+        for (uint32_t i = 1024; i < 2048; i++) mantissa[i] = 0x38000000u + ((i - 1024) << 13);
+
+        for (uint32_t i = 1; i < 31; i++) exponent[i] = i << 23;
+        exponent[31] = 0x47800000u;
+        exponent[32] = 0x80000000u;
+        for (uint32_t i = 33; i < 63; i++) exponent[i] = 0x80000000u + ((i - 32) << 23);
+        exponent[63] = 0xC7800000u;
+
+        for (int i = 0; i < 64; i++) offset[i] = (i == 0 || i == 32) ? 0 : 1024;
+    }
+};
+
+inline constexpr HalfTables kHalfTables{};
+
+inline uint16_t float_to_half_table(float value) {
+    const HalfTables &t = kHalfTables;
+    uint32_t f = float_bits(value);
+    uint32_t idx = f >> 23;
+    uint32_t m = (f & 0x007FFFFFu) | 0x00800000u;
+    uint32_t s = t.shift[idx];
+    uint32_t k = m >> s;
+    uint32_t rem = m & ((1u << s) - 1u);
+    uint32_t halfway = 1u << (s - 1u);
+    uint32_t round_up = (rem > halfway) | ((rem == halfway) & k & 1u);
+    uint32_t h = t.base[idx] + k + round_up;
+    // NaN: the Inf pattern from the table plus the quiet bit and top payload
+    uint32_t is_nan = (f & 0x7FFFFFFFu) > 0x7F800000u;
+    h |= is_nan * (0x0200u | ((f >> 13) & 0x03FFu));
+    return uint16_t(h);
+}
+
+inline float half_to_float_table(uint16_t h) {
+    const HalfTables &t = kHalfTables;
+    uint32_t e = h >> 10;
+    uint32_t f = t.mantissa[t.offset[e] + (h & 0x03FFu)] + t.exponent[e];
+    // Signalling NaNs come back quiet, as vcvtph2ps does
+    uint32_t is_nan = (h & 0x7FFFu) > 0x7C00u;
+    return bits_float(f | (is_nan << 22));
+}
+
+inline void float_to_half_scalar(const float *in, uint16_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = float_to_half_table(in[i]);
+}
+
+inline void half_to_float_scalar(const uint16_t *in, float *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = half_to_float_table(in[i]);
+}
+
+#if LOSSY_X86
+__attribute__((target("avx,f16c")))
+inline void float_to_half_f16c(const float *in, uint16_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m128i b = _mm256_cvtps_ph(_mm256_loadu_ps(in + i + 8), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8), b);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m128i a = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), a);
+    }
+    float_to_half_scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx,f16c")))
+inline void half_to_float_f16c(const uint16_t *in, float *out, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        __m256 b = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8)));
+        _mm256_storeu_ps(out + i, a);
+        _mm256_storeu_ps(out + i + 8, b);
+    }
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i))));
+    half_to_float_scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+inline void float_to_half_avx512(const float *in, uint16_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a = _mm512_maskz_cvtps_ph(0xFFFF, _mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256i b = _mm512_maskz_cvtps_ph(0xFFFF, _mm512_loadu_ps(in + i + 16), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 16), b);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m256i a = _mm512_maskz_cvtps_ph(0xFFFF, _mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), a);
+    }
+    float_to_half_scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+inline void half_to_float_avx512(const uint16_t *in, float *out, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 a = _mm512_maskz_cvtph_ps(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i)));
+        __m512 b = _mm512_maskz_cvtph_ps(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i + 16)));
+        _mm512_storeu_ps(out + i, a);
+        _mm512_storeu_ps(out + i + 16, b);
+    }
+    for (; i + 16 <= n; i += 16)
+        _mm512_storeu_ps(out + i, _mm512_maskz_cvtph_ps(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i))));
+    half_to_float_scalar(in + i, out + i, n - i);
+}
+#endif
+
+} // namespace detail
+
+// Which conversion path float_to_half()/half_to_float() run on
+enum class HalfPath { Table, F16C, AVX512 };
+
+inline const char *half_path_name(HalfPath path) {
+    switch (path) {
+    case HalfPath::F16C: return "f16c";
+    case HalfPath::AVX512: return "avx512";
+    default: return "table";
+    }
+}
+
+inline HalfPath detect_half_path() {
+    if (detect_simd() == SimdLevel::AVX512) return HalfPath::AVX512;
+    if (cpu_has_f16c()) return HalfPath::F16C;
+    return HalfPath::Table;
+}
+
+// Single-value conversions (always the table path)
+inline uint16_t float_to_half(float value) { return detail::float_to_half_table(value); }
+inline float half_to_float(uint16_t h) { return detail::half_to_float_table(h); }
+
+// This is to convert n floats to half precision on a chosen path
+inline void float_to_half(const float *in, uint16_t *out, size_t n, HalfPath path) {
+    ScopedStage stage("convert", n, n * sizeof(float), n * sizeof(uint16_t));
+    switch (path) {
+#if LOSSY_X86
+    case HalfPath::AVX512: detail::float_to_half_avx512(in, out, n); return;
+    case HalfPath::F16C: detail::float_to_half_f16c(in, out, n); return;
+#endif
+    default: detail::float_to_half_scalar(in, out, n); return;
+    }
+}
+
+// This is to convert n halves back to float on a chosen path
+inline void half_to_float(const uint16_t *in, float *out, size_t n, HalfPath path) {
+    ScopedStage stage("convert", n, n * sizeof(uint16_t), n * sizeof(float));
+    switch (path) {
+#if LOSSY_X86
+    case HalfPath::AVX512: detail::half_to_float_avx512(in, out, n); return;
+    case HalfPath::F16C: detail::half_to_float_f16c(in, out, n); return;
+#endif
+    default: detail::half_to_float_scalar(in, out, n); return;
+    }
+}
+
+inline void float_to_half(const float *in, uint16_t *out, size_t n) {
+    float_to_half(in, out, n, detect_half_path());
+}
+
+inline void half_to_float(const uint16_t *in, float *out, size_t n) {
+    half_to_float(in, out, n, detect_half_path());
+}
+
+} // namespace lossy
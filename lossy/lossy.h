@@ -0,0 +1,40 @@
+#pragma once
+
+// Umbrella header for the lossy/ library.
+//
+// Everything is header-only: include this (with -I pointing at the repository
+// root) and link -lz -pthread (plus -lzstd / -llz4 / -ldeflate for the optional
+// backends of compressor.h). Individual headers can be included instead to
+// keep build times and dependencies down; results.h and pareto.h need
+// neither zlib nor threads.
+
+#include "adaptive.h"
+#include "async_writer.h"
+#include "bitpack.h"
+#include "bitstream.h"
+#include "common.h"
+#include "compressor.h"
+#include "container.h"
+#include "deflate.h"
+#include "distributions.h"
+#include "evaluator.h"
+#include "experiments.h"
+#include "gorilla.h"
+#include "half.h"
+#include "mask.h"
+#include "metrics.h"
+#include "minifloat.h"
+#include "pareto.h"
+#include "pipeline.h"
+#include "predictive.h"
+#include "profile.h"
+#include "random.h"
+#include "rans.h"
+#include "results.h"
+#include "shuffle.h"
+#include "split.h"
+#include "stream_metrics.h"
+#include "stream_pipeline.h"
+#include "sweep.h"
+#include "thread_pool.h"
+#include "truncate.h"
@@ -0,0 +1,169 @@
+#pragma once
+
+// Mantissa LSB-masking kernel (lossy truncation of float32 values).
+//
+// mask_lsb() clears the low `bits_to_zero` mantissa bits of every float in a
+// buffer. The widest SIMD path the CPU supports (AVX-512F, AVX2, SSE2) is
+// picked once at runtime; every path accepts unaligned pointers and any
+// element count, and in == out is allowed for in-place masking.
+
+#include "common.h"
+#include "profile.h"
+
+namespace lossy {
+
+// Mask that keeps everything except the low `bits_to_zero` bits (clamped to 0..23)
+inline uint32_t lsb_mask(int bits_to_zero) {
+    if (bits_to_zero <= 0) return 0xFFFFFFFFu;
+    if (bits_to_zero > 23) bits_to_zero = 23;
+    return ~((1u << bits_to_zero) - 1u);
+}
+
+namespace detail {
+
+// Out-of-place runs larger than this bypass the cache with streaming stores
+constexpr size_t kStreamingBytes = size_t(8) << 20;
+
+inline void mask_scalar(const float *in, float *out, size_t n, uint32_t mask) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t bits;
+        std::memcpy(&bits, in + i, sizeof bits);
+        bits &= mask;
+        std::memcpy(out + i, &bits, sizeof bits);
+    }
+}
+
+// Number of leading elements to process before `out` reaches `align` bytes
+inline size_t head_count(const float *out, size_t n, size_t align) {
+    size_t misalign = reinterpret_cast<uintptr_t>(out) & (align - 1);
+    if (misalign == 0 || misalign % sizeof(float) != 0) return 0;
+    size_t head = (align - misalign) / sizeof(float);
+    return head < n ? head : n;
+}
+
+#if LOSSY_X86
+__attribute__((target("sse2")))
+inline void mask_sse2(const float *in, float *out, size_t n, uint32_t mask) {
+    size_t i = head_count(out, n, 16);
+    mask_scalar(in, out, i, mask);
+    const __m128 m = _mm_castsi128_ps(_mm_set1_epi32(int32_t(mask)));
+    for (; i + 16 <= n; i += 16) {
+        __m128 a = _mm_and_ps(_mm_loadu_ps(in + i), m);
+        __m128 b = _mm_and_ps(_mm_loadu_ps(in + i + 4), m);
+        __m128 c = _mm_and_ps(_mm_loadu_ps(in + i + 8), m);
+        __m128 d = _mm_and_ps(_mm_loadu_ps(in + i + 12), m);
+        _mm_storeu_ps(out + i, a);
+        _mm_storeu_ps(out + i + 4, b);
+        _mm_storeu_ps(out + i + 8, c);
+        _mm_storeu_ps(out + i + 12, d);
+    }
+    for (; i + 4 <= n; i += 4) _mm_storeu_ps(out + i, _mm_and_ps(_mm_loadu_ps(in + i), m));
+    mask_scalar(in + i, out + i, n - i, mask);
+}
+
+__attribute__((target("avx2")))
+inline void mask_avx2(const float *in, float *out, size_t n, uint32_t mask) {
+    size_t i = head_count(out, n, 32);
+    mask_scalar(in, out, i, mask);
+    const __m256 m = _mm256_castsi256_ps(_mm256_set1_epi32(int32_t(mask)));
+    bool stream = in != out && n * sizeof(float) >= kStreamingBytes &&
+                  (reinterpret_cast<uintptr_t>(out + i) & 31) == 0;
+    if (stream) {
+        for (; i + 32 <= n; i += 32) {
+            __m256 a = _mm256_and_ps(_mm256_loadu_ps(in + i), m);
+            __m256 b = _mm256_and_ps(_mm256_loadu_ps(in + i + 8), m);
+            __m256 c = _mm256_and_ps(_mm256_loadu_ps(in + i + 16), m);
+            __m256 d = _mm256_and_ps(_mm256_loadu_ps(in + i + 24), m);
+            _mm256_stream_ps(out + i, a);
+            _mm256_stream_ps(out + i + 8, b);
+            _mm256_stream_ps(out + i + 16, c);
+            _mm256_stream_ps(out + i + 24, d);
+        }
+        _mm_sfence();
+    }
+    for (; i + 32 <= n; i += 32) {
+        __m256 a = _mm256_and_ps(_mm256_loadu_ps(in + i), m);
+        __m256 b = _mm256_and_ps(_mm256_loadu_ps(in + i + 8), m);
+        __m256 c = _mm256_and_ps(_mm256_loadu_ps(in + i + 16), m);
+        __m256 d = _mm256_and_ps(_mm256_loadu_ps(in + i + 24), m);
+        _mm256_storeu_ps(out + i, a);
+        _mm256_storeu_ps(out + i + 8, b);
+        _mm256_storeu_ps(out + i + 16, c);
+        _mm256_storeu_ps(out + i + 24, d);
+    }
+    for (; i + 8 <= n; i += 8) _mm256_storeu_ps(out + i, _mm256_and_ps(_mm256_loadu_ps(in + i), m));
+    mask_scalar(in + i, out + i, n - i, mask);
+}
+
+__attribute__((target("avx512f")))
+inline void mask_avx512(const float *in, float *out, size_t n, uint32_t mask) {
+    size_t i = head_count(out, n, 64);
+    mask_scalar(in, out, i, mask);
+    const __m512i m = _mm512_set1_epi32(int32_t(mask));
+    bool stream = in != out && n * sizeof(float) >= kStreamingBytes &&
+                  (reinterpret_cast<uintptr_t>(out + i) & 63) == 0;
+    if (stream) {
+        for (; i + 64 <= n; i += 64) {
+            __m512i a = _mm512_and_si512(_mm512_loadu_si512(in + i), m);
+            __m512i b = _mm512_and_si512(_mm512_loadu_si512(in + i + 16), m);
+            __m512i c = _mm512_and_si512(_mm512_loadu_si512(in + i + 32), m);
+            __m512i d = _mm512_and_si512(_mm512_loadu_si512(in + i + 48), m);
+            _mm512_stream_si512(reinterpret_cast<__m512i *>(out + i), a);
+            _mm512_stream_si512(reinterpret_cast<__m512i *>(out + i + 16), b);
+            _mm512_stream_si512(reinterpret_cast<__m512i *>(out + i + 32), c);
+            _mm512_stream_si512(reinterpret_cast<__m512i *>(out + i + 48), d);
+        }
+        _mm_sfence();
+    }
+    for (; i + 64 <= n; i += 64) {
+        __m512i a = _mm512_and_si512(_mm512_loadu_si512(in + i), m);
+        __m512i b = _mm512_and_si512(_mm512_loadu_si512(in + i + 16), m);
+        __m512i c = _mm512_and_si512(_mm512_loadu_si512(in + i + 32), m);
+        __m512i d = _mm512_and_si512(_mm512_loadu_si512(in + i + 48), m);
+        _mm512_storeu_si512(out + i, a);
+        _mm512_storeu_si512(out + i + 16, b);
+        _mm512_storeu_si512(out + i + 32, c);
+        _mm512_storeu_si512(out + i + 48, d);
+    }
+    for (; i + 16 <= n; i += 16)
+        _mm512_storeu_si512(out + i, _mm512_and_si512(_mm512_loadu_si512(in + i), m));
+    // Masked load/store finishes the last 0..15 elements in one step
+    if (i < n) {
+        __mmask16 k = __mmask16((1u << (n - i)) - 1u);
+        __m512i v = _mm512_maskz_loadu_epi32(k, in + i);
+        _mm512_mask_storeu_epi32(out + i, k, _mm512_and_si512(v, m));
+    }
+}
+#endif
+
+} // namespace detail
+
+// This is to mask n floats from `in` into `out` using an explicit SIMD level
+inline void mask_lsb(const float *in, float *out, size_t n, int bits_to_zero, SimdLevel level) {
+    ScopedStage stage("truncate", n, n * sizeof(float), n * sizeof(float));
+    const uint32_t mask = lsb_mask(bits_to_zero);
+    if (mask == 0xFFFFFFFFu) {
+        if (in != out) std::memcpy(out, in, n * sizeof(float));
+        return;
+    }
+    switch (level) {
+#if LOSSY_X86
+    case SimdLevel::AVX512: detail::mask_avx512(in, out, n, mask); return;
+    case SimdLevel::AVX2: detail::mask_avx2(in, out, n, mask); return;
+    case SimdLevel::SSE2: detail::mask_sse2(in, out, n, mask); return;
+#endif
+    default: detail::mask_scalar(in, out, n, mask); return;
+    }
+}
+
+// This is to mask n floats from `in` into `out` on the fastest path available
+inline void mask_lsb(const float *in, float *out, size_t n, int bits_to_zero) {
+    mask_lsb(in, out, n, bits_to_zero, detect_simd());
+}
+
+// This is to mask a buffer in place
+inline void mask_lsb(float *data, size_t n, int bits_to_zero) {
+    mask_lsb(data, data, n, bits_to_zero, detect_simd());
+}
+
+} // namespace lossy
@@ -0,0 +1,404 @@
+#pragma once
+
+// Fused single-pass error metrics and statistics.
+//
+// compute_metrics() reads an original and a reconstructed array once and
+// returns MSE, MAE, max absolute error, PSNR and the mean/std of both arrays.
+// The data is consumed in cache-sized blocks: a SIMD kernel (AVX-512F, AVX2
+// or scalar, picked at runtime) sums each block in double precision around a
+// per-block shift, and blocks are merged with Chan/Welford updates for the
+// moments and Neumaier-compensated sums for the error totals, so the result
+// stays accurate at 10^9 elements. Partial results over fixed-size ranges
+// are merged in index order, and with a ThreadPool those ranges simply run in
+// parallel, so the answer is bit-identical for any thread count.
+//
+// The same pass counts range clipping for narrow formats (minifloat.h):
+// finite originals beyond a clip limit or reconstructed as Inf/NaN
+// (overflow), and non-zero originals reconstructed as zero (underflow).
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "common.h"
+#include "profile.h"
+#include "thread_pool.h"
+
+namespace lossy {
+
+struct ErrorMetrics {
+    size_t count = 0;
+    double mse = 0.0;
+    double mae = 0.0;
+    double max_abs_error = 0.0;
+    double psnr = 0.0;        // dB, peak = value range of the original; +inf when lossless
+    double value_range = 0.0; // max - min of the original
+    double mean_original = 0.0;
+    double std_original = 0.0;
+    double mean_reconstructed = 0.0;
+    double std_reconstructed = 0.0;
+    size_t overflowed = 0;    // finite originals above the clip limit or reconstructed as Inf/NaN
+    size_t underflowed = 0;   // non-zero originals reconstructed as zero
+};
+
+// Elements per partial result. The split is fixed so threading never changes the
+// merge order; streaming callers feeding whole parts reproduce the in-memory result.
+constexpr size_t kMetricsPart = size_t(64) * 4096;
+
+namespace detail {
+
+// Elements per block: both arrays of a block stay in L1/L2 while it is summed
+constexpr size_t kMetricsBlock = 4096;
+
+// Raw sums of one block; the a/b moments are taken around the shifts ka/kb
+struct BlockSums {
+    double sa = 0, sb = 0, saa = 0, sbb = 0;
+    double se2 = 0, sabs = 0, max_err = 0;
+    float min_a = std::numeric_limits<float>::infinity();
+    float max_a = -std::numeric_limits<float>::infinity();
+    float clip = std::numeric_limits<float>::infinity(); // input: magnitudes above it count as overflow
+    uint64_t overflowed = 0, underflowed = 0;
+};
+
+// Clipping tests shared by the kernels; NaN originals count as neither
+inline bool is_overflow(float a, float b, float clip) {
+    float fa = std::fabs(a), fb = std::fabs(b);
+    return fa <= std::numeric_limits<float>::max() && (!(fb <= std::numeric_limits<float>::max()) || fa > clip);
+}
+
+inline bool is_underflow(float a, float b) { return std::fabs(a) > 0.0f && b == 0.0f; }
+
+// Neumaier (improved Kahan) summation
+struct CompensatedSum {
+    double sum = 0.0, carry = 0.0;
+    void add(double x) {
+        double t = sum + x;
+        if (std::fabs(sum) >= std::fabs(x)) {
+            carry += (sum - t) + x;
+        } else {
+            carry += (x - t) + sum;
+        }
+        sum = t;
+    }
+    void add(const CompensatedSum &other) {
+        add(other.sum);
+        add(other.carry);
+    }
+    double value() const { return sum + carry; }
+};
+
+inline void block_scalar(const float *a, const float *b, size_t n, double ka, double kb, BlockSums &s) {
+    for (size_t i = 0; i < n; i++) {
+        double x = a[i], y = b[i];
+        double e = x - y, da = x - ka, db = y - kb;
+        s.sa += da;
+        s.sb += db;
+        s.saa += da * da;
+        s.sbb += db * db;
+        s.se2 += e * e;
+        s.sabs += std::fabs(e);
+        s.max_err = std::max(s.max_err, std::fabs(e));
+        s.min_a = std::min(s.min_a, a[i]);
+        s.max_a = std::max(s.max_a, a[i]);
+        s.overflowed += is_overflow(a[i], b[i], s.clip);
+        s.underflowed += is_underflow(a[i], b[i]);
+    }
+}
+
+#if LOSSY_X86
+__attribute__((target("avx2")))
+inline double hsum256(__m256d v) {
+    __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2")))
+inline double hmax256(__m256d v) {
+    __m128d lo = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(lo, _mm_unpackhi_pd(lo, lo)));
+}
+
+__attribute__((target("avx2")))
+inline void hminmax256(__m256 lo, __m256 hi, BlockSums &s) {
+    alignas(32) float l[8], h[8];
+    _mm256_store_ps(l, lo);
+    _mm256_store_ps(h, hi);
+    for (int k = 0; k < 8; k++) {
+        s.min_a = std::min(s.min_a, l[k]);
+        s.max_a = std::max(s.max_a, h[k]);
+    }
+}
+
+// Per-lane counts of the clipping tests; a block is far too short for the 32-bit lanes to wrap
+__attribute__((target("avx2")))
+inline void clip_counts256(__m256 va, __m256 vb, __m256 clip, __m256i &over, __m256i &under) {
+    const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 max = _mm256_set1_ps(std::numeric_limits<float>::max());
+    __m256 fa = _mm256_and_ps(va, magnitude), fb = _mm256_and_ps(vb, magnitude);
+    __m256 o = _mm256_and_ps(_mm256_cmp_ps(fa, max, _CMP_LE_OQ),
+                             _mm256_or_ps(_mm256_cmp_ps(fb, max, _CMP_NLE_UQ), _mm256_cmp_ps(fa, clip, _CMP_GT_OQ)));
+    __m256 u = _mm256_and_ps(_mm256_cmp_ps(fa, _mm256_setzero_ps(), _CMP_GT_OQ),
+                             _mm256_cmp_ps(vb, _mm256_setzero_ps(), _CMP_EQ_OQ));
+    over = _mm256_sub_epi32(over, _mm256_castps_si256(o));
+    under = _mm256_sub_epi32(under, _mm256_castps_si256(u));
+}
+
+__attribute__((target("avx2")))
+inline uint64_t hsum256_epi32(__m256i v) {
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), v);
+    uint64_t sum = 0;
+    for (uint32_t lane : lanes) sum += lane;
+    return sum;
+}
+
+__attribute__((target("avx2")))
+inline void block_avx2(const float *a, const float *b, size_t n, double ka, double kb, BlockSums &s) {
+    const __m256d vka = _mm256_set1_pd(ka), vkb = _mm256_set1_pd(kb);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d sa = _mm256_setzero_pd(), sb = sa, saa = sa, sbb = sa, se2 = sa, sabs = sa, mx = sa;
+    __m256 mn = _mm256_set1_ps(s.min_a), mxa = _mm256_set1_ps(s.max_a), clip = _mm256_set1_ps(s.clip);
+    __m256i over = _mm256_setzero_si256(), under = over;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 va = _mm256_loadu_ps(a + i), vb = _mm256_loadu_ps(b + i);
+        mn = _mm256_min_ps(mn, va);
+        mxa = _mm256_max_ps(mxa, va);
+        clip_counts256(va, vb, clip, over, under);
+        for (int half = 0; half < 2; half++) {
+            __m128 ha = half ? _mm256_extractf128_ps(va, 1) : _mm256_castps256_ps128(va);
+            __m128 hb = half ? _mm256_extractf128_ps(vb, 1) : _mm256_castps256_ps128(vb);
+            __m256d x = _mm256_cvtps_pd(ha), y = _mm256_cvtps_pd(hb);
+            __m256d e = _mm256_sub_pd(x, y);
+            __m256d ae = _mm256_andnot_pd(sign, e);
+            __m256d da = _mm256_sub_pd(x, vka), db = _mm256_sub_pd(y, vkb);
+            sa = _mm256_add_pd(sa, da);
+            sb = _mm256_add_pd(sb, db);
+            saa = _mm256_add_pd(saa, _mm256_mul_pd(da, da));
+            sbb = _mm256_add_pd(sbb, _mm256_mul_pd(db, db));
+            se2 = _mm256_add_pd(se2, _mm256_mul_pd(e, e));
+            sabs = _mm256_add_pd(sabs, ae);
+            mx = _mm256_max_pd(mx, ae);
+        }
+    }
+    s.sa += hsum256(sa);
+    s.sb += hsum256(sb);
+    s.saa += hsum256(saa);
+    s.sbb += hsum256(sbb);
+    s.se2 += hsum256(se2);
+    s.sabs += hsum256(sabs);
+    s.max_err = std::max(s.max_err, hmax256(mx));
+    hminmax256(mn, mxa, s);
+    s.overflowed += hsum256_epi32(over);
+    s.underflowed += hsum256_epi32(under);
+    block_scalar(a + i, b + i, n - i, ka, kb, s);
+}
+
+// The maskz forms below avoid GCC's -Wmaybe-uninitialized on _mm512_undefined_*()
+__attribute__((target("avx512f")))
+inline double hsum512(__m512d v) {
+    return hsum256(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, v, 0), _mm512_maskz_extractf64x4_pd(0xF, v, 1)));
+}
+
+__attribute__((target("avx512f")))
+inline void block_avx512(const float *a, const float *b, size_t n, double ka, double kb, BlockSums &s) {
+    const __m512d vka = _mm512_set1_pd(ka), vkb = _mm512_set1_pd(kb);
+    __m512d sa = _mm512_setzero_pd(), sb = sa, saa = sa, sbb = sa, se2 = sa, sabs = sa, mx = sa;
+    __m256 mn = _mm256_set1_ps(s.min_a), mxa = _mm256_set1_ps(s.max_a), clip = _mm256_set1_ps(s.clip);
+    __m256i over = _mm256_setzero_si256(), under = over;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        for (int half = 0; half < 2; half++) {
+            __m256 va = _mm256_loadu_ps(a + i + 8 * half), vb = _mm256_loadu_ps(b + i + 8 * half);
+            mn = _mm256_min_ps(mn, va);
+            mxa = _mm256_max_ps(mxa, va);
+            clip_counts256(va, vb, clip, over, under);
+            __m512d x = _mm512_maskz_cvtps_pd(0xFF, va);
+            __m512d y = _mm512_maskz_cvtps_pd(0xFF, vb);
+            __m512d e = _mm512_sub_pd(x, y);
+            __m512d ae = _mm512_abs_pd(e);
+            __m512d da = _mm512_sub_pd(x, vka), db = _mm512_sub_pd(y, vkb);
+            sa = _mm512_add_pd(sa, da);
+            sb = _mm512_add_pd(sb, db);
+            saa = _mm512_fmadd_pd(da, da, saa);
+            sbb = _mm512_fmadd_pd(db, db, sbb);
+            se2 = _mm512_fmadd_pd(e, e, se2);
+            sabs = _mm512_add_pd(sabs, ae);
+            mx = _mm512_maskz_max_pd(0xFF, mx, ae);
+        }
+    }
+    s.sa += hsum512(sa);
+    s.sb += hsum512(sb);
+    s.saa += hsum512(saa);
+    s.sbb += hsum512(sbb);
+    s.se2 += hsum512(se2);
+    s.sabs += hsum512(sabs);
+    s.max_err = std::max(s.max_err, hmax256(_mm256_max_pd(_mm512_maskz_extractf64x4_pd(0xF, mx, 0), _mm512_maskz_extractf64x4_pd(0xF, mx, 1))));
+    hminmax256(mn, mxa, s);
+    s.overflowed += hsum256_epi32(over);
+    s.underflowed += hsum256_epi32(under);
+    block_scalar(a + i, b + i, n - i, ka, kb, s);
+}
+#endif
+
+} // namespace detail
+
+// Running metrics over any number of add() calls; merge() joins two accumulators
+class MetricsAccumulator {
+public:
+    // clip_limit: the largest magnitude the reconstruction's format holds (counts overflow)
+    explicit MetricsAccumulator(float clip_limit = std::numeric_limits<float>::infinity()) : clip_(clip_limit) {}
+
+    float clip_limit() const { return clip_; }
+
+    // This is to fold n (original, reconstructed) pairs into the running totals
+    void add(const float *original, const float *reconstructed, size_t n, SimdLevel level = detect_simd()) {
+        for (size_t i = 0; i < n; i += detail::kMetricsBlock) {
+            size_t len = std::min(detail::kMetricsBlock, n - i);
+            add_block(original + i, reconstructed + i, len, level);
+        }
+    }
+
+    // This is to combine with the totals of a later range (Chan et al. pairwise update)
+    void merge(const MetricsAccumulator &o) {
+        if (o.n_ == 0) return;
+        if (n_ == 0) {
+            float clip = clip_;
+            *this = o;
+            clip_ = clip;
+            return;
+        }
+        double n = double(n_), m = double(o.n_), total = n + m;
+        double da = o.mean_a_ - mean_a_, db = o.mean_b_ - mean_b_;
+        mean_a_ += da * m / total;
+        mean_b_ += db * m / total;
+        m2_a_ += o.m2_a_ + da * da * n * m / total;
+        m2_b_ += o.m2_b_ + db * db * n * m / total;
+        sq_err_.add(o.sq_err_);
+        abs_err_.add(o.abs_err_);
+        max_err_ = std::max(max_err_, o.max_err_);
+        min_a_ = std::min(min_a_, o.min_a_);
+        max_a_ = std::max(max_a_, o.max_a_);
+        overflowed_ += o.overflowed_;
+        underflowed_ += o.underflowed_;
+        n_ += o.n_;
+    }
+
+    ErrorMetrics result() const {
+        ErrorMetrics r;
+        r.count = n_;
+        if (n_ == 0) return r;
+        double n = double(n_);
+        r.mse = sq_err_.value() / n;
+        r.mae = abs_err_.value() / n;
+        r.max_abs_error = max_err_;
+        r.value_range = double(max_a_) - double(min_a_);
+        r.psnr = r.mse > 0.0 ? 10.0 * std::log10(r.value_range * r.value_range / r.mse)
+                             : std::numeric_limits<double>::infinity();
+        r.mean_original = mean_a_;
+        r.std_original = std::sqrt(m2_a_ / n);
+        r.mean_reconstructed = mean_b_;
+        r.std_reconstructed = std::sqrt(m2_b_ / n);
+        r.overflowed = overflowed_;
+        r.underflowed = underflowed_;
+        return r;
+    }
+
+private:
+    void add_block(const float *a, const float *b, size_t len, SimdLevel level) {
+        // Summing around the block's first value keeps the squares small (shifted-data variance)
+        const double ka = a[0], kb = b[0];
+        detail::BlockSums s;
+        s.clip = clip_;
+#if LOSSY_X86
+        if (level == SimdLevel::AVX512) {
+            detail::block_avx512(a, b, len, ka, kb, s);
+        } else if (level == SimdLevel::AVX2) {
+            detail::block_avx2(a, b, len, ka, kb, s);
+        } else {
+            detail::block_scalar(a, b, len, ka, kb, s);
+        }
+#else
+        (void)level;
+        detail::block_scalar(a, b, len, ka, kb, s);
+#endif
+        MetricsAccumulator block;
+        double m = double(len);
+        block.n_ = len;
+        block.mean_a_ = ka + s.sa / m;
+        block.mean_b_ = kb + s.sb / m;
+        block.m2_a_ = std::max(0.0, s.saa - s.sa * s.sa / m);
+        block.m2_b_ = std::max(0.0, s.sbb - s.sb * s.sb / m);
+        block.sq_err_.add(s.se2);
+        block.abs_err_.add(s.sabs);
+        block.max_err_ = s.max_err;
+        block.min_a_ = s.min_a;
+        block.max_a_ = s.max_a;
+        block.overflowed_ = s.overflowed;
+        block.underflowed_ = s.underflowed;
+        merge(block);
+    }
+
+    size_t n_ = 0;
+    double mean_a_ = 0.0, m2_a_ = 0.0, mean_b_ = 0.0, m2_b_ = 0.0;
+    detail::CompensatedSum sq_err_, abs_err_;
+    double max_err_ = 0.0;
+    float min_a_ = std::numeric_limits<float>::infinity();
+    float max_a_ = -std::numeric_limits<float>::infinity();
+    float clip_;
+    size_t overflowed_ = 0, underflowed_ = 0;
+};
+
+// This is to fold n pairs into total part by part; n should start on a part boundary of the whole array
+inline void accumulate_metrics(MetricsAccumulator &total, const float *original, const float *reconstructed, size_t n) {
+    for (size_t first = 0; first < n; first += kMetricsPart) {
+        MetricsAccumulator part(total.clip_limit());
+        part.add(original + first, reconstructed + first, std::min(kMetricsPart, n - first));
+        total.merge(part);
+    }
+}
+
+// This is the same on the pool; gives bit-identical totals for any thread count
+inline void accumulate_metrics(MetricsAccumulator &total, const float *original, const float *reconstructed, size_t n,
+                               ThreadPool &pool) {
+    size_t parts = (n + kMetricsPart - 1) / kMetricsPart;
+    if (parts <= 1 || pool.size() <= 1) return accumulate_metrics(total, original, reconstructed, n);
+    std::vector<MetricsAccumulator> partial(parts, MetricsAccumulator(total.clip_limit()));
+    parallel_for(pool, parts, [&](size_t p) {
+        size_t first = p * kMetricsPart;
+        partial[p].add(original + first, reconstructed + first, std::min(kMetricsPart, n - first));
+    });
+    for (const MetricsAccumulator &acc : partial) total.merge(acc);
+}
+
+// This is to compute every metric in one pass over both arrays; clip_limit is the reconstruction format's largest value
+inline ErrorMetrics compute_metrics(const float *original, const float *reconstructed, size_t n,
+                                    float clip_limit = std::numeric_limits<float>::infinity()) {
+    ScopedStage stage("metrics", n, 2 * n * sizeof(float));
+    MetricsAccumulator total(clip_limit);
+    accumulate_metrics(total, original, reconstructed, n);
+    return total.result();
+}
+
+inline ErrorMetrics compute_metrics(const float *original, const float *reconstructed, size_t n, ThreadPool &pool,
+                                    float clip_limit = std::numeric_limits<float>::infinity()) {
+    ScopedStage stage("metrics", n, 2 * n * sizeof(float));
+    MetricsAccumulator total(clip_limit);
+    accumulate_metrics(total, original, reconstructed, n, pool);
+    return total.result();
+}
+
+inline ErrorMetrics compute_metrics(const std::vector<float> &original, const std::vector<float> &reconstructed,
+                                    float clip_limit = std::numeric_limits<float>::infinity()) {
+    return compute_metrics(original.data(), reconstructed.data(), std::min(original.size(), reconstructed.size()),
+                           clip_limit);
+}
+
+inline ErrorMetrics compute_metrics(const std::vector<float> &original, const std::vector<float> &reconstructed,
+                                    ThreadPool &pool, float clip_limit = std::numeric_limits<float>::infinity()) {
+    return compute_metrics(original.data(), reconstructed.data(), std::min(original.size(), reconstructed.size()), pool,
+                           clip_limit);
+}
+
+} // namespace lossy
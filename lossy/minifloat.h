@@ -0,0 +1,464 @@
+#pragma once
+
+// Configurable minifloat formats (ExMy) and batch float32 converters.
+//
+// Minifloat<E, M, S> is a sign bit, E exponent bits and M mantissa bits.
+// bfloat16, OCP FP8 E5M2 / E4M3 and a 24-bit E8M15 are predefined. The
+// exponent bias is a run-time argument (default 2^(E-1) - 1) so a format can
+// be slid over a variable's range; choose_bias() finds the one that just
+// covers a maximum magnitude.
+//
+// float_to_minifloat() rounds to nearest, ties to even, and produces
+// subnormals. What happens past the largest finite value is the Overflow
+// policy (saturate to +-max, or go to Inf, or to NaN when the format has no
+// Inf), and NaN inputs follow the NaN policy. minifloat_to_float() is exact
+// (NaNs come back as the canonical quiet NaN). Special values:
+//   IEEE       top exponent is Inf (mantissa 0) or NaN, as binary16 (E5M2, bf16)
+//   FiniteNaN  no Inf, only S.1111.111 is NaN (OCP E4M3)
+//   None       every pattern is a finite number
+// Both directions have AVX2 kernels picked at runtime and scalar loops with
+// identical results; subnormals are rounded by one float add of a power of
+// two, normals by integer rounding on the bit pattern.
+//
+// The Precision enum (half.h) names the predefined formats for the container:
+// encode_precision() / decode_precision() convert to and from any of them,
+// storing each value in whole bytes (3 for E8M15). pack_codes() bit-packs
+// formats of other widths densely (bitpack.h), e.g. 6 bits for E3M2.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "bitpack.h"
+#include "common.h"
+#include "half.h"
+
+namespace lossy {
+
+enum class Specials : uint8_t { IEEE, FiniteNaN, None };
+enum class Overflow : uint8_t { Saturate, Infinity };
+enum class NaNMode : uint8_t { Propagate, Zero };
+
+struct MinifloatPolicy {
+    Overflow overflow = Overflow::Saturate; // Infinity gives NaN on formats without Inf
+    NaNMode nan = NaNMode::Propagate;       // Propagate gives zero on formats without NaN
+};
+
+template <int E, int M, Specials S = Specials::IEEE>
+struct Minifloat {
+    static_assert(E >= 2 && E <= 8 && M >= 1 && M <= 23, "exponent 2..8 bits, mantissa 1..23 bits");
+    static constexpr int exponent_bits = E;
+    static constexpr int mantissa_bits = M;
+    static constexpr Specials specials = S;
+    static constexpr int bits = 1 + E + M;
+    static constexpr int bytes = (bits + 7) / 8;
+    static constexpr int default_bias = (1 << (E - 1)) - 1;
+    using Storage = std::conditional_t<bits <= 8, uint8_t, std::conditional_t<bits <= 16, uint16_t, uint32_t>>;
+
+    static constexpr uint32_t magnitude_mask = (1u << (E + M)) - 1u;
+    static constexpr bool has_inf = S == Specials::IEEE;
+    static constexpr bool has_nan = S != Specials::None;
+    static constexpr uint32_t inf_code = has_inf ? ((1u << E) - 1u) << M : 0;
+    static constexpr uint32_t nan_code = has_inf ? inf_code | (1u << (M - 1)) : has_nan ? magnitude_mask : 0;
+    static constexpr uint32_t max_code = has_inf ? inf_code - 1u : has_nan ? magnitude_mask - 1u : magnitude_mask;
+    // Largest exponent field holding finite values
+    static constexpr int top_exponent = has_inf ? (1 << E) - 2 : (1 << E) - 1;
+    // Biases whose normal range fits inside float32's
+    static constexpr int min_bias = top_exponent - 127;
+    static constexpr int max_bias = 127;
+};
+
+using BFloat16 = Minifloat<8, 7>;
+using Binary16 = Minifloat<5, 10>;
+using E5M2 = Minifloat<5, 2>;
+using E4M3 = Minifloat<4, 3, Specials::FiniteNaN>;
+using E8M15 = Minifloat<8, 15>;
+
+namespace detail {
+
+// Everything a conversion needs that depends on the run-time bias and policy
+struct MinifloatLayout {
+    uint32_t min_normal_bits; // float32 bits of the format's smallest normal
+    uint32_t rebias;          // (127 - bias) << M: float exponent -> format exponent
+    float subnormal_magic;    // 2^(smallest normal exponent - M + 23): adding it rounds to the subnormal step
+    float subnormal_step;     // value of the smallest subnormal
+    uint32_t overflow_code, inf_input_code, nan_input_code;
+};
+
+template <typename F>
+MinifloatLayout minifloat_layout(int bias, MinifloatPolicy policy) {
+    if (bias < F::min_bias || bias > F::max_bias)
+        throw std::runtime_error("minifloat bias " + std::to_string(bias) + " out of range");
+    const int min_exponent = 1 - bias;
+    MinifloatLayout L;
+    L.min_normal_bits = uint32_t(min_exponent + 127) << 23;
+    L.rebias = uint32_t(127 - bias) << F::mantissa_bits;
+    L.subnormal_magic = bits_float(uint32_t(min_exponent - F::mantissa_bits + 23 + 127) << 23);
+    L.subnormal_step = std::ldexp(1.0f, min_exponent - F::mantissa_bits);
+    L.overflow_code = policy.overflow == Overflow::Saturate ? F::max_code
+                      : F::has_inf                          ? F::inf_code
+                      : F::has_nan                          ? F::nan_code
+                                                            : F::max_code;
+    L.inf_input_code = F::has_inf ? F::inf_code : L.overflow_code;
+    L.nan_input_code = policy.nan == NaNMode::Propagate && F::has_nan ? F::nan_code : 0;
+    return L;
+}
+
+template <typename F>
+inline uint32_t minifloat_encode_one(float x, const MinifloatLayout &L) {
+    constexpr int shift = 23 - F::mantissa_bits;
+    const uint32_t f = float_bits(x), a = f & 0x7FFFFFFFu;
+    const uint32_t sign = (f >> 31) << (F::bits - 1);
+    uint32_t code;
+    if (a < L.min_normal_bits) {
+        code = float_bits(bits_float(a) + L.subnormal_magic) - float_bits(L.subnormal_magic);
+    } else if (a < 0x7F800000u) {
+        uint32_t round = 0;
+        if constexpr (shift > 0) round = (1u << (shift - 1)) - 1u + ((a >> shift) & 1u);
+        code = ((a + round) >> shift) - L.rebias;
+        if (code > F::max_code) code = L.overflow_code;
+    } else {
+        code = a == 0x7F800000u ? L.inf_input_code : L.nan_input_code;
+    }
+    return code | sign;
+}
+
+template <typename F>
+inline float minifloat_decode_one(uint32_t code, const MinifloatLayout &L) {
+    constexpr int shift = 23 - F::mantissa_bits;
+    const uint32_t sign = ((code >> (F::bits - 1)) & 1u) << 31;
+    const uint32_t mag = code & F::magnitude_mask;
+    uint32_t f;
+    if ((F::has_inf && mag > F::inf_code) || (F::specials == Specials::FiniteNaN && mag == F::magnitude_mask)) {
+        f = 0x7FC00000u;
+    } else if (F::has_inf && mag == F::inf_code) {
+        f = 0x7F800000u;
+    } else if (mag == 0) {
+        f = 0;
+    } else if (mag < (1u << F::mantissa_bits)) {
+        f = float_bits(float(mag) * L.subnormal_step);
+    } else {
+        f = (mag << shift) + (L.rebias << shift);
+    }
+    return bits_float(f | sign);
+}
+
+template <typename F>
+inline void minifloat_encode_scalar(const float *in, typename F::Storage *out, size_t n, const MinifloatLayout &L) {
+    for (size_t i = 0; i < n; i++) out[i] = typename F::Storage(minifloat_encode_one<F>(in[i], L));
+}
+
+template <typename F>
+inline void minifloat_decode_scalar(const typename F::Storage *in, float *out, size_t n, const MinifloatLayout &L) {
+    for (size_t i = 0; i < n; i++) out[i] = minifloat_decode_one<F>(in[i], L);
+}
+
+#if LOSSY_X86
+// 8 codes in 32-bit lanes <-> 8 stored codes of 1, 2 or 4 bytes
+__attribute__((target("avx2")))
+inline void store_codes(uint8_t *out, __m256i v) {
+    __m256i w = _mm256_packus_epi16(_mm256_packus_epi32(v, v), _mm256_setzero_si256());
+    w = _mm256_permutevar8x32_epi32(w, _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm256_castsi256_si128(w));
+}
+
+__attribute__((target("avx2")))
+inline void store_codes(uint16_t *out, __m256i v) {
+    __m256i w = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm256_castsi256_si128(w));
+}
+
+__attribute__((target("avx2")))
+inline void store_codes(uint32_t *out, __m256i v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), v); }
+
+__attribute__((target("avx2")))
+inline __m256i load_codes(const uint8_t *in) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in)));
+}
+
+__attribute__((target("avx2")))
+inline __m256i load_codes(const uint16_t *in) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in)));
+}
+
+__attribute__((target("avx2")))
+inline __m256i load_codes(const uint32_t *in) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in)); }
+
+template <typename F>
+__attribute__((target("avx2")))
+void minifloat_encode_avx2(const float *in, typename F::Storage *out, size_t n, const MinifloatLayout &L) {
+    constexpr int shift = 23 - F::mantissa_bits;
+    const __m256i magnitude = _mm256_set1_epi32(0x7FFFFFFF);
+    const __m256i inf = _mm256_set1_epi32(0x7F800000);
+    const __m256i min_normal = _mm256_set1_epi32(int32_t(L.min_normal_bits));
+    const __m256 magic = _mm256_set1_ps(L.subnormal_magic);
+    const __m256i magic_bits = _mm256_set1_epi32(int32_t(float_bits(L.subnormal_magic)));
+    // Half a step minus one; the kept LSB is added per lane for ties-to-even
+    const __m256i half = _mm256_set1_epi32(int32_t((1u << (shift > 0 ? shift - 1 : 0)) - 1u));
+    const __m256i one = _mm256_set1_epi32(shift > 0 ? 1 : 0);
+    const __m256i rebias = _mm256_set1_epi32(int32_t(L.rebias));
+    const __m256i max_code = _mm256_set1_epi32(int32_t(F::max_code));
+    const __m256i overflow = _mm256_set1_epi32(int32_t(L.overflow_code));
+    const __m256i inf_code = _mm256_set1_epi32(int32_t(L.inf_input_code));
+    const __m256i nan_code = _mm256_set1_epi32(int32_t(L.nan_input_code));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i a = _mm256_and_si256(x, magnitude);
+        __m256i sign = _mm256_slli_epi32(_mm256_srli_epi32(x, 31), F::bits - 1);
+        __m256i sub = _mm256_sub_epi32(_mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(a), magic)), magic_bits);
+        __m256i round = _mm256_add_epi32(half, _mm256_and_si256(_mm256_srli_epi32(a, shift), one));
+        __m256i code = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_add_epi32(a, round), shift), rebias);
+        // Every operand is below 2^31 here, so the signed compares order them correctly
+        code = _mm256_blendv_epi8(code, overflow, _mm256_cmpgt_epi32(code, max_code));
+        code = _mm256_blendv_epi8(code, sub, _mm256_cmpgt_epi32(min_normal, a));
+        code = _mm256_blendv_epi8(code, inf_code, _mm256_cmpeq_epi32(a, inf));
+        code = _mm256_blendv_epi8(code, nan_code, _mm256_cmpgt_epi32(a, inf));
+        store_codes(out + i, _mm256_or_si256(code, sign));
+    }
+    minifloat_encode_scalar<F>(in + i, out + i, n - i, L);
+}
+
+template <typename F>
+__attribute__((target("avx2")))
+void minifloat_decode_avx2(const typename F::Storage *in, float *out, size_t n, const MinifloatLayout &L) {
+    constexpr int shift = 23 - F::mantissa_bits;
+    const __m256i magnitude = _mm256_set1_epi32(int32_t(F::magnitude_mask));
+    const __m256i first_normal = _mm256_set1_epi32(int32_t(1u << F::mantissa_bits));
+    const __m256 step = _mm256_set1_ps(L.subnormal_step);
+    const __m256i rebias = _mm256_set1_epi32(int32_t(L.rebias << shift));
+    const __m256i inf_code = _mm256_set1_epi32(int32_t(F::inf_code));
+    const __m256i nan_code = _mm256_set1_epi32(int32_t(F::nan_code));
+    const __m256i inf = _mm256_set1_epi32(0x7F800000);
+    const __m256i nan = _mm256_set1_epi32(0x7FC00000);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i c = load_codes(in + i);
+        __m256i sign = _mm256_slli_epi32(_mm256_srli_epi32(c, F::bits - 1), 31);
+        __m256i mag = _mm256_and_si256(c, magnitude);
+        __m256i f = _mm256_add_epi32(_mm256_slli_epi32(mag, shift), rebias);
+        __m256i small = _mm256_cmpgt_epi32(first_normal, mag);
+        f = _mm256_andnot_si256(small, f);
+        // The step is a float32 subnormal for bf16/e8m15, and multiplying by it takes a
+        // microcode assist, so the product is only formed when a lane needs it
+        if (!_mm256_testz_si256(small, mag)) {
+            __m256i sub = _mm256_castps_si256(_mm256_mul_ps(_mm256_cvtepi32_ps(mag), step));
+            f = _mm256_blendv_epi8(f, sub, small);
+        }
+        if constexpr (F::has_inf) {
+            f = _mm256_blendv_epi8(f, inf, _mm256_cmpeq_epi32(mag, inf_code));
+            f = _mm256_blendv_epi8(f, nan, _mm256_cmpgt_epi32(mag, inf_code));
+        } else if constexpr (F::has_nan) {
+            f = _mm256_blendv_epi8(f, nan, _mm256_cmpeq_epi32(mag, nan_code));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_or_si256(f, sign));
+    }
+    minifloat_decode_scalar<F>(in + i, out + i, n - i, L);
+}
+#endif
+
+inline bool minifloat_use_avx2() { return detect_simd() >= SimdLevel::AVX2; }
+
+} // namespace detail
+
+// This is to convert n floats to format F with the given exponent bias and overflow/NaN policy
+template <typename F>
+void float_to_minifloat(const float *in, typename F::Storage *out, size_t n, int bias = F::default_bias,
+                        MinifloatPolicy policy = {}) {
+    const detail::MinifloatLayout L = detail::minifloat_layout<F>(bias, policy);
+#if LOSSY_X86
+    if (detail::minifloat_use_avx2()) return detail::minifloat_encode_avx2<F>(in, out, n, L);
+#endif
+    detail::minifloat_encode_scalar<F>(in, out, n, L);
+}
+
+// This is to convert n values of format F (stored with `bias`) back to float
+template <typename F>
+void minifloat_to_float(const typename F::Storage *in, float *out, size_t n, int bias = F::default_bias) {
+    const detail::MinifloatLayout L = detail::minifloat_layout<F>(bias, {});
+#if LOSSY_X86
+    if (detail::minifloat_use_avx2()) return detail::minifloat_decode_avx2<F>(in, out, n, L);
+#endif
+    detail::minifloat_decode_scalar<F>(in, out, n, L);
+}
+
+// Largest finite value of F with this bias
+template <typename F>
+float minifloat_max(int bias = F::default_bias) {
+    return detail::minifloat_decode_one<F>(F::max_code, detail::minifloat_layout<F>(bias, {}));
+}
+
+// Smallest positive (subnormal) value of F with this bias
+template <typename F>
+float minifloat_min(int bias = F::default_bias) {
+    return std::ldexp(1.0f, 1 - bias - F::mantissa_bits);
+}
+
+// This is to pick the largest bias (finest small values) whose range still reaches max_abs
+template <typename F>
+int choose_bias(double max_abs) {
+    for (int bias = F::max_bias; bias > F::min_bias; bias--)
+        if (double(minifloat_max<F>(bias)) >= max_abs) return bias;
+    return F::min_bias;
+}
+
+// This is to get the bytes pack_codes() writes for n codes
+template <typename F>
+size_t packed_code_bytes(size_t n) {
+    return F::bits % 8 == 0 ? n * F::bytes : packed_bytes(n, F::bits);
+}
+
+// This is to store codes in F::bytes bytes each (little-endian), e.g. 3 for E8M15; codes that are not a
+// whole number of bytes wide (e.g. E3M2) are bit-packed densely instead
+template <typename F>
+void pack_codes(const typename F::Storage *codes, size_t n, unsigned char *out) {
+    if constexpr (F::bits % 8 != 0) {
+        // 1024 codes always fill whole bytes, so the blocks pack back to back
+        uint32_t words[1024];
+        for (size_t first = 0; first < n; first += 1024) {
+            size_t count = std::min<size_t>(1024, n - first);
+            std::copy(codes + first, codes + first + count, words);
+            pack_fields(words, count, (1u << F::bits) - 1u, out + packed_bytes(first, F::bits));
+        }
+    } else if constexpr (sizeof(typename F::Storage) == F::bytes) {
+        std::memcpy(out, codes, n * F::bytes);
+    } else {
+        for (size_t i = 0; i < n; i++) std::memcpy(out + i * F::bytes, &codes[i], F::bytes);
+    }
+}
+
+// This is to read codes written by pack_codes(); `in` holds packed_code_bytes<F>(n) bytes
+template <typename F>
+void unpack_codes(const unsigned char *in, size_t n, typename F::Storage *codes) {
+    using Storage = typename F::Storage;
+    if constexpr (F::bits % 8 != 0) {
+        uint32_t words[1024];
+        for (size_t first = 0; first < n; first += 1024) {
+            size_t count = std::min<size_t>(1024, n - first);
+            unpack_fields(in + packed_bytes(first, F::bits), packed_bytes(count, F::bits), count,
+                          (1u << F::bits) - 1u, words);
+            for (size_t i = 0; i < count; i++) codes[first + i] = Storage(words[i]);
+        }
+    } else if constexpr (sizeof(Storage) == F::bytes) {
+        std::memcpy(codes, in, n * F::bytes);
+    } else {
+        // A full word is loaded and masked; only the last code is read byte by byte
+        const Storage keep = Storage((uint64_t(1) << (8 * F::bytes)) - 1);
+        size_t i = 0;
+        for (; i + 1 < n; i++) {
+            Storage c;
+            std::memcpy(&c, in + i * F::bytes, sizeof c);
+            codes[i] = c & keep;
+        }
+        for (; i < n; i++) {
+            Storage c = 0;
+            std::memcpy(&c, in + i * F::bytes, F::bytes);
+            codes[i] = c;
+        }
+    }
+}
+
+inline const char *precision_name(Precision precision) {
+    switch (precision) {
+    case Precision::Float16: return "float16";
+    case Precision::BFloat16: return "bfloat16";
+    case Precision::E4M3: return "e4m3";
+    case Precision::E5M2: return "e5m2";
+    case Precision::E8M15: return "e8m15";
+    default: return "float32";
+    }
+}
+
+// This is to parse f32, f16, bf16, e4m3, e5m2 or e8m15
+inline Precision parse_precision(const std::string &name) {
+    if (name == "f32" || name == "float32") return Precision::Float32;
+    if (name == "f16" || name == "float16") return Precision::Float16;
+    if (name == "bf16" || name == "bfloat16") return Precision::BFloat16;
+    if (name == "e4m3") return Precision::E4M3;
+    if (name == "e5m2") return Precision::E5M2;
+    if (name == "e8m15") return Precision::E8M15;
+    throw std::runtime_error("unknown precision: " + name);
+}
+
+// This is to call fn(F{}) for the minifloat type of a stored precision; false for float32/float16
+template <typename Fn>
+bool with_minifloat(Precision precision, Fn &&fn) {
+    switch (precision) {
+    case Precision::BFloat16: fn(BFloat16{}); return true;
+    case Precision::E4M3: fn(E4M3{}); return true;
+    case Precision::E5M2: fn(E5M2{}); return true;
+    case Precision::E8M15: fn(E8M15{}); return true;
+    default: return false;
+    }
+}
+
+// Bytes per stored value
+inline size_t precision_bytes(Precision precision) {
+    if (precision == Precision::Float32) return sizeof(float);
+    if (precision == Precision::Float16) return sizeof(uint16_t);
+    size_t bytes = 0;
+    with_minifloat(precision, [&](auto f) { bytes = decltype(f)::bytes; });
+    return bytes;
+}
+
+// Mantissa bits kept by a stored precision
+inline int precision_mantissa_bits(Precision precision) {
+    if (precision == Precision::Float32) return 23;
+    if (precision == Precision::Float16) return 10;
+    int bits = 0;
+    with_minifloat(precision, [&](auto f) { bits = decltype(f)::mantissa_bits; });
+    return bits;
+}
+
+// Largest finite value of a stored precision (float32: FLT_MAX)
+inline float precision_max(Precision precision) {
+    if (precision == Precision::Float32) return std::numeric_limits<float>::max();
+    if (precision == Precision::Float16) return 65504.0f;
+    float max = 0.0f;
+    with_minifloat(precision, [&](auto f) { max = minifloat_max<decltype(f)>(); });
+    return max;
+}
+
+// This is to store n floats at a precision (precision_bytes() each), default bias, saturating
+inline void encode_precision(Precision precision, const float *in, unsigned char *out, size_t n) {
+    if (precision == Precision::Float32) return void(std::memcpy(out, in, n * sizeof(float)));
+    if (precision == Precision::Float16) return float_to_half(in, reinterpret_cast<uint16_t *>(out), n);
+    ScopedStage stage("convert", n, n * sizeof(float), n * precision_bytes(precision));
+    if (!with_minifloat(precision, [&](auto f) {
+            using F = decltype(f);
+            typename F::Storage codes[4096];
+            for (size_t first = 0; first < n; first += 4096) {
+                size_t count = std::min<size_t>(4096, n - first);
+                float_to_minifloat<F>(in + first, codes, count);
+                pack_codes<F>(codes, count, out + packed_code_bytes<F>(first));
+            }
+        }))
+        throw std::runtime_error("unsupported precision");
+}
+
+// This is to read n values stored at a precision back as float
+inline void decode_precision(Precision precision, const unsigned char *in, float *out, size_t n) {
+    if (precision == Precision::Float32) return void(std::memcpy(out, in, n * sizeof(float)));
+    if (precision == Precision::Float16) {
+        std::vector<uint16_t> halves(n);
+        std::memcpy(halves.data(), in, n * sizeof(uint16_t));
+        return half_to_float(halves.data(), out, n);
+    }
+    ScopedStage stage("convert", n, n * precision_bytes(precision), n * sizeof(float));
+    if (!with_minifloat(precision, [&](auto f) {
+            using F = decltype(f);
+            typename F::Storage codes[4096];
+            for (size_t first = 0; first < n; first += 4096) {
+                size_t count = std::min<size_t>(4096, n - first);
+                unpack_codes<F>(in + packed_code_bytes<F>(first), count, codes);
+                minifloat_to_float<F>(codes, out + first, count);
+            }
+        }))
+        throw std::runtime_error("unsupported precision");
+}
+
+} // namespace lossy
@@ -0,0 +1,129 @@
+#pragma once
+
+// Multi-objective selection over measured sweep rows (results.h).
+//
+// pareto_front() keeps the rows that no other row beats on every objective
+// (higher ratio, lower error, faster encode/decode): any row off the front
+// gives something up for nothing. best_for() answers constrained queries
+// such as "smallest output with MSE < 1e-8 and encode > 2000 MB/s", so the
+// choice of a codec setting follows from measurements instead of a fixed
+// savings / MSE score.
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "results.h"
+
+namespace lossy {
+
+enum class Objective { Ratio, MSE, MAE, MaxError, EncodeSpeed, DecodeSpeed };
+
+inline const char *objective_name(Objective objective) {
+    switch (objective) {
+    case Objective::Ratio: return "ratio";
+    case Objective::MSE: return "mse";
+    case Objective::MAE: return "mae";
+    case Objective::MaxError: return "max_abs_error";
+    case Objective::EncodeSpeed: return "encode_mbps";
+    default: return "decode_mbps";
+    }
+}
+
+// This is to read an objective so that larger is always better (errors are negated)
+inline double objective_score(const SweepResult &r, Objective objective) {
+    switch (objective) {
+    case Objective::Ratio: return r.ratio;
+    case Objective::MSE: return -r.mse;
+    case Objective::MAE: return -r.mae;
+    case Objective::MaxError: return -r.max_abs_error;
+    case Objective::EncodeSpeed: return r.encode_mbps;
+    default: return r.decode_mbps;
+    }
+}
+
+inline std::vector<Objective> default_objectives() {
+    return {Objective::Ratio, Objective::MSE, Objective::EncodeSpeed, Objective::DecodeSpeed};
+}
+
+// This is to check whether a is at least as good as b everywhere and better somewhere
+inline bool dominates(const SweepResult &a, const SweepResult &b, const std::vector<Objective> &objectives) {
+    bool better = false;
+    for (Objective o : objectives) {
+        double sa = objective_score(a, o), sb = objective_score(b, o);
+        if (sa < sb) return false;
+        if (sa > sb) better = true;
+    }
+    return better;
+}
+
+// This is to get the indices of the non-dominated rows, sorted by the first objective (worst first)
+inline std::vector<size_t> pareto_front(const std::vector<SweepResult> &rows,
+                                        const std::vector<Objective> &objectives = default_objectives()) {
+    std::vector<size_t> front;
+    for (size_t i = 0; i < rows.size(); i++) {
+        bool dominated = false;
+        for (size_t j = 0; j < rows.size() && !dominated; j++) dominated = j != i && dominates(rows[j], rows[i], objectives);
+        if (!dominated) front.push_back(i);
+    }
+    if (!objectives.empty()) {
+        std::stable_sort(front.begin(), front.end(), [&](size_t a, size_t b) {
+            return objective_score(rows[a], objectives[0]) < objective_score(rows[b], objectives[0]);
+        });
+    }
+    return front;
+}
+
+// Limits a row must meet to be selected; the defaults accept everything
+// Error limits are strict (max_mse = 1e-8 means MSE < 1e-8); the ratio and speed limits are
+// inclusive, so rows without a measured speed (0, e.g. from rate_distortion) pass the defaults
+struct Constraints {
+    std::string distribution;  // empty = any
+    size_t threads = 0;        // 0 = any
+    double max_mse = std::numeric_limits<double>::infinity();
+    double max_mae = std::numeric_limits<double>::infinity();
+    double max_abs_error = std::numeric_limits<double>::infinity();
+    double min_ratio = 0.0;
+    double min_encode_mbps = 0.0;
+    double min_decode_mbps = 0.0;
+};
+
+inline bool satisfies(const SweepResult &r, const Constraints &c) {
+    // An unset (infinite) limit also passes rows whose error is infinite
+    auto below = [](double value, double limit) {
+        return limit == std::numeric_limits<double>::infinity() || value < limit;
+    };
+    return (c.distribution.empty() || r.distribution == c.distribution) && (c.threads == 0 || r.threads == c.threads) &&
+           below(r.mse, c.max_mse) && below(r.mae, c.max_mae) && below(r.max_abs_error, c.max_abs_error) &&
+           r.ratio >= c.min_ratio &&
+           r.encode_mbps >= c.min_encode_mbps && r.decode_mbps >= c.min_decode_mbps;
+}
+
+// This is to keep only the rows that meet the constraints
+inline std::vector<SweepResult> filter_rows(const std::vector<SweepResult> &rows, const Constraints &c) {
+    std::vector<SweepResult> out;
+    for (const SweepResult &r : rows)
+        if (satisfies(r, c)) out.push_back(r);
+    return out;
+}
+
+// This is to pick the row that maximises `goal` under the constraints (ties: lower MSE, then faster encode)
+inline std::optional<size_t> best_for(const std::vector<SweepResult> &rows, const Constraints &c,
+                                      Objective goal = Objective::Ratio) {
+    std::optional<size_t> best;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (!satisfies(rows[i], c)) continue;
+        if (!best) {
+            best = i;
+            continue;
+        }
+        const SweepResult &r = rows[i], &b = rows[*best];
+        double sr = objective_score(r, goal), sb = objective_score(b, goal);
+        if (sr > sb || (sr == sb && (r.mse < b.mse || (r.mse == b.mse && r.encode_mbps > b.encode_mbps)))) best = i;
+    }
+    return best;
+}
+
+} // namespace lossy
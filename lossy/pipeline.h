@@ -0,0 +1,78 @@
+#pragma once
+
+// Chunk-parallel compression pipeline: mask -> shuffle -> deflate runs for
+// independent chunks on a ThreadPool, and the encoded chunks are written in
+// order by the calling thread. Chunks are encoded independently, so the
+// output file is byte-identical for any thread count.
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <stdexcept>
+
+#include "container.h"
+#include "thread_pool.h"
+
+namespace lossy {
+
+struct PipelineStats {
+    size_t chunks = 0;
+    size_t raw_bytes = 0;
+    size_t written_bytes = 0;
+    double seconds = 0.0;
+    double mbps() const { return seconds > 0 ? raw_bytes / 1e6 / seconds : 0.0; }
+};
+
+// This is to encode data on the pool and append it to writer in chunk order.
+// At most `window` chunks are in flight (0 = four per thread), which bounds memory.
+inline PipelineStats write_parallel(ContainerWriter &writer, const float *data, size_t n, ThreadPool &pool,
+                                    size_t window = 0) {
+    using Clock = std::chrono::steady_clock;
+    if (writer.has_pending()) throw std::runtime_error("write_parallel needs a writer without buffered values");
+    const ContainerOptions &opt = writer.options();
+    const size_t chunk = opt.chunk_elements;
+    const size_t chunks = (n + chunk - 1) / chunk;
+    const uint64_t base = writer.elements_written();
+    if (window == 0) window = 4 * pool.size();
+
+    PipelineStats stats;
+    stats.chunks = chunks;
+    stats.raw_bytes = n * sizeof(float);
+    uint64_t start_bytes = writer.bytes_written();
+    auto t0 = Clock::now();
+
+    std::deque<std::future<EncodedChunk>> in_flight;
+    size_t submitted = 0;
+    auto submit_next = [&] {
+        size_t first = submitted * chunk;
+        size_t count = std::min(chunk, n - first);
+        in_flight.push_back(pool.submit_future([data, first, count, base, &opt] {
+            return encode_chunk(data + first, count, base + first, opt);
+        }));
+        submitted++;
+    };
+    try {
+        for (size_t written = 0; written < chunks; written++) {
+            while (submitted < chunks && in_flight.size() < window) submit_next();
+            // Out of the deque first, so the catch below only sees futures not yet consumed
+            std::future<EncodedChunk> front = std::move(in_flight.front());
+            in_flight.pop_front();
+            writer.write_encoded(front.get());
+        }
+    } catch (...) {
+        // Let running tasks finish before the data they point at goes away
+        for (auto &f : in_flight)
+            if (f.valid()) f.wait();
+        throw;
+    }
+
+    stats.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    stats.written_bytes = size_t(writer.bytes_written() - start_bytes);
+    return stats;
+}
+
+inline PipelineStats write_parallel(ContainerWriter &writer, const std::vector<float> &data, ThreadPool &pool) {
+    return write_parallel(writer, data.data(), data.size(), pool);
+}
+
+} // namespace lossy
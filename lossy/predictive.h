@@ -0,0 +1,349 @@
+#pragma once
+
+// Error-bounded predictive coder for 1D/2D/3D float grids (Lorenzo predictor).
+//
+// Mantissa masking treats every value on its own. Spatially correlated grids
+// (calorimeter maps, field maps) are far better coded as "prediction +
+// small residual". This follows the dual-quantization form of SZ/cuSZ:
+//
+//   1. prequantize: q = round(x / (2 * max_abs)), so |x - q * 2 * max_abs| <= max_abs;
+//   2. predict on the integers with a Lorenzo stencil (the residual is a first
+//      difference along x, y, z); the rank with the smallest residuals is kept;
+//   3. zigzag the residuals, byte-shuffle them and gzip (deflate.h).
+//
+// Because the predictor runs on already quantized integers there is no
+// feedback from the reconstruction, so every step is a flat loop over rows
+// or planes: AVX2 kernels do the quantization, the differences along y/z and
+// their prefix sums on decode. Integer arithmetic wraps mod 2^32, which the
+// decoder undoes exactly. Values that cannot meet the bound after
+// quantization (Inf, NaN, |x| beyond 2^30 steps, float rounding at the edge
+// of the bound) are stored raw as outliers and predicted from their left
+// neighbour, so the bound holds for every element.
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "deflate.h"
+#include "shuffle.h"
+
+namespace lossy {
+
+// Grid extents, x fastest; unused trailing dimensions are 1
+struct GridShape {
+    size_t nx = 1, ny = 1, nz = 1;
+    size_t size() const { return nx * ny * nz; }
+    int rank() const { return nz > 1 ? 3 : ny > 1 ? 2 : 1; }
+};
+
+// This is to parse "nx", "nxxny" or "nxxnyxnz" (e.g. 256x256x64)
+inline GridShape parse_shape(const std::string &text) {
+    size_t dims[3] = {1, 1, 1};
+    size_t count = 0, pos = 0;
+    while (pos <= text.size()) {
+        size_t end = text.find('x', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string part = text.substr(pos, end - pos);
+        if (count == 3 || part.empty() || part.find_first_not_of("0123456789") != std::string::npos)
+            throw std::runtime_error("bad grid shape: " + text);
+        dims[count++] = std::stoull(part);
+        pos = end + 1;
+    }
+    if (dims[0] == 0 || dims[1] == 0 || dims[2] == 0) throw std::runtime_error("bad grid shape: " + text);
+    return GridShape{dims[0], dims[1], dims[2]};
+}
+
+inline std::string shape_name(const GridShape &shape) {
+    std::string name = std::to_string(shape.nx);
+    if (shape.rank() > 1) name += "x" + std::to_string(shape.ny);
+    if (shape.rank() > 2) name += "x" + std::to_string(shape.nz);
+    return name;
+}
+
+namespace detail {
+
+// Fixed-size prefix of every predictive payload, followed by the gzip stream and the outliers
+struct PredictiveHeader {
+    uint64_t nx, ny, nz;
+    uint64_t rank; // predictor rank actually used, 1 .. rank of the shape
+    double max_abs;
+    uint64_t outliers;     // (uint64 index, float32 bits) pairs after the stream
+    uint64_t stream_bytes; // gzip of the byte-shuffled zigzag residuals
+};
+
+// Quantized values stay well inside int32 so residual sums never reach the wrap
+constexpr double kMaxQuantum = double(1 << 30);
+
+inline bool quantize_one(float x, double inv_step, double step, double max_abs, int32_t &q) {
+    double r = std::nearbyint(double(x) * inv_step);
+    if (!(std::fabs(r) <= kMaxQuantum)) return false;
+    if (!(std::fabs(double(x) - double(float(r * step))) <= max_abs)) return false;
+    q = int32_t(r);
+    return true;
+}
+
+// Writes q for every element and appends the indices that must be stored raw (their q is left at 0)
+inline void quantize_scalar(const float *in, int32_t *q, size_t begin, size_t end, double step, double max_abs,
+                            std::vector<uint64_t> &outliers) {
+    const double inv_step = 1.0 / step;
+    for (size_t i = begin; i < end; i++) {
+        q[i] = 0;
+        if (!quantize_one(in[i], inv_step, step, max_abs, q[i])) outliers.push_back(i);
+    }
+}
+
+inline void dequantize_scalar(const int32_t *q, float *out, size_t begin, size_t end, double step) {
+    for (size_t i = begin; i < end; i++) out[i] = float(double(q[i]) * step);
+}
+
+// a[i] -= a[i - d] for i = end-1 .. d (backwards, so every read sees the original value)
+inline void difference_scalar(uint32_t *a, size_t d, size_t end) {
+    for (size_t i = end; i-- > d;) a[i] -= a[i - d];
+}
+
+// a[i] += a[i - d] for i = d .. n-1
+inline void prefix_scalar(uint32_t *a, size_t n, size_t d, size_t begin) {
+    for (size_t i = std::max(begin, d); i < n; i++) a[i] += a[i - d];
+}
+
+#if LOSSY_X86
+__attribute__((target("avx2")))
+inline void quantize_avx2(const float *in, int32_t *q, size_t n, double step, double max_abs,
+                          std::vector<uint64_t> &outliers) {
+    const __m256d inv = _mm256_set1_pd(1.0 / step);
+    const __m256d st = _mm256_set1_pd(step);
+    const __m256d bound = _mm256_set1_pd(max_abs);
+    const __m256d limit = _mm256_set1_pd(kMaxQuantum);
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(in + i));
+        __m256d r = _mm256_round_pd(_mm256_mul_pd(x, inv), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d rec = _mm256_cvtps_pd(_mm256_cvtpd_ps(_mm256_mul_pd(r, st)));
+        // Ordered compares: NaN and Inf fail both tests
+        __m256d ok = _mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, r), limit, _CMP_LE_OQ),
+                                   _mm256_cmp_pd(_mm256_andnot_pd(sign, _mm256_sub_pd(x, rec)), bound, _CMP_LE_OQ));
+        r = _mm256_and_pd(r, ok);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(q + i), _mm256_cvtpd_epi32(r));
+        int good = _mm256_movemask_pd(ok);
+        if (good != 0xF) {
+            for (int l = 0; l < 4; l++)
+                if (!((good >> l) & 1)) outliers.push_back(i + size_t(l));
+        }
+    }
+    quantize_scalar(in, q, i, n, step, max_abs, outliers);
+}
+
+__attribute__((target("avx2")))
+inline void dequantize_avx2(const int32_t *q, float *out, size_t n, double step) {
+    const __m256d st = _mm256_set1_pd(step);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d r = _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(q + i)));
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(_mm256_mul_pd(r, st)));
+    }
+    dequantize_scalar(q, out, i, n, step);
+}
+
+__attribute__((target("avx2")))
+inline void difference_avx2(uint32_t *a, size_t n, size_t d) {
+    size_t i = n;
+    while (i >= d + 8) {
+        i -= 8;
+        __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i - d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(a + i), _mm256_sub_epi32(cur, prev));
+    }
+    difference_scalar(a, d, i);
+}
+
+// Only for d >= 8: then the 8 lanes of a step never depend on each other
+__attribute__((target("avx2")))
+inline void prefix_avx2(uint32_t *a, size_t n, size_t d) {
+    size_t i = d;
+    for (; i + 8 <= n; i += 8) {
+        __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i - d));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(a + i), _mm256_add_epi32(cur, prev));
+    }
+    prefix_scalar(a, n, d, i);
+}
+#endif
+
+inline bool predictive_use_avx2() { return detect_simd() >= SimdLevel::AVX2; }
+
+inline void quantize(const float *in, int32_t *q, size_t n, double step, double max_abs,
+                     std::vector<uint64_t> &outliers) {
+#if LOSSY_X86
+    if (predictive_use_avx2()) return quantize_avx2(in, q, n, step, max_abs, outliers);
+#endif
+    quantize_scalar(in, q, 0, n, step, max_abs, outliers);
+}
+
+inline void dequantize(const int32_t *q, float *out, size_t n, double step) {
+#if LOSSY_X86
+    if (predictive_use_avx2()) return dequantize_avx2(q, out, n, step);
+#endif
+    dequantize_scalar(q, out, 0, n, step);
+}
+
+inline void difference(uint32_t *a, size_t n, size_t d) {
+#if LOSSY_X86
+    if (predictive_use_avx2()) return difference_avx2(a, n, d);
+#endif
+    difference_scalar(a, d, n);
+}
+
+inline void prefix(uint32_t *a, size_t n, size_t d) {
+#if LOSSY_X86
+    if (d >= 8 && predictive_use_avx2()) return prefix_avx2(a, n, d);
+#endif
+    prefix_scalar(a, n, d, d);
+}
+
+// The Lorenzo residual of rank k is the first difference along each of the first k axes, in any order
+inline void lorenzo_forward(uint32_t *q, const GridShape &shape, int rank) {
+    const size_t row = shape.nx, plane = shape.nx * shape.ny, n = shape.size();
+    for (size_t r = 0; r < n; r += row) difference(q + r, row, 1);
+    if (rank > 1)
+        for (size_t p = 0; p < n; p += plane) difference(q + p, plane, row);
+    if (rank > 2) difference(q, n, plane);
+}
+
+inline void lorenzo_inverse(uint32_t *q, const GridShape &shape, int rank) {
+    const size_t row = shape.nx, plane = shape.nx * shape.ny, n = shape.size();
+    if (rank > 2) prefix(q, n, plane);
+    if (rank > 1)
+        for (size_t p = 0; p < n; p += plane) prefix(q + p, plane, row);
+    for (size_t r = 0; r < n; r += row) prefix(q + r, row, 1);
+}
+
+// This is to zigzag residuals in place; returns the sum of their bit widths, a cheap stand-in for the coded size
+inline uint64_t zigzag(uint32_t *r, size_t n) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t z = (r[i] << 1) ^ uint32_t(int32_t(r[i]) >> 31);
+        r[i] = z;
+        bits += z ? uint64_t(32 - __builtin_clz(z)) : 0;
+    }
+    return bits;
+}
+
+} // namespace detail
+
+// This is to code a grid so that every value is reconstructed within max_abs (> 0)
+inline std::vector<unsigned char> predictive_encode(const float *data, const GridShape &shape, double max_abs,
+                                                    int level = kGzipDefaultLevel) {
+    if (!(max_abs > 0.0) || !std::isfinite(max_abs)) throw std::runtime_error("predictive coder needs max_abs > 0");
+    const size_t n = shape.size();
+    const double step = 2.0 * max_abs;
+
+    std::vector<uint32_t> q(n);
+    std::vector<uint64_t> outliers;
+    detail::quantize(data, reinterpret_cast<int32_t *>(q.data()), n, step, max_abs, outliers);
+    // An outlier takes its left neighbour's quantum, so it does not break the prediction around it
+    for (uint64_t i : outliers) q[i] = i > 0 ? q[i - 1] : 0;
+
+    // The full-rank stencil adds up 2^rank quantization errors, so on coarse bounds a lower
+    // rank can predict better; every rank up to the shape's is tried and the smallest kept
+    int best_rank = shape.rank();
+    std::vector<uint32_t> best, residual;
+    uint64_t best_bits = ~uint64_t(0);
+    for (int rank = shape.rank(); rank >= 1; rank--) {
+        residual = q;
+        detail::lorenzo_forward(residual.data(), shape, rank);
+        uint64_t bits = detail::zigzag(residual.data(), n);
+        if (bits < best_bits) {
+            best_bits = bits;
+            best_rank = rank;
+            best.swap(residual);
+        }
+    }
+    std::vector<unsigned char> shuffled(n * sizeof(uint32_t));
+    byte_shuffle4(best.data(), shuffled.data(), n);
+    std::vector<unsigned char> stream = gzip_compress(shuffled.data(), shuffled.size(), level);
+
+    detail::PredictiveHeader header{shape.nx,    shape.ny,        shape.nz,     uint64_t(best_rank),
+                                    max_abs,     outliers.size(), stream.size()};
+    const size_t outlier_bytes = outliers.size() * (sizeof(uint64_t) + sizeof(uint32_t));
+    std::vector<unsigned char> out(sizeof header + stream.size() + outlier_bytes);
+    unsigned char *p = out.data();
+    std::memcpy(p, &header, sizeof header);
+    p += sizeof header;
+    std::memcpy(p, stream.data(), stream.size());
+    p += stream.size();
+    for (uint64_t i : outliers) {
+        uint32_t bits = float_bits(data[i]);
+        std::memcpy(p, &i, sizeof i);
+        std::memcpy(p + sizeof i, &bits, sizeof bits);
+        p += sizeof i + sizeof bits;
+    }
+    return out;
+}
+
+inline std::vector<unsigned char> predictive_encode(const std::vector<float> &data, const GridShape &shape,
+                                                    double max_abs, int level = kGzipDefaultLevel) {
+    if (shape.size() != data.size()) throw std::runtime_error("grid shape does not match the data size");
+    return predictive_encode(data.data(), shape, max_abs, level);
+}
+
+// This is to read the grid shape stored in a payload
+inline GridShape predictive_shape(const unsigned char *payload, size_t bytes) {
+    detail::PredictiveHeader header;
+    if (bytes < sizeof header) throw std::runtime_error("predictive payload truncated");
+    std::memcpy(&header, payload, sizeof header);
+    return GridShape{size_t(header.nx), size_t(header.ny), size_t(header.nz)};
+}
+
+// This is to read which predictor rank the encoder chose
+inline int predictive_rank(const unsigned char *payload, size_t bytes) {
+    detail::PredictiveHeader header;
+    if (bytes < sizeof header) throw std::runtime_error("predictive payload truncated");
+    std::memcpy(&header, payload, sizeof header);
+    return int(header.rank);
+}
+
+// This is to decode a payload into n = shape.size() floats
+inline void predictive_decode(const unsigned char *payload, size_t bytes, float *out, size_t n) {
+    detail::PredictiveHeader header;
+    if (bytes < sizeof header) throw std::runtime_error("predictive payload truncated");
+    std::memcpy(&header, payload, sizeof header);
+    const GridShape shape{size_t(header.nx), size_t(header.ny), size_t(header.nz)};
+    if (header.rank < 1 || header.rank > uint64_t(shape.rank())) throw std::runtime_error("bad predictive header");
+    if (shape.size() != n) throw std::runtime_error("predictive payload holds a different number of values");
+    const size_t outlier_bytes = header.outliers * (sizeof(uint64_t) + sizeof(uint32_t));
+    if (bytes - sizeof header < header.stream_bytes || bytes - sizeof header - header.stream_bytes < outlier_bytes)
+        throw std::runtime_error("predictive payload truncated");
+    const unsigned char *stream = payload + sizeof header;
+
+    std::vector<unsigned char> shuffled(n * sizeof(uint32_t));
+    if (gzip_decompress(stream, header.stream_bytes, shuffled.data(), shuffled.size()) != shuffled.size())
+        throw std::runtime_error("predictive payload truncated");
+    std::vector<uint32_t> q(n);
+    byte_unshuffle4(shuffled.data(), q.data(), n);
+    for (uint32_t &z : q) z = (z >> 1) ^ (0u - (z & 1u));
+    detail::lorenzo_inverse(q.data(), shape, int(header.rank));
+    detail::dequantize(reinterpret_cast<const int32_t *>(q.data()), out, n, 2.0 * header.max_abs);
+
+    const unsigned char *p = stream + header.stream_bytes;
+    for (uint64_t k = 0; k < header.outliers; k++) {
+        uint64_t i;
+        uint32_t bits;
+        std::memcpy(&i, p, sizeof i);
+        std::memcpy(&bits, p + sizeof i, sizeof bits);
+        p += sizeof i + sizeof bits;
+        if (i >= n) throw std::runtime_error("predictive outlier index out of range");
+        out[i] = bits_float(bits);
+    }
+}
+
+inline std::vector<float> predictive_decode(const std::vector<unsigned char> &payload) {
+    std::vector<float> out(predictive_shape(payload.data(), payload.size()).size());
+    predictive_decode(payload.data(), payload.size(), out.data(), out.size());
+    return out;
+}
+
+} // namespace lossy
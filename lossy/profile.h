@@ -0,0 +1,399 @@
+#pragma once
+
+// Per-stage instrumentation of the hot paths.
+//
+// A ScopedStage times one call of a stage (generate, truncate, convert,
+// compress, decompress, write, metrics) and records the elements and bytes
+// it moved. When the profiler is enabled it also reads the CPU cycles,
+// instructions, cache misses and branch misses of the calling thread through
+// Linux perf_event_open(). Each counter is opened separately, so a machine
+// without a PMU (most VMs) or a perf_event_paranoid setting that forbids it
+// simply reports no value, and cycles fall back to TSC reference cycles.
+//
+// Profiling is off by default and then costs one relaxed atomic load per
+// stage. The environment variable LOSSY_PROFILE turns it on for any binary:
+//
+//   LOSSY_PROFILE=1          print the stage table to stderr at exit
+//   LOSSY_PROFILE=<prefix>   also write <prefix>.csv and <prefix>.json
+//
+// The table gives per-stage input/output GB/s, cycles per element and the
+// achieved memory traffic as a fraction of a measured copy bandwidth (the
+// roofline a streaming stage cannot beat), so the stage that limits a
+// pipeline stands out; above 100% the stage worked from cache.
+//
+// Stage times are summed over the threads that ran the stage, and counters
+// are those of the thread that ran it: a stage called from pool workers
+// reports per-thread throughput, and a pool-parallel call timed on the
+// caller counts only the caller's share of the cycles. Stages nest; an
+// outer stage includes the time of the ones it calls.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+
+namespace lossy {
+
+enum class Counter { Cycles, Instructions, CacheMisses, BranchMisses };
+constexpr int kCounterCount = 4;
+
+inline const char *counter_name(Counter c) {
+    switch (c) {
+    case Counter::Cycles: return "cycles";
+    case Counter::Instructions: return "instructions";
+    case Counter::CacheMisses: return "cache_misses";
+    default: return "branch_misses";
+    }
+}
+
+namespace detail {
+
+inline uint64_t read_tsc() {
+#if LOSSY_X86
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// The hardware counters of one thread, user space only
+class ThreadCounters {
+public:
+    ThreadCounters() {
+        for (int c = 0; c < kCounterCount; c++) fd_[c] = open_counter(Counter(c));
+    }
+
+    ~ThreadCounters() {
+#if defined(__linux__)
+        for (int fd : fd_)
+            if (fd >= 0) close(fd);
+#endif
+    }
+
+    ThreadCounters(const ThreadCounters &) = delete;
+    ThreadCounters &operator=(const ThreadCounters &) = delete;
+
+    // This is to read every counter; returns the mask of the ones that could be read
+    unsigned read(uint64_t values[kCounterCount]) const {
+        unsigned mask = 0;
+        for (int c = 0; c < kCounterCount; c++) {
+            values[c] = 0;
+#if defined(__linux__)
+            if (fd_[c] >= 0 && ::read(fd_[c], &values[c], sizeof values[c]) == ssize_t(sizeof values[c]))
+                mask |= 1u << c;
+#endif
+        }
+        return mask;
+    }
+
+private:
+    // This is to count one event of the calling thread; returns -1 if the kernel or the CPU cannot
+    static int open_counter(Counter c) {
+#if defined(__linux__)
+        static const uint64_t configs[kCounterCount] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[int(c)];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)c;
+        return -1;
+#endif
+    }
+
+    int fd_[kCounterCount];
+};
+
+inline const ThreadCounters &thread_counters() {
+    thread_local ThreadCounters counters;
+    return counters;
+}
+
+} // namespace detail
+
+// Accumulated calls of one stage
+struct StageTotals {
+    std::string name;
+    uint64_t calls = 0;
+    double seconds = 0.0;
+    uint64_t elements = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t tsc = 0;                       // reference cycles
+    uint64_t counters[kCounterCount] = {};
+    unsigned counted = ~0u;                 // counters read on every call
+
+    bool has(Counter c) const { return calls > 0 && (counted >> int(c) & 1); }
+    double in_gbps() const { return seconds > 0 ? bytes_in / seconds / 1e9 : 0.0; }
+    double out_gbps() const { return seconds > 0 ? bytes_out / seconds / 1e9 : 0.0; }
+    // Hardware cycles when counted, TSC reference cycles otherwise
+    double cycles_per_element() const {
+        double cycles = has(Counter::Cycles) ? double(counters[int(Counter::Cycles)]) : double(tsc);
+        return elements ? cycles / double(elements) : 0.0;
+    }
+};
+
+// Streaming bandwidth of this machine, the ceiling for a stage that touches each byte once
+struct Roofline {
+    double copy_gbps = 0.0; // bytes read + written per second by memcpy
+    double read_gbps = 0.0; // bytes read per second by a summing loop
+};
+
+// This is to measure the roofline on buffers well beyond the last-level cache (best of `reps`)
+inline Roofline measure_roofline(size_t bytes = size_t(64) << 20, int reps = 3) {
+    using Clock = std::chrono::steady_clock;
+    const size_t words = bytes / sizeof(uint64_t);
+    std::vector<uint64_t> src(words, 1), dst(words, 0);
+    Roofline roof;
+    uint64_t sink = 0;
+    for (int r = 0; r < reps; r++) {
+        auto t0 = Clock::now();
+        std::memcpy(dst.data(), src.data(), words * sizeof(uint64_t));
+        auto t1 = Clock::now();
+        uint64_t sum = 0;
+        for (size_t i = 0; i < words; i++) sum += dst[i];
+        auto t2 = Clock::now();
+        sink += sum;
+        roof.copy_gbps = std::max(roof.copy_gbps, 2.0 * bytes / std::chrono::duration<double>(t1 - t0).count() / 1e9);
+        roof.read_gbps = std::max(roof.read_gbps, bytes / std::chrono::duration<double>(t2 - t1).count() / 1e9);
+    }
+    if (sink != uint64_t(reps) * words) throw std::runtime_error("roofline copy mismatch");
+    return roof;
+}
+
+inline void write_profile_csv(const std::string &filename, const std::vector<StageTotals> &stages,
+                              const Roofline &roof) {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("cannot open " + filename);
+    out.precision(10);
+    out << "stage,calls,seconds,elements,bytes_in,bytes_out,in_gbps,out_gbps,cycles_per_element,roofline_fraction";
+    for (int c = 0; c < kCounterCount; c++) out << ',' << counter_name(Counter(c));
+    out << "\n";
+    for (const StageTotals &s : stages) {
+        out << s.name << ',' << s.calls << ',' << s.seconds << ',' << s.elements << ',' << s.bytes_in << ','
+            << s.bytes_out << ',' << s.in_gbps() << ',' << s.out_gbps() << ',' << s.cycles_per_element() << ','
+            << (s.in_gbps() + s.out_gbps()) / roof.copy_gbps;
+        // Counters the machine could not read are left empty
+        for (int c = 0; c < kCounterCount; c++) {
+            out << ',';
+            if (s.has(Counter(c))) out << s.counters[c];
+        }
+        out << "\n";
+    }
+    if (!out) throw std::runtime_error("write failed: " + filename);
+}
+
+inline void write_profile_json(const std::string &filename, const std::vector<StageTotals> &stages,
+                               const Roofline &roof) {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("cannot open " + filename);
+    out.precision(10);
+    out << "{\n  \"roofline\": {\"copy_gbps\": " << roof.copy_gbps << ", \"read_gbps\": " << roof.read_gbps
+        << "},\n  \"stages\": [\n";
+    for (size_t i = 0; i < stages.size(); i++) {
+        const StageTotals &s = stages[i];
+        out << "    {\"stage\": \"" << s.name << "\", \"calls\": " << s.calls << ", \"seconds\": " << s.seconds
+            << ", \"elements\": " << s.elements << ", \"bytes_in\": " << s.bytes_in << ", \"bytes_out\": "
+            << s.bytes_out << ", \"in_gbps\": " << s.in_gbps() << ", \"out_gbps\": " << s.out_gbps()
+            << ", \"cycles_per_element\": " << s.cycles_per_element() << ", \"roofline_fraction\": "
+            << (s.in_gbps() + s.out_gbps()) / roof.copy_gbps;
+        for (int c = 0; c < kCounterCount; c++) {
+            out << ", \"" << counter_name(Counter(c)) << "\": ";
+            if (s.has(Counter(c))) {
+                out << s.counters[c];
+            } else {
+                out << "null";
+            }
+        }
+        out << "}" << (i + 1 < stages.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    if (!out) throw std::runtime_error("write failed: " + filename);
+}
+
+// Process-wide stage totals; use profiler() rather than constructing one
+class Profiler {
+public:
+    Profiler() {
+        const char *env = std::getenv("LOSSY_PROFILE");
+        if (env && *env && std::string(env) != "0") {
+            enabled_.store(true, std::memory_order_relaxed);
+            report_at_exit_ = true;
+            if (std::string(env) != "1") export_prefix_ = env;
+        }
+    }
+
+    ~Profiler() {
+        if (!report_at_exit_ || stages().empty()) return;
+        try {
+            Roofline roof = measure_roofline();
+            report(std::cerr, roof);
+            if (!export_prefix_.empty()) {
+                write_profile_csv(export_prefix_ + ".csv", stages(), roof);
+                write_profile_json(export_prefix_ + ".json", stages(), roof);
+                std::cerr << "Wrote " << export_prefix_ << ".csv and " << export_prefix_ << ".json\n";
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Profile export failed: " << e.what() << "\n";
+        }
+    }
+
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void enable(bool on = true) { enabled_.store(on, std::memory_order_relaxed); }
+
+    void record(const StageTotals &call) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(stages_.begin(), stages_.end(), [&](const StageTotals &s) { return s.name == call.name; });
+        if (it == stages_.end()) it = stages_.insert(stages_.end(), StageTotals{call.name});
+        it->calls += call.calls;
+        it->seconds += call.seconds;
+        it->elements += call.elements;
+        it->bytes_in += call.bytes_in;
+        it->bytes_out += call.bytes_out;
+        it->tsc += call.tsc;
+        for (int c = 0; c < kCounterCount; c++) it->counters[c] += call.counters[c];
+        it->counted &= call.counted;
+    }
+
+    // Stages in the order they first ran
+    std::vector<StageTotals> stages() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stages_;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stages_.clear();
+    }
+
+    // This is to print the stage table and name the stage with the lowest throughput
+    void report(std::ostream &os, const Roofline &roof) const {
+        std::vector<StageTotals> rows = stages();
+        const std::ios::fmtflags flags = os.flags();
+        const std::streamsize precision = os.precision();
+        os << "\nStage profile (roofline: copy " << std::fixed << std::setprecision(2) << roof.copy_gbps
+           << " GB/s, read " << roof.read_gbps << " GB/s)\n";
+        os << std::left << std::setw(12) << "stage" << std::right << std::setw(7) << "calls" << std::setw(11) << "ms"
+           << std::setw(12) << "elements" << std::setw(9) << "in GB/s" << std::setw(9) << "out GB/s" << std::setw(8)
+           << "% roof" << std::setw(10) << "cyc/elem" << std::setw(7) << "IPC" << std::setw(11) << "LLC miss/k"
+           << std::setw(11) << "br miss/k" << "\n";
+        bool tsc = false;
+        const StageTotals *slowest = nullptr;
+        for (const StageTotals &s : rows) {
+            tsc = tsc || !s.has(Counter::Cycles);
+            double roof_pct = 100.0 * (s.in_gbps() + s.out_gbps()) / roof.copy_gbps;
+            os << std::left << std::setw(12) << s.name << std::right << std::setw(7) << s.calls << std::setw(11)
+               << std::setprecision(2) << s.seconds * 1e3 << std::setw(12) << s.elements << std::setw(9)
+               << s.in_gbps() << std::setw(9) << s.out_gbps() << std::setw(8) << std::setprecision(1) << roof_pct
+               << std::setw(10) << std::setprecision(2) << s.cycles_per_element();
+            // Counters this machine cannot read print as "-"; misses are per thousand elements
+            os << std::setw(7);
+            if (s.has(Counter::Instructions) && s.has(Counter::Cycles) && s.counters[int(Counter::Cycles)]) {
+                os << double(s.counters[int(Counter::Instructions)]) / double(s.counters[int(Counter::Cycles)]);
+            } else {
+                os << "-";
+            }
+            os << std::setw(11);
+            if (s.has(Counter::CacheMisses) && s.elements) {
+                os << 1e3 * double(s.counters[int(Counter::CacheMisses)]) / double(s.elements);
+            } else {
+                os << "-";
+            }
+            os << std::setw(11);
+            if (s.has(Counter::BranchMisses) && s.elements) {
+                os << 1e3 * double(s.counters[int(Counter::BranchMisses)]) / double(s.elements);
+            } else {
+                os << "-";
+            }
+            os << "\n";
+            if (s.bytes_in > 0 && (!slowest || s.in_gbps() < slowest->in_gbps())) slowest = &s;
+        }
+        if (tsc) os << "(cyc/elem in TSC reference cycles where hardware counters are unavailable)\n";
+        if (slowest)
+            os << "Lowest input throughput: " << slowest->name << " at " << std::setprecision(2) << slowest->in_gbps()
+               << " GB/s\n";
+        os.flags(flags);
+        os.precision(precision);
+    }
+
+private:
+    std::atomic<bool> enabled_{false};
+    bool report_at_exit_ = false;
+    std::string export_prefix_;
+    mutable std::mutex mutex_;
+    std::vector<StageTotals> stages_;
+};
+
+inline Profiler &profiler() {
+    static Profiler instance;
+    return instance;
+}
+
+// Times the enclosing scope as one call of a stage; bytes may be set once they are known
+class ScopedStage {
+public:
+    ScopedStage(const char *name, size_t elements, size_t bytes_in = 0, size_t bytes_out = 0)
+        : active_(profiler().enabled()) {
+        if (!active_) return;
+        call_.name = name;
+        call_.calls = 1;
+        call_.elements = elements;
+        call_.bytes_in = bytes_in;
+        call_.bytes_out = bytes_out;
+        call_.counted = detail::thread_counters().read(start_counters_);
+        start_tsc_ = detail::read_tsc();
+        start_ = Clock::now();
+    }
+
+    ~ScopedStage() {
+        if (!active_) return;
+        auto end = Clock::now();
+        call_.tsc = detail::read_tsc() - start_tsc_;
+        uint64_t end_counters[kCounterCount];
+        call_.counted &= detail::thread_counters().read(end_counters);
+        for (int c = 0; c < kCounterCount; c++) call_.counters[c] = end_counters[c] - start_counters_[c];
+        call_.seconds = std::chrono::duration<double>(end - start_).count();
+        profiler().record(call_);
+    }
+
+    ScopedStage(const ScopedStage &) = delete;
+    ScopedStage &operator=(const ScopedStage &) = delete;
+
+    void set_bytes_in(size_t bytes) { call_.bytes_in = bytes; }
+    void set_bytes_out(size_t bytes) { call_.bytes_out = bytes; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    bool active_;
+    StageTotals call_;
+    uint64_t start_counters_[kCounterCount] = {};
+    uint64_t start_tsc_ = 0;
+    Clock::time_point start_;
+};
+
+} // namespace lossy
@@ -0,0 +1,486 @@
+#pragma once
+
+// Counter-based random numbers for the synthetic datasets.
+//
+// Philox4x32-10 (Salmon et al., Random123) turns a 128-bit counter and a
+// 64-bit key into four random words with no state, so any part of a stream
+// can be produced independently. The key is the seed; the counter holds the
+// stream (one per chunk of kRandomChunk elements), a substream and the block
+// number. Eight blocks are computed side by side (AVX2 or scalar, same words).
+//
+// fill_uniform / fill_normal / fill_exponential cut the output into fixed
+// chunks, each drawn from its own stream, so with a ThreadPool the chunks run
+// in parallel and the result is bit-identical for a given seed whatever the
+// thread count. The _at variants produce any chunk-aligned range of that
+// output on its own, so a long array can be generated block by block.
+//
+// Normal and exponential values use the Ziggurat method (Marsaglia & Tsang):
+// one word per value decides the layer and position, the common case is a
+// table compare and a multiply done 8 at a time with AVX2, and the ~1-2% of
+// values that fall in a wedge or the tail are finished from the chunk's
+// fallback substream.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "common.h"
+#include "thread_pool.h"
+
+namespace lossy {
+
+constexpr uint64_t kDefaultSeed = 42;
+
+// Elements per independent stream; fixed so threading never changes the output
+constexpr size_t kRandomChunk = size_t(1) << 16;
+
+namespace detail {
+
+constexpr uint32_t kPhiloxM0 = 0xD2511F53, kPhiloxM1 = 0xCD9E8D57;
+constexpr uint32_t kPhiloxW0 = 0x9E3779B9, kPhiloxW1 = 0xBB67AE85;
+
+// Blocks per group and words per group: group word j*8 + l is word j of block l
+constexpr size_t kPhiloxLanes = 8;
+constexpr size_t kGroupWords = 4 * kPhiloxLanes;
+
+} // namespace detail
+
+// This is the Philox4x32-10 bijection of one counter under one key
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = uint64_t(detail::kPhiloxM0) * c0;
+        uint64_t p1 = uint64_t(detail::kPhiloxM1) * c2;
+        uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+        c0 = n0;
+        c1 = uint32_t(p1);
+        c2 = n2;
+        c3 = uint32_t(p0);
+        k0 += detail::kPhiloxW0;
+        k1 += detail::kPhiloxW1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+// Where a run of words comes from: seed, stream and substream
+struct PhiloxKey {
+    uint64_t seed = kDefaultSeed;
+    uint64_t stream = 0;
+    uint32_t substream = 0;
+};
+
+namespace detail {
+
+inline void philox_groups_scalar(const PhiloxKey &id, uint32_t first_group, size_t groups, uint32_t *out) {
+    const uint32_t key[2] = {uint32_t(id.seed), uint32_t(id.seed >> 32)};
+    for (size_t g = 0; g < groups; g++, out += kGroupWords) {
+        for (size_t lane = 0; lane < kPhiloxLanes; lane++) {
+            const uint32_t counter[4] = {uint32_t((first_group + g) * kPhiloxLanes + lane), uint32_t(id.stream),
+                                         uint32_t(id.stream >> 32), id.substream};
+            uint32_t words[4];
+            philox4x32(counter, key, words);
+            for (size_t j = 0; j < 4; j++) out[j * kPhiloxLanes + lane] = words[j];
+        }
+    }
+}
+
+#if LOSSY_X86
+// 32x32 -> 64 multiply of eight lanes, split into high and low halves
+__attribute__((target("avx2"))) inline void mulhilo_avx2(__m256i a, __m256i m, __m256i &hi, __m256i &lo) {
+    __m256i even = _mm256_mul_epu32(a, m);
+    __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+    lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+    hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+__attribute__((target("avx2"))) inline void philox_groups_avx2(const PhiloxKey &id, uint32_t first_group, size_t groups,
+                                                                uint32_t *out) {
+    const __m256i m0 = _mm256_set1_epi32(int(kPhiloxM0)), m1 = _mm256_set1_epi32(int(kPhiloxM1));
+    const __m256i stream_lo = _mm256_set1_epi32(int(uint32_t(id.stream)));
+    const __m256i stream_hi = _mm256_set1_epi32(int(uint32_t(id.stream >> 32)));
+    const __m256i sub = _mm256_set1_epi32(int(id.substream));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (size_t g = 0; g < groups; g++, out += kGroupWords) {
+        __m256i base = _mm256_set1_epi32(int(uint32_t((first_group + g) * kPhiloxLanes)));
+        __m256i c0 = _mm256_add_epi32(base, lanes), c1 = stream_lo, c2 = stream_hi, c3 = sub;
+        uint32_t k0 = uint32_t(id.seed), k1 = uint32_t(id.seed >> 32);
+        for (int round = 0; round < 10; round++) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo_avx2(c0, m0, hi0, lo0);
+            mulhilo_avx2(c2, m1, hi1, lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(int(k0)));
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(int(k1)));
+            c3 = lo0;
+            k0 += kPhiloxW0;
+            k1 += kPhiloxW1;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), c0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 8), c1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 16), c2);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 24), c3);
+    }
+}
+#endif
+
+} // namespace detail
+
+// This is to write `groups` groups (kGroupWords words each) of a stream, starting at first_group
+inline void philox_words(const PhiloxKey &id, uint32_t first_group, size_t groups, uint32_t *out) {
+#if LOSSY_X86
+    if (detect_simd() >= SimdLevel::AVX2) return detail::philox_groups_avx2(id, first_group, groups, out);
+#endif
+    detail::philox_groups_scalar(id, first_group, groups, out);
+}
+
+// Sequential reader over one stream, for code that needs an unknown number of words
+class PhiloxStream {
+public:
+    explicit PhiloxStream(const PhiloxKey &id) : id_(id) {}
+
+    uint32_t next() {
+        if (pos_ == detail::kGroupWords) {
+            detail::philox_groups_scalar(id_, group_++, 1, buffer_);
+            pos_ = 0;
+        }
+        return buffer_[pos_++];
+    }
+
+    uint64_t next64() {
+        uint64_t lo = next();
+        return lo | uint64_t(next()) << 32;
+    }
+
+    // This is a double in (0, 1], safe to take the log of
+    double uniform_open0() { return double((next64() >> 11) + 1) * 0x1p-53; }
+
+private:
+    PhiloxKey id_;
+    uint32_t group_ = 0;
+    size_t pos_ = detail::kGroupWords;
+    uint32_t buffer_[detail::kGroupWords];
+};
+
+// Random word per value and how many of its top bits form the uniform part
+template <typename T>
+struct RandomWord;
+
+template <>
+struct RandomWord<float> {
+    using Word = uint32_t;
+    static constexpr int uniform_bits = 24;
+    static Word read(const uint32_t *words, size_t i) { return words[i]; }
+    static Word draw(PhiloxStream &s) { return s.next(); }
+};
+
+template <>
+struct RandomWord<double> {
+    using Word = uint64_t;
+    static constexpr int uniform_bits = 53;
+    static Word read(const uint32_t *words, size_t i) { return words[2 * i] | uint64_t(words[2 * i + 1]) << 32; }
+    static Word draw(PhiloxStream &s) { return s.next64(); }
+};
+
+// Ziggurat shapes. r is the start of the tail, v the area of each layer.
+struct NormalShape {
+    static constexpr int layers = 128;
+    static constexpr bool symmetric = true;
+    static constexpr uint32_t substream = 2;
+    static constexpr double r = 3.442619855899;
+    static constexpr double v = 9.91256303526217e-3;
+    static double f(double x) { return std::exp(-0.5 * x * x); }
+    static double f_inv(double y) { return std::sqrt(-2.0 * std::log(y)); }
+    static double tail(PhiloxStream &s) {
+        double a, b;
+        do {
+            a = -std::log(s.uniform_open0()) / r;
+            b = -std::log(s.uniform_open0());
+        } while (b + b < a * a);
+        return r + a;
+    }
+};
+
+struct ExponentialShape {
+    static constexpr int layers = 256;
+    static constexpr bool symmetric = false;
+    static constexpr uint32_t substream = 4;
+    static constexpr double r = 7.69711747013104972;
+    static constexpr double v = 3.949659822581572e-3;
+    static double f(double x) { return std::exp(-x); }
+    static double f_inv(double y) { return -std::log(y); }
+    static double tail(PhiloxStream &s) { return r - std::log(s.uniform_open0()); }
+};
+
+// Layer tables: layer i covers [0, x[i]) and everything below x[i+1] is accepted at once
+template <typename T, typename Shape>
+struct ZigguratTable {
+    using Word = typename RandomWord<T>::Word;
+    Word k[Shape::layers]; // x[i+1] / x[i] scaled to the uniform bits
+    T w[Shape::layers];    // x[i] / 2^uniform_bits
+    double x[Shape::layers + 1];
+    double f[Shape::layers + 1];
+
+    static const ZigguratTable &get() {
+        static const ZigguratTable table;
+        return table;
+    }
+
+private:
+    ZigguratTable() {
+        constexpr int n = Shape::layers;
+        x[0] = Shape::v / Shape::f(Shape::r);
+        x[1] = Shape::r;
+        for (int i = 1; i < n - 1; i++) x[i + 1] = Shape::f_inv(Shape::v / x[i] + Shape::f(x[i]));
+        x[n] = 0.0;
+        const double scale = std::ldexp(1.0, RandomWord<T>::uniform_bits);
+        for (int i = 0; i <= n; i++) f[i] = Shape::f(x[i]);
+        for (int i = 0; i < n; i++) {
+            k[i] = Word(x[i + 1] / x[i] * scale);
+            w[i] = T(x[i] / scale);
+        }
+    }
+};
+
+namespace detail {
+
+// Layer, sign and uniform part of one word
+template <typename T, typename Shape>
+struct ZigguratDraw {
+    using Word = typename RandomWord<T>::Word;
+    static constexpr Word index_mask = Word(Shape::layers - 1);
+    static constexpr int shift = int(sizeof(Word) * 8) - RandomWord<T>::uniform_bits;
+
+    static size_t index(Word w) { return size_t(w & index_mask); }
+    static bool negative(Word w) { return Shape::symmetric && ((w >> 7) & 1); }
+    static Word uniform(Word w) { return w >> shift; }
+};
+
+// This is to finish a value whose word missed the rectangle (wedge, tail or retry)
+template <typename T, typename Shape>
+T ziggurat_slow(typename RandomWord<T>::Word word, PhiloxStream &fallback) {
+    using Draw = ZigguratDraw<T, Shape>;
+    const ZigguratTable<T, Shape> &t = ZigguratTable<T, Shape>::get();
+    for (;;) {
+        size_t i = Draw::index(word);
+        typename RandomWord<T>::Word u = Draw::uniform(word);
+        double x;
+        bool accepted = false;
+        if (u < t.k[i]) {
+            x = double(T(u) * t.w[i]);
+            accepted = true;
+        } else if (i == 0) {
+            x = Shape::tail(fallback);
+            accepted = true;
+        } else {
+            x = double(T(u) * t.w[i]);
+            double y = t.f[i] + fallback.uniform_open0() * (t.f[i + 1] - t.f[i]);
+            accepted = y < Shape::f(x);
+        }
+        if (accepted) return Draw::negative(word) ? -T(x) : T(x);
+        word = RandomWord<T>::draw(fallback);
+    }
+}
+
+// This is the fast path: rectangle values in place, returns false if any value needs the slow path
+template <typename T, typename Shape>
+bool ziggurat_fast_scalar(const typename RandomWord<T>::Word *words, T *out, size_t n, uint8_t *slow) {
+    using Draw = ZigguratDraw<T, Shape>;
+    const ZigguratTable<T, Shape> &t = ZigguratTable<T, Shape>::get();
+    bool any = false;
+    for (size_t j = 0; j < n; j++) {
+        size_t i = Draw::index(words[j]);
+        typename RandomWord<T>::Word u = Draw::uniform(words[j]);
+        T x = T(u) * t.w[i];
+        out[j] = Draw::negative(words[j]) ? -x : x;
+        slow[j] = !(u < t.k[i]);
+        any |= slow[j];
+    }
+    return any;
+}
+
+#if LOSSY_X86
+template <typename Shape>
+__attribute__((target("avx2"))) bool ziggurat_fast_avx2(const uint32_t *words, float *out, size_t n, uint8_t *slow) {
+    using Draw = ZigguratDraw<float, Shape>;
+    const ZigguratTable<float, Shape> &t = ZigguratTable<float, Shape>::get();
+    const __m256i index_mask = _mm256_set1_epi32(int(Draw::index_mask));
+    const __m256i sign_bit = _mm256_set1_epi32(Shape::symmetric ? int(0x80000000u) : 0);
+    const int *k = reinterpret_cast<const int *>(t.k);
+    bool any = false;
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m256i word = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + j));
+        __m256i index = _mm256_and_si256(word, index_mask);
+        __m256i u = _mm256_srli_epi32(word, Draw::shift);
+        __m256i limit = _mm256_i32gather_epi32(k, index, 4);
+        __m256 width = _mm256_i32gather_ps(t.w, index, 4);
+        __m256 x = _mm256_mul_ps(_mm256_cvtepi32_ps(u), width);
+        // Bit 7 of the word is the sign: move it to bit 31
+        __m256i sign = _mm256_and_si256(_mm256_slli_epi32(word, 24), sign_bit);
+        x = _mm256_xor_ps(x, _mm256_castsi256_ps(sign));
+        _mm256_storeu_ps(out + j, x);
+        int reject = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, u))) & 0xFF;
+        for (int l = 0; l < 8; l++) slow[j + l] = (reject >> l) & 1;
+        any |= reject != 0;
+    }
+    return ziggurat_fast_scalar<float, Shape>(words + j, out + j, n - j, slow + j) || any;
+}
+#endif
+
+// This is to run the fast path on raw Philox words; words[] is filled when it returns true
+template <typename T, typename Shape>
+bool ziggurat_fast(const uint32_t *raw, typename RandomWord<T>::Word *words, T *out, size_t n, uint8_t *slow) {
+#if LOSSY_X86
+    if constexpr (std::is_same_v<T, float>) {
+        if (detect_simd() >= SimdLevel::AVX2) {
+            if (!ziggurat_fast_avx2<Shape>(raw, out, n, slow)) return false;
+            std::memcpy(words, raw, n * sizeof(uint32_t));
+            return true;
+        }
+    }
+#endif
+    for (size_t j = 0; j < n; j++) words[j] = RandomWord<T>::read(raw, j);
+    return ziggurat_fast_scalar<T, Shape>(words, out, n, slow);
+}
+
+// Values per inner block: the words and flags of one block stay in L1
+constexpr size_t kRandomBlock = 2048;
+
+// This is to run fn(chunk, first, count) over the fixed chunks of [0, n)
+template <typename Fn>
+void for_each_random_chunk(size_t n, Fn &&fn) {
+    for (size_t c = 0; c * kRandomChunk < n; c++) fn(c, c * kRandomChunk, std::min(kRandomChunk, n - c * kRandomChunk));
+}
+
+template <typename Fn>
+void for_each_random_chunk(size_t n, ThreadPool &pool, Fn &&fn) {
+    size_t chunks = (n + kRandomChunk - 1) / kRandomChunk;
+    parallel_for(pool, chunks, [&](size_t c) { fn(c, c * kRandomChunk, std::min(kRandomChunk, n - c * kRandomChunk)); });
+}
+
+// This is the same over elements [first, first + n) of the whole output; first must start a chunk
+template <typename Fn>
+void for_each_random_chunk_at(uint64_t first, size_t n, Fn &&fn) {
+    if (first % kRandomChunk != 0) throw std::runtime_error("random range must start on a kRandomChunk boundary");
+    const size_t base = size_t(first / kRandomChunk);
+    for_each_random_chunk(n, [&](size_t c, size_t offset, size_t count) { fn(base + c, offset, count); });
+}
+
+// This is to fill one chunk with uniform [0, 1) values
+template <typename T>
+void uniform_chunk(uint64_t seed, size_t chunk, T *out, size_t n) {
+    constexpr size_t per_value = sizeof(typename RandomWord<T>::Word) / 4;
+    constexpr int shift = int(sizeof(typename RandomWord<T>::Word) * 8) - RandomWord<T>::uniform_bits;
+    const T scale = T(std::ldexp(1.0, -RandomWord<T>::uniform_bits));
+    uint32_t words[kRandomBlock * per_value];
+    PhiloxKey id{seed, chunk, 0};
+    for (size_t first = 0; first < n; first += kRandomBlock) {
+        size_t count = std::min(kRandomBlock, n - first);
+        size_t groups = (count * per_value + kGroupWords - 1) / kGroupWords;
+        philox_words(id, uint32_t(first * per_value / kGroupWords), groups, words);
+        for (size_t j = 0; j < count; j++) out[first + j] = T(RandomWord<T>::read(words, j) >> shift) * scale;
+    }
+}
+
+// This is to fill one chunk from a Ziggurat shape
+template <typename T, typename Shape>
+void ziggurat_chunk(uint64_t seed, size_t chunk, T *out, size_t n) {
+    using Word = typename RandomWord<T>::Word;
+    constexpr size_t per_value = sizeof(Word) / 4;
+    uint32_t raw[kRandomBlock * per_value];
+    Word words[kRandomBlock];
+    uint8_t slow[kRandomBlock];
+    PhiloxKey id{seed, chunk, Shape::substream};
+    PhiloxStream fallback(PhiloxKey{seed, chunk, Shape::substream + 1});
+    for (size_t first = 0; first < n; first += kRandomBlock) {
+        size_t count = std::min(kRandomBlock, n - first);
+        size_t groups = (count * per_value + kGroupWords - 1) / kGroupWords;
+        philox_words(id, uint32_t(first * per_value / kGroupWords), groups, raw);
+        if (!ziggurat_fast<T, Shape>(raw, words, out + first, count, slow)) continue;
+        // In index order, so the fallback stream is consumed the same way on every path
+        for (size_t j = 0; j < count; j++)
+            if (slow[j]) out[first + j] = ziggurat_slow<T, Shape>(words[j], fallback);
+    }
+}
+
+} // namespace detail
+
+// This is to fill out[0, n) with uniform [0, 1) values of the given seed
+template <typename T>
+void fill_uniform(uint64_t seed, T *out, size_t n) {
+    detail::for_each_random_chunk(n, [&](size_t c, size_t first, size_t count) {
+        detail::uniform_chunk(seed, c, out + first, count);
+    });
+}
+
+template <typename T>
+void fill_uniform(uint64_t seed, T *out, size_t n, ThreadPool &pool) {
+    detail::for_each_random_chunk(n, pool, [&](size_t c, size_t first, size_t count) {
+        detail::uniform_chunk(seed, c, out + first, count);
+    });
+}
+
+// This is to write elements [first, first + n) of fill_uniform's output; first must be a multiple of kRandomChunk
+template <typename T>
+void fill_uniform_at(uint64_t seed, uint64_t first, T *out, size_t n) {
+    detail::for_each_random_chunk_at(first, n, [&](size_t c, size_t offset, size_t count) {
+        detail::uniform_chunk(seed, c, out + offset, count);
+    });
+}
+
+// This is to fill out[0, n) with standard normal values (mean 0, std 1)
+template <typename T>
+void fill_normal(uint64_t seed, T *out, size_t n) {
+    detail::for_each_random_chunk(n, [&](size_t c, size_t first, size_t count) {
+        detail::ziggurat_chunk<T, NormalShape>(seed, c, out + first, count);
+    });
+}
+
+template <typename T>
+void fill_normal(uint64_t seed, T *out, size_t n, ThreadPool &pool) {
+    detail::for_each_random_chunk(n, pool, [&](size_t c, size_t first, size_t count) {
+        detail::ziggurat_chunk<T, NormalShape>(seed, c, out + first, count);
+    });
+}
+
+// This is to write elements [first, first + n) of fill_normal's output; first must be a multiple of kRandomChunk
+template <typename T>
+void fill_normal_at(uint64_t seed, uint64_t first, T *out, size_t n) {
+    detail::for_each_random_chunk_at(first, n, [&](size_t c, size_t offset, size_t count) {
+        detail::ziggurat_chunk<T, NormalShape>(seed, c, out + offset, count);
+    });
+}
+
+// This is to fill out[0, n) with exponential values of rate 1
+template <typename T>
+void fill_exponential(uint64_t seed, T *out, size_t n) {
+    detail::for_each_random_chunk(n, [&](size_t c, size_t first, size_t count) {
+        detail::ziggurat_chunk<T, ExponentialShape>(seed, c, out + first, count);
+    });
+}
+
+template <typename T>
+void fill_exponential(uint64_t seed, T *out, size_t n, ThreadPool &pool) {
+    detail::for_each_random_chunk(n, pool, [&](size_t c, size_t first, size_t count) {
+        detail::ziggurat_chunk<T, ExponentialShape>(seed, c, out + first, count);
+    });
+}
+
+// This is to write elements [first, first + n) of fill_exponential's output; first must be a multiple of kRandomChunk
+template <typename T>
+void fill_exponential_at(uint64_t seed, uint64_t first, T *out, size_t n) {
+    detail::for_each_random_chunk_at(first, n, [&](size_t c, size_t offset, size_t count) {
+        detail::ziggurat_chunk<T, ExponentialShape>(seed, c, out + offset, count);
+    });
+}
+
+} // namespace lossy
@@ -0,0 +1,255 @@
+#pragma once
+
+// Static rANS entropy coder for byte streams.
+//
+// rans_encode() counts the symbols of a buffer, scales the counts to
+// frequencies summing to 2^12 and codes the bytes with four interleaved
+// rANS states sharing one output stream (Duda, "Asymmetric numeral
+// systems", 2013; the reciprocal division follows Giesen's ryg_rans).
+// States live in [2^15, 2^31) and are renormalised by 16 bits, so a symbol
+// moves at most one 16-bit word in either direction. Encoding runs backwards
+// so decoding runs forwards; the decoder finds the symbol of a state with one
+// lookup in a 4096-entry slot table, so both directions are a multiply, a
+// few adds and at most one word load per symbol.
+//
+// Payload layout (all integers little-endian):
+//
+//   uint8 first, uint8 last       range of the symbols present
+//   uint16 freq[last - first + 1] scaled frequencies
+//   uint32 state[4]               final encoder states, decoder start
+//   uint16 words                  renormalisation output
+//
+// A stream of one repeated symbol costs only the header. The element count
+// is not stored: it comes from the caller.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace lossy {
+
+constexpr int kRansScaleBits = 12;
+constexpr uint32_t kRansScale = 1u << kRansScaleBits;
+constexpr uint32_t kRansLow = 1u << 15; // states stay in [kRansLow, 2^16 * kRansLow)
+
+// This is to get the Shannon entropy of a byte stream in bits per symbol
+inline double byte_entropy(const unsigned char *data, size_t n) {
+    size_t counts[256] = {};
+    for (size_t i = 0; i < n; i++) counts[data[i]]++;
+    double bits = 0;
+    for (size_t c : counts)
+        if (c) bits -= double(c) * std::log2(double(c) / double(n));
+    return n ? bits / double(n) : 0.0;
+}
+
+namespace detail {
+
+// This is to scale symbol counts to frequencies summing to kRansScale, keeping every present symbol
+inline void rans_normalize(const size_t counts[256], uint32_t freq[256]) {
+    size_t total = 0;
+    for (int s = 0; s < 256; s++) total += counts[s];
+    uint32_t sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        freq[s] = counts[s] ? std::max<uint32_t>(1, uint32_t(double(counts[s]) * kRansScale / double(total))) : 0;
+        sum += freq[s];
+        if (counts[s] > counts[largest]) largest = s;
+    }
+    // Rounding error goes to (or comes from) the most frequent symbols, which it costs least
+    while (sum != kRansScale) {
+        if (sum < kRansScale) {
+            freq[largest] += kRansScale - sum;
+            sum = kRansScale;
+        } else {
+            int s = largest;
+            for (int t = 0; t < 256; t++)
+                if (freq[t] > freq[s]) s = t;
+            uint32_t take = std::min(sum - kRansScale, freq[s] - 1);
+            freq[s] -= take;
+            sum -= take;
+        }
+    }
+}
+
+// Encoder side of one symbol: division by freq replaced by a multiply with its reciprocal
+struct RansEncSymbol {
+    uint32_t x_max;
+    uint32_t rcp_freq;
+    uint32_t bias;
+    uint32_t cmpl_freq;
+    uint32_t rcp_shift;
+};
+
+inline RansEncSymbol rans_enc_symbol(uint32_t start, uint32_t freq) {
+    RansEncSymbol s;
+    s.x_max = ((kRansLow >> kRansScaleBits) << 16) * freq;
+    s.cmpl_freq = kRansScale - freq;
+    if (freq < 2) {
+        s.rcp_freq = ~0u;
+        s.rcp_shift = 0;
+        s.bias = start + kRansScale - 1;
+    } else {
+        uint32_t shift = 0;
+        while (freq > (1u << shift)) shift++;
+        s.rcp_freq = uint32_t(((uint64_t(1) << (shift + 31)) + freq - 1) / freq);
+        s.rcp_shift = shift - 1;
+        s.bias = start;
+    }
+    return s;
+}
+
+inline void rans_put(uint32_t &x, unsigned char *&ptr, const RansEncSymbol &sym) {
+    // x < 2^31, so one 16-bit step always brings it under x_max >= 2^19. The word is stored
+    // unconditionally and kept only if needed, which avoids a hard-to-predict branch.
+    const uint32_t shift = x >= sym.x_max;
+    uint16_t word = uint16_t(x);
+    std::memcpy(ptr - 2, &word, 2);
+    ptr -= 2 * shift;
+    x >>= 16 * shift;
+    uint32_t q = uint32_t((uint64_t(x) * sym.rcp_freq) >> 32) >> sym.rcp_shift;
+    x += sym.bias + q * sym.cmpl_freq;
+}
+
+// Decoder side: one entry per slot of [0, kRansScale)
+struct RansDecSlot {
+    uint16_t freq;
+    uint16_t offset; // slot - cumulative frequency of the symbol
+    uint8_t symbol;
+};
+
+// One decoding step; the refill word is taken from `words` (the next four stream words), `used` counts the ones taken
+inline uint8_t rans_step(uint32_t &state, uint64_t words, int &used, const RansDecSlot *slots) {
+    const RansDecSlot &slot = slots[state & (kRansScale - 1)];
+    state = uint32_t(slot.freq) * (state >> kRansScaleBits) + slot.offset;
+    // Arithmetic instead of a branch: whether a state refills is close to random
+    const uint32_t refill = state < kRansLow;
+    const uint32_t word = uint16_t(words >> (16 * used));
+    state = state << (16 * refill) | (word & (0u - refill));
+    used += int(refill);
+    return slot.symbol;
+}
+
+} // namespace detail
+
+// This is to get an upper bound of the rans_encode() output for n bytes (a symbol costs at most 12 bits)
+inline size_t rans_bound(size_t n) { return 2 + 512 + 16 + n + n / 2 + 16; }
+
+// This is to entropy-code n bytes; returns the payload
+inline std::vector<unsigned char> rans_encode(const unsigned char *data, size_t n) {
+    size_t counts[256] = {};
+    for (size_t i = 0; i < n; i++) counts[data[i]]++;
+    int first = 0, last = 0;
+    if (n > 0) {
+        while (!counts[first]) first++;
+        last = 255;
+        while (!counts[last]) last--;
+    }
+    uint32_t freq[256] = {};
+    if (n > 0) detail::rans_normalize(counts, freq);
+
+    detail::RansEncSymbol symbols[256];
+    for (uint32_t s = 0, start = 0; s < 256; start += freq[s], s++)
+        if (freq[s]) symbols[s] = detail::rans_enc_symbol(start, freq[s]);
+
+    const size_t header = 2 + 2 * size_t(last - first + 1);
+    std::vector<unsigned char> out(rans_bound(n));
+    out[0] = uint8_t(first);
+    out[1] = uint8_t(last);
+    for (int s = first; s <= last; s++) {
+        uint16_t f = uint16_t(freq[s]);
+        std::memcpy(&out[2 + 2 * size_t(s - first)], &f, 2);
+    }
+
+    // The stream grows down from the end of the buffer and is moved up behind the header afterwards
+    unsigned char *end = out.data() + out.size();
+    unsigned char *ptr = end;
+    uint32_t x[4] = {kRansLow, kRansLow, kRansLow, kRansLow};
+    size_t i = n;
+    while (i % 4 != 0) {
+        i--;
+        detail::rans_put(x[i % 4], ptr, symbols[data[i]]);
+    }
+    while (i > 0) {
+        i -= 4;
+        detail::rans_put(x[3], ptr, symbols[data[i + 3]]);
+        detail::rans_put(x[2], ptr, symbols[data[i + 2]]);
+        detail::rans_put(x[1], ptr, symbols[data[i + 1]]);
+        detail::rans_put(x[0], ptr, symbols[data[i]]);
+    }
+    for (int k = 3; k >= 0; k--) {
+        ptr -= 4;
+        std::memcpy(ptr, &x[k], 4);
+    }
+    const size_t stream = size_t(end - ptr);
+    std::memmove(out.data() + header, ptr, stream);
+    out.resize(header + stream);
+    return out;
+}
+
+inline std::vector<unsigned char> rans_encode(const std::vector<unsigned char> &data) {
+    return rans_encode(data.data(), data.size());
+}
+
+// This is to decode n bytes from a rans_encode() payload; throws on a malformed or truncated payload
+inline void rans_decode(const unsigned char *payload, size_t bytes, unsigned char *out, size_t n) {
+    if (bytes < 2) throw std::runtime_error("rANS payload truncated");
+    const int first = payload[0], last = payload[1];
+    if (last < first) throw std::runtime_error("bad rANS symbol range");
+    const size_t header = 2 + 2 * size_t(last - first + 1);
+    if (bytes < header + 16) throw std::runtime_error("rANS payload truncated");
+
+    detail::RansDecSlot slots[kRansScale];
+    uint32_t start = 0;
+    for (int s = first; s <= last; s++) {
+        uint16_t f;
+        std::memcpy(&f, payload + 2 + 2 * size_t(s - first), 2);
+        if (start + f > kRansScale) throw std::runtime_error("bad rANS frequency table");
+        for (uint32_t slot = start; slot < start + f; slot++)
+            slots[slot] = {f, uint16_t(slot - start), uint8_t(s)};
+        start += f;
+    }
+    if (n > 0 && start != kRansScale) throw std::runtime_error("bad rANS frequency table");
+
+    const unsigned char *ptr = payload + header;
+    const unsigned char *end = payload + bytes;
+    uint32_t x[4];
+    std::memcpy(x, ptr, sizeof x);
+    ptr += sizeof x;
+
+    // Each symbol reads at most one word, so one 8-byte load serves four symbols and the stream
+    // pointer is advanced once per group instead of after every symbol
+    size_t i = 0;
+    uint32_t x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3];
+    for (; i + 4 <= n && end - ptr >= 8; i += 4) {
+        uint64_t words;
+        std::memcpy(&words, ptr, sizeof words);
+        int used = 0;
+        out[i] = detail::rans_step(x0, words, used, slots);
+        out[i + 1] = detail::rans_step(x1, words, used, slots);
+        out[i + 2] = detail::rans_step(x2, words, used, slots);
+        out[i + 3] = detail::rans_step(x3, words, used, slots);
+        ptr += 2 * used;
+    }
+    x[0] = x0, x[1] = x1, x[2] = x2, x[3] = x3;
+    bool overrun = false;
+    for (; i < n; i++) {
+        uint32_t &state = x[i % 4];
+        const detail::RansDecSlot &slot = slots[state & (kRansScale - 1)];
+        out[i] = slot.symbol;
+        state = uint32_t(slot.freq) * (state >> kRansScaleBits) + slot.offset;
+        if (state < kRansLow) {
+            // A truncated stream reads zeros and is reported at the end
+            uint16_t word = 0;
+            if (end - ptr >= 2) std::memcpy(&word, ptr, 2);
+            overrun |= end - ptr < 2;
+            state = state << 16 | word;
+            ptr += end - ptr >= 2 ? 2 : 0;
+        }
+    }
+    if (overrun) throw std::runtime_error("rANS payload truncated");
+}
+
+} // namespace lossy
@@ -0,0 +1,123 @@
+#pragma once
+
+// Rows measured by the sweep harness (sweep.h) and their CSV/JSON form.
+//
+// Kept free of the codec headers so that analysis code (pareto.h, the ROOT
+// macros) can read results without linking zlib.
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace lossy {
+
+struct SweepResult {
+    std::string distribution;
+    size_t n = 0;
+    int bits_to_zero = 0;
+    std::string codec;
+    size_t threads = 1;
+    size_t raw_bytes = 0;
+    size_t compressed_bytes = 0;
+    double ratio = 0.0;
+    double mse = 0.0;
+    double mae = 0.0;
+    double max_abs_error = 0.0;
+    double psnr = 0.0;
+    double encode_mbps = 0.0;
+    double decode_mbps = 0.0;
+    size_t clipped = 0; // values pushed out of range by the storage format (metrics.h overflow + underflow)
+};
+
+inline const char *sweep_csv_header() {
+    return "distribution,n,bits_to_zero,codec,threads,raw_bytes,compressed_bytes,ratio,mse,mae,max_abs_error,psnr,"
+           "encode_mbps,decode_mbps,clipped";
+}
+
+inline void write_sweep_csv(const std::string &filename, const std::vector<SweepResult> &rows) {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("cannot open " + filename);
+    out.precision(10);
+    out << sweep_csv_header() << "\n";
+    for (const SweepResult &r : rows) {
+        out << r.distribution << ',' << r.n << ',' << r.bits_to_zero << ',' << r.codec << ',' << r.threads << ','
+            << r.raw_bytes << ',' << r.compressed_bytes << ',' << r.ratio << ',' << r.mse << ',' << r.mae << ','
+            << r.max_abs_error << ',' << r.psnr << ',' << r.encode_mbps << ',' << r.decode_mbps << ',' << r.clipped
+            << "\n";
+    }
+    if (!out) throw std::runtime_error("write failed: " + filename);
+}
+
+inline void write_sweep_json(const std::string &filename, const std::vector<SweepResult> &rows) {
+    std::ofstream out(filename);
+    if (!out) throw std::runtime_error("cannot open " + filename);
+    out.precision(10);
+    // PSNR is +inf for lossless rows, which JSON cannot represent
+    auto number = [](double v) {
+        std::ostringstream s;
+        s.precision(10);
+        if (std::isfinite(v)) {
+            s << v;
+        } else {
+            s << "null";
+        }
+        return s.str();
+    };
+    out << "[\n";
+    for (size_t i = 0; i < rows.size(); i++) {
+        const SweepResult &r = rows[i];
+        out << "  {\"distribution\": \"" << r.distribution << "\", \"n\": " << r.n
+            << ", \"bits_to_zero\": " << r.bits_to_zero << ", \"codec\": \"" << r.codec << "\", \"threads\": "
+            << r.threads << ", \"raw_bytes\": " << r.raw_bytes << ", \"compressed_bytes\": " << r.compressed_bytes
+            << ", \"ratio\": " << number(r.ratio) << ", \"mse\": " << number(r.mse) << ", \"mae\": " << number(r.mae)
+            << ", \"max_abs_error\": " << number(r.max_abs_error) << ", \"psnr\": " << number(r.psnr)
+            << ", \"encode_mbps\": " << number(r.encode_mbps) << ", \"decode_mbps\": " << number(r.decode_mbps)
+            << ", \"clipped\": " << r.clipped << "}"
+            << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+    if (!out) throw std::runtime_error("write failed: " + filename);
+}
+
+// This is to read rows written by write_sweep_csv(); files from before the clipped column still load
+inline std::vector<SweepResult> read_sweep_csv(const std::string &filename) {
+    std::ifstream in(filename);
+    if (!in) throw std::runtime_error("cannot open " + filename);
+    std::string line;
+    const std::string header = sweep_csv_header();
+    const std::string legacy = header.substr(0, header.rfind(','));
+    if (!std::getline(in, line) || (line != header && line != legacy))
+        throw std::runtime_error("not a sweep CSV: " + filename);
+    const size_t columns = line == header ? 15 : 14;
+    std::vector<SweepResult> rows;
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        std::vector<std::string> f;
+        std::stringstream ss(line);
+        for (std::string field; std::getline(ss, field, ',');) f.push_back(field);
+        if (f.size() != columns) throw std::runtime_error("bad sweep row: " + line);
+        SweepResult r;
+        r.distribution = f[0];
+        r.n = std::stoull(f[1]);
+        r.bits_to_zero = std::stoi(f[2]);
+        r.codec = f[3];
+        r.threads = std::stoull(f[4]);
+        r.raw_bytes = std::stoull(f[5]);
+        r.compressed_bytes = std::stoull(f[6]);
+        r.ratio = std::stod(f[7]);
+        r.mse = std::stod(f[8]);
+        r.mae = std::stod(f[9]);
+        r.max_abs_error = std::stod(f[10]);
+        r.psnr = std::stod(f[11]);
+        r.encode_mbps = std::stod(f[12]);
+        r.decode_mbps = std::stod(f[13]);
+        if (columns > 14) r.clipped = std::stoull(f[14]);
+        rows.push_back(r);
+    }
+    return rows;
+}
+
+} // namespace lossy
@@ -0,0 +1,171 @@
+#pragma once
+
+// Rounding modes for mantissa LSB removal.
+//
+// mask_lsb() truncates toward zero, so every value moves toward zero and the
+// error has a mean of about half a step. round_lsb() can instead round to
+// nearest-even (half the maximum error, no bias) or round stochastically (up
+// with probability equal to the dropped fraction, so the error averages to
+// zero over many values). Both work on the bit pattern: a value is added
+// below the kept bits and the sum is masked, so a carry out of the mantissa
+// moves into the exponent like a real rounding. A finite value never rounds
+// to Inf (it is truncated instead); Inf stays Inf and NaN stays a quiet NaN.
+//
+// The noise for stochastic rounding comes from Philox (random.h) keyed by a
+// seed and a stream, so a chunk rounds the same way on any thread. AVX-512F
+// and AVX2 kernels are picked at runtime; other CPUs use the scalar loop.
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "common.h"
+#include "mask.h"
+#include "profile.h"
+#include "random.h"
+
+namespace lossy {
+
+enum class Rounding : uint8_t { Truncate = 0, NearestEven = 1, Stochastic = 2 };
+
+inline const char *rounding_name(Rounding mode) {
+    switch (mode) {
+    case Rounding::NearestEven: return "rne";
+    case Rounding::Stochastic: return "stochastic";
+    default: return "truncate";
+    }
+}
+
+// This is to parse "truncate", "rne" or "stochastic"
+inline Rounding parse_rounding(const std::string &name) {
+    if (name == "truncate") return Rounding::Truncate;
+    if (name == "rne") return Rounding::NearestEven;
+    if (name == "stochastic" || name == "sr") return Rounding::Stochastic;
+    throw std::runtime_error("unknown rounding mode: " + name);
+}
+
+namespace detail {
+
+constexpr uint32_t kExponentBits = 0x7F800000u;
+constexpr uint32_t kQuietNaN = 0x00400000u;
+constexpr uint32_t kRoundingSubstream = 6;
+
+// This is to add `add` below the kept bits of x and mask, without turning finite values into Inf
+inline uint32_t round_word(uint32_t x, uint32_t mask, uint32_t add) {
+    uint32_t truncated = x & mask;
+    if ((x & kExponentBits) == kExponentBits) return (x & 0x007FFFFFu) ? truncated | kQuietNaN : truncated;
+    uint32_t r = (x + add) & mask;
+    return (r & kExponentBits) == kExponentBits ? truncated : r;
+}
+
+// Half a step minus one, plus the lowest kept bit: ties go to the even neighbour
+inline uint32_t nearest_even_add(uint32_t x, uint32_t mask) {
+    return (~mask >> 1) + ((x & (~mask + 1u)) != 0);
+}
+
+// noise == nullptr rounds to nearest-even, otherwise noise[i] & ~mask is added to element i
+inline void round_scalar(const float *in, float *out, size_t n, uint32_t mask, const uint32_t *noise) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = float_bits(in[i]);
+        uint32_t add = noise ? noise[i] & ~mask : nearest_even_add(x, mask);
+        out[i] = bits_float(round_word(x, mask, add));
+    }
+}
+
+#if LOSSY_X86
+__attribute__((target("avx2")))
+inline void round_avx2(const float *in, float *out, size_t n, uint32_t mask, const uint32_t *noise) {
+    const __m256i keep = _mm256_set1_epi32(int32_t(mask));
+    const __m256i low = _mm256_set1_epi32(int32_t(~mask));
+    const __m256i half = _mm256_set1_epi32(int32_t(~mask >> 1));
+    const __m256i lsb = _mm256_set1_epi32(int32_t(~mask + 1u));
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i exponent = _mm256_set1_epi32(int32_t(kExponentBits));
+    const __m256i magnitude = _mm256_set1_epi32(0x7FFFFFFF);
+    const __m256i quiet = _mm256_set1_epi32(int32_t(kQuietNaN));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        __m256i add = noise ? _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(noise + i)), low)
+                            : _mm256_add_epi32(half, _mm256_min_epu32(_mm256_and_si256(x, lsb), one));
+        __m256i r = _mm256_and_si256(_mm256_add_epi32(x, add), keep);
+        // Inf/NaN inputs and finite values that would carry into Inf are truncated instead
+        __m256i bad = _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_and_si256(r, exponent), exponent),
+                                      _mm256_cmpeq_epi32(_mm256_and_si256(x, exponent), exponent));
+        r = _mm256_blendv_epi8(r, _mm256_and_si256(x, keep), bad);
+        __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(x, magnitude), exponent);
+        r = _mm256_or_si256(r, _mm256_and_si256(nan, quiet));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), r);
+    }
+    round_scalar(in + i, out + i, n - i, mask, noise ? noise + i : nullptr);
+}
+
+__attribute__((target("avx512f")))
+inline void round_avx512(const float *in, float *out, size_t n, uint32_t mask, const uint32_t *noise) {
+    const __m512i keep = _mm512_set1_epi32(int32_t(mask));
+    const __m512i low = _mm512_set1_epi32(int32_t(~mask));
+    const __m512i half = _mm512_set1_epi32(int32_t(~mask >> 1));
+    const __m512i lsb = _mm512_set1_epi32(int32_t(~mask + 1u));
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i exponent = _mm512_set1_epi32(int32_t(kExponentBits));
+    const __m512i magnitude = _mm512_set1_epi32(0x7FFFFFFF);
+    const __m512i quiet = _mm512_set1_epi32(int32_t(kQuietNaN));
+    for (size_t i = 0; i < n; i += 16) {
+        // A partial mask covers the last 0..15 elements
+        __mmask16 k = n - i >= 16 ? __mmask16(0xFFFF) : __mmask16((1u << (n - i)) - 1u);
+        __m512i x = _mm512_maskz_loadu_epi32(k, in + i);
+        __m512i add = noise ? _mm512_and_si512(_mm512_maskz_loadu_epi32(k, noise + i), low)
+                            : _mm512_add_epi32(half, _mm512_maskz_min_epu32(0xFFFF, _mm512_and_si512(x, lsb), one));
+        __m512i r = _mm512_and_si512(_mm512_add_epi32(x, add), keep);
+        __mmask16 bad = _mm512_cmpeq_epi32_mask(_mm512_and_si512(r, exponent), exponent) |
+                        _mm512_cmpeq_epi32_mask(_mm512_and_si512(x, exponent), exponent);
+        r = _mm512_mask_and_epi32(r, bad, x, keep);
+        __mmask16 nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(x, magnitude), exponent);
+        r = _mm512_mask_or_epi32(r, nan, r, quiet);
+        _mm512_mask_storeu_epi32(out + i, k, r);
+    }
+}
+#endif
+
+inline void round_block(const float *in, float *out, size_t n, uint32_t mask, const uint32_t *noise, SimdLevel level) {
+    switch (level) {
+#if LOSSY_X86
+    case SimdLevel::AVX512: round_avx512(in, out, n, mask, noise); return;
+    case SimdLevel::AVX2: round_avx2(in, out, n, mask, noise); return;
+#endif
+    default: round_scalar(in, out, n, mask, noise); return;
+    }
+}
+
+} // namespace detail
+
+// This is to drop bits_to_zero mantissa LSBs of n floats with the given rounding, using an explicit SIMD level.
+// Stochastic rounding draws its noise from (seed, stream): give each independently rounded chunk its own stream.
+inline void round_lsb(const float *in, float *out, size_t n, int bits_to_zero, Rounding mode, SimdLevel level,
+                      uint64_t seed = kDefaultSeed, uint64_t stream = 0) {
+    if (mode == Rounding::Truncate) return mask_lsb(in, out, n, bits_to_zero, level);
+    ScopedStage stage("truncate", n, n * sizeof(float), n * sizeof(float));
+    const uint32_t mask = lsb_mask(bits_to_zero);
+    if (mask == 0xFFFFFFFFu) {
+        if (in != out) std::memcpy(out, in, n * sizeof(float));
+        return;
+    }
+    if (mode == Rounding::NearestEven) return detail::round_block(in, out, n, mask, nullptr, level);
+
+    uint32_t noise[detail::kRandomBlock];
+    const PhiloxKey id{seed, stream, detail::kRoundingSubstream};
+    for (size_t first = 0; first < n; first += detail::kRandomBlock) {
+        size_t count = std::min(detail::kRandomBlock, n - first);
+        philox_words(id, uint32_t(first / detail::kGroupWords), (count + detail::kGroupWords - 1) / detail::kGroupWords,
+                     noise);
+        detail::round_block(in + first, out + first, count, mask, noise, level);
+    }
+}
+
+// This is to round n floats on the fastest path available
+inline void round_lsb(const float *in, float *out, size_t n, int bits_to_zero, Rounding mode,
+                      uint64_t seed = kDefaultSeed, uint64_t stream = 0) {
+    round_lsb(in, out, n, bits_to_zero, mode, detect_simd(), seed, stream);
+}
+
+} // namespace lossy
@@ -0,0 +1,255 @@
+#pragma once
+
+// Byte- and bit-shuffle preconditioning filters for 4-byte elements
+// (Blosc-style), applied between LSB masking and the entropy coder.
+//
+// Byte shuffle stores byte 0 of every element, then byte 1, and so on, so the
+// zeroed low mantissa bytes become long runs of zeros and the exponent bytes
+// sit next to each other. Bit shuffle goes one step further and stores 32 bit
+// planes; bits zeroed by mask_lsb() then become whole planes of zeros.
+//
+// Layout: byte shuffle writes 4 planes of n bytes. Bit shuffle works on the
+// first n & ~7 elements and writes 32 planes of (n & ~7) / 8 bytes (plane
+// 8*b + k holds bit k of byte b, element j of a group of 8 in bit j); the
+// remaining n % 8 elements are appended unshuffled. Both are exactly
+// invertible. An AVX2 path is used when available, otherwise scalar code.
+
+#include "common.h"
+#include "profile.h"
+
+namespace lossy {
+
+enum class Shuffle { None, Byte, Bit };
+
+inline const char *shuffle_name(Shuffle mode) {
+    switch (mode) {
+    case Shuffle::Byte: return "byte";
+    case Shuffle::Bit: return "bit";
+    default: return "none";
+    }
+}
+
+namespace detail {
+
+inline void byte_shuffle4_scalar(const uint8_t *in, uint8_t *out, size_t n, size_t begin) {
+    for (size_t i = begin; i < n; i++)
+        for (size_t b = 0; b < 4; b++) out[b * n + i] = in[i * 4 + b];
+}
+
+inline void byte_unshuffle4_scalar(const uint8_t *in, uint8_t *out, size_t n, size_t begin) {
+    for (size_t i = begin; i < n; i++)
+        for (size_t b = 0; b < 4; b++) out[i * 4 + b] = in[b * n + i];
+}
+
+// Bit-transposes 8 elements starting at element i (byte planes already split)
+inline void bit_shuffle_group(const uint8_t *in, uint8_t *out, size_t plane_bytes, size_t i) {
+    for (size_t b = 0; b < 4; b++) {
+        uint8_t x[8];
+        for (size_t j = 0; j < 8; j++) x[j] = in[(i + j) * 4 + b];
+        for (size_t k = 0; k < 8; k++) {
+            uint8_t plane = 0;
+            for (size_t j = 0; j < 8; j++) plane |= uint8_t(((x[j] >> k) & 1u) << j);
+            out[(b * 8 + k) * plane_bytes + i / 8] = plane;
+        }
+    }
+}
+
+inline void bit_unshuffle_group(const uint8_t *in, uint8_t *out, size_t plane_bytes, size_t i) {
+    for (size_t b = 0; b < 4; b++) {
+        uint8_t x[8] = {};
+        for (size_t k = 0; k < 8; k++) {
+            uint8_t plane = in[(b * 8 + k) * plane_bytes + i / 8];
+            for (size_t j = 0; j < 8; j++) x[j] |= uint8_t(((plane >> j) & 1u) << k);
+        }
+        for (size_t j = 0; j < 8; j++) out[(i + j) * 4 + b] = x[j];
+    }
+}
+
+#if LOSSY_X86
+// 32 elements in a, b, c, d -> byte plane registers r[0..3] (32 bytes each)
+__attribute__((target("avx2")))
+inline void transpose_bytes_32(__m256i a, __m256i b, __m256i c, __m256i d, __m256i r[4]) {
+    const __m256i split = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                           0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    a = _mm256_shuffle_epi8(a, split);
+    b = _mm256_shuffle_epi8(b, split);
+    c = _mm256_shuffle_epi8(c, split);
+    d = _mm256_shuffle_epi8(d, split);
+    __m256i t0 = _mm256_unpacklo_epi32(a, b), t1 = _mm256_unpackhi_epi32(a, b);
+    __m256i t2 = _mm256_unpacklo_epi32(c, d), t3 = _mm256_unpackhi_epi32(c, d);
+    r[0] = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t0, t2), order);
+    r[1] = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t0, t2), order);
+    r[2] = _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t1, t3), order);
+    r[3] = _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t1, t3), order);
+}
+
+// Inverse of transpose_bytes_32: byte planes r[0..3] -> 32 elements in e[0..3]
+__attribute__((target("avx2")))
+inline void untranspose_bytes_32(const __m256i r[4], __m256i e[4]) {
+    const __m256i split = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                           0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256i unorder = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    __m256i p0 = _mm256_permutevar8x32_epi32(r[0], unorder);
+    __m256i p1 = _mm256_permutevar8x32_epi32(r[1], unorder);
+    __m256i p2 = _mm256_permutevar8x32_epi32(r[2], unorder);
+    __m256i p3 = _mm256_permutevar8x32_epi32(r[3], unorder);
+    __m256i t0 = _mm256_unpacklo_epi32(p0, p1), t1 = _mm256_unpackhi_epi32(p0, p1);
+    __m256i t2 = _mm256_unpacklo_epi32(p2, p3), t3 = _mm256_unpackhi_epi32(p2, p3);
+    e[0] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(t0, t2), split);
+    e[1] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(t0, t2), split);
+    e[2] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(t1, t3), split);
+    e[3] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(t1, t3), split);
+}
+
+__attribute__((target("avx2")))
+inline void byte_shuffle4_avx2(const uint8_t *in, uint8_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i *src = reinterpret_cast<const __m256i *>(in + i * 4);
+        __m256i r[4];
+        transpose_bytes_32(_mm256_loadu_si256(src), _mm256_loadu_si256(src + 1),
+                           _mm256_loadu_si256(src + 2), _mm256_loadu_si256(src + 3), r);
+        for (size_t b = 0; b < 4; b++) _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + b * n + i), r[b]);
+    }
+    byte_shuffle4_scalar(in, out, n, i);
+}
+
+__attribute__((target("avx2")))
+inline void byte_unshuffle4_avx2(const uint8_t *in, uint8_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i r[4], e[4];
+        for (size_t b = 0; b < 4; b++) r[b] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + b * n + i));
+        untranspose_bytes_32(r, e);
+        __m256i *dst = reinterpret_cast<__m256i *>(out + i * 4);
+        for (size_t k = 0; k < 4; k++) _mm256_storeu_si256(dst + k, e[k]);
+    }
+    byte_unshuffle4_scalar(in, out, n, i);
+}
+
+__attribute__((target("avx2")))
+inline void bit_shuffle4_avx2(const uint8_t *in, uint8_t *out, size_t n8) {
+    const size_t plane_bytes = n8 / 8;
+    size_t i = 0;
+    for (; i + 32 <= n8; i += 32) {
+        const __m256i *src = reinterpret_cast<const __m256i *>(in + i * 4);
+        __m256i r[4];
+        transpose_bytes_32(_mm256_loadu_si256(src), _mm256_loadu_si256(src + 1),
+                           _mm256_loadu_si256(src + 2), _mm256_loadu_si256(src + 3), r);
+        for (size_t b = 0; b < 4; b++) {
+            // movemask picks bit 7 of every byte; shifting left walks down to bit 0
+            __m256i v = r[b];
+            for (int k = 7; k >= 0; k--) {
+                uint32_t bits = uint32_t(_mm256_movemask_epi8(v));
+                std::memcpy(out + (b * 8 + size_t(k)) * plane_bytes + i / 8, &bits, 4);
+                v = _mm256_add_epi8(v, v);
+            }
+        }
+    }
+    for (; i < n8; i += 8) bit_shuffle_group(in, out, plane_bytes, i);
+}
+
+__attribute__((target("avx2")))
+inline void bit_unshuffle4_avx2(const uint8_t *in, uint8_t *out, size_t n8) {
+    const size_t plane_bytes = n8 / 8;
+    // Byte j of the result takes bit j % 8 of mask byte j / 8
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_set1_epi64x(int64_t(0x8040201008040201ull));
+    size_t i = 0;
+    for (; i + 32 <= n8; i += 32) {
+        __m256i r[4], e[4];
+        for (size_t b = 0; b < 4; b++) {
+            __m256i acc = _mm256_setzero_si256();
+            for (size_t k = 0; k < 8; k++) {
+                uint32_t bits;
+                std::memcpy(&bits, in + (b * 8 + k) * plane_bytes + i / 8, 4);
+                __m256i m = _mm256_shuffle_epi8(_mm256_set1_epi32(int32_t(bits)), spread);
+                m = _mm256_cmpeq_epi8(_mm256_and_si256(m, select), select);
+                acc = _mm256_or_si256(acc, _mm256_and_si256(m, _mm256_set1_epi8(char(1u << k))));
+            }
+            r[b] = acc;
+        }
+        untranspose_bytes_32(r, e);
+        __m256i *dst = reinterpret_cast<__m256i *>(out + i * 4);
+        for (size_t k = 0; k < 4; k++) _mm256_storeu_si256(dst + k, e[k]);
+    }
+    for (; i < n8; i += 8) bit_unshuffle_group(in, out, plane_bytes, i);
+}
+#endif
+
+inline bool shuffle_use_avx2() { return detect_simd() >= SimdLevel::AVX2; }
+
+} // namespace detail
+
+// This is to byte-shuffle n 4-byte elements (in and out must not overlap)
+inline void byte_shuffle4(const void *in, void *out, size_t n) {
+    const uint8_t *src = static_cast<const uint8_t *>(in);
+    uint8_t *dst = static_cast<uint8_t *>(out);
+#if LOSSY_X86
+    if (detail::shuffle_use_avx2()) return detail::byte_shuffle4_avx2(src, dst, n);
+#endif
+    detail::byte_shuffle4_scalar(src, dst, n, 0);
+}
+
+inline void byte_unshuffle4(const void *in, void *out, size_t n) {
+    const uint8_t *src = static_cast<const uint8_t *>(in);
+    uint8_t *dst = static_cast<uint8_t *>(out);
+#if LOSSY_X86
+    if (detail::shuffle_use_avx2()) return detail::byte_unshuffle4_avx2(src, dst, n);
+#endif
+    detail::byte_unshuffle4_scalar(src, dst, n, 0);
+}
+
+// This is to bit-shuffle n 4-byte elements (in and out must not overlap)
+inline void bit_shuffle4(const void *in, void *out, size_t n) {
+    const uint8_t *src = static_cast<const uint8_t *>(in);
+    uint8_t *dst = static_cast<uint8_t *>(out);
+    size_t n8 = n & ~size_t(7);
+#if LOSSY_X86
+    if (detail::shuffle_use_avx2()) {
+        detail::bit_shuffle4_avx2(src, dst, n8);
+    } else
+#endif
+    {
+        for (size_t i = 0; i < n8; i += 8) detail::bit_shuffle_group(src, dst, n8 / 8, i);
+    }
+    std::memcpy(dst + n8 * 4, src + n8 * 4, (n - n8) * 4);
+}
+
+inline void bit_unshuffle4(const void *in, void *out, size_t n) {
+    const uint8_t *src = static_cast<const uint8_t *>(in);
+    uint8_t *dst = static_cast<uint8_t *>(out);
+    size_t n8 = n & ~size_t(7);
+#if LOSSY_X86
+    if (detail::shuffle_use_avx2()) {
+        detail::bit_unshuffle4_avx2(src, dst, n8);
+    } else
+#endif
+    {
+        for (size_t i = 0; i < n8; i += 8) detail::bit_unshuffle_group(src, dst, n8 / 8, i);
+    }
+    std::memcpy(dst + n8 * 4, src + n8 * 4, (n - n8) * 4);
+}
+
+// This is to apply a filter chosen at runtime (None copies)
+inline void shuffle4(Shuffle mode, const void *in, void *out, size_t n) {
+    ScopedStage stage("shuffle", n, n * 4, n * 4);
+    switch (mode) {
+    case Shuffle::Byte: byte_shuffle4(in, out, n); return;
+    case Shuffle::Bit: bit_shuffle4(in, out, n); return;
+    default: std::memcpy(out, in, n * 4); return;
+    }
+}
+
+inline void unshuffle4(Shuffle mode, const void *in, void *out, size_t n) {
+    ScopedStage stage("unshuffle", n, n * 4, n * 4);
+    switch (mode) {
+    case Shuffle::Byte: byte_unshuffle4(in, out, n); return;
+    case Shuffle::Bit: bit_unshuffle4(in, out, n); return;
+    default: std::memcpy(out, in, n * 4); return;
+    }
+}
+
+} // namespace lossy
@@ -0,0 +1,153 @@
+#pragma once
+
+// Sign / exponent / mantissa plane split with rANS on the exponents.
+//
+// In interleaved float32 words gzip sees the exponent byte only every fourth
+// position, next to mantissa bits that are close to random, and cannot model
+// that the exponents of Gaussian or exponential data cluster around 2^0 and
+// carry just 2-4 bits of entropy. split_encode() separates a block into
+//
+//   sign plane      1 bit per value, bit-packed, then rANS (all-positive
+//                   data costs only the rANS header)
+//   exponent plane  1 byte per value, rANS (rans.h)
+//   mantissa plane  the 23 - bits_to_zero kept bits, bit-packed raw (bitpack.h)
+//
+// A plane is stored raw when rANS would not make it smaller. Decoding is
+// exact for the masked input: bits below the kept mantissa come back zero.
+//
+// Payload: SplitHeader, sign plane, exponent plane, mantissa plane. The
+// element count comes from the container chunk (or the caller).
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "bitpack.h"
+#include "common.h"
+#include "deflate.h"
+#include "rans.h"
+
+namespace lossy {
+
+enum class PlaneCoding : uint8_t { Raw = 0, Rans = 1 };
+
+#pragma pack(push, 1)
+struct SplitHeader {
+    uint8_t mantissa_bits;   // 23 - bits_to_zero
+    uint8_t sign_coding;     // PlaneCoding
+    uint8_t exponent_coding; // PlaneCoding
+    uint8_t reserved;
+    uint32_t reserved2;
+    uint64_t sign_bytes;     // stored sizes of the two entropy-coded planes
+    uint64_t exponent_bytes;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(SplitHeader) == 24, "split layout");
+
+namespace detail {
+
+constexpr size_t kSplitBlock = 4096; // a multiple of 8, so sign blocks fill whole bytes
+constexpr uint32_t kSignMask = 0x80000000u;
+
+inline uint32_t split_mantissa_mask(int mantissa_bits) {
+    return mantissa_bits ? 0x007FFFFFu & (0x007FFFFFu << (23 - mantissa_bits)) : 0;
+}
+
+// This is to append a plane, entropy-coded if that makes it smaller
+inline PlaneCoding append_plane(std::vector<unsigned char> &out, const std::vector<unsigned char> &plane,
+                                uint64_t &stored) {
+    std::vector<unsigned char> coded = rans_encode(plane);
+    const bool rans = coded.size() < plane.size();
+    const std::vector<unsigned char> &chosen = rans ? coded : plane;
+    out.insert(out.end(), chosen.begin(), chosen.end());
+    stored = chosen.size();
+    return rans ? PlaneCoding::Rans : PlaneCoding::Raw;
+}
+
+inline void read_plane(PlaneCoding coding, const unsigned char *in, size_t bytes, unsigned char *out, size_t n) {
+    if (coding == PlaneCoding::Rans) return rans_decode(in, bytes, out, n);
+    if (coding != PlaneCoding::Raw || bytes != n) throw std::runtime_error("bad split plane");
+    std::memcpy(out, in, n);
+}
+
+} // namespace detail
+
+// This is to encode n floats keeping 23 - bits_to_zero mantissa bits (the rest is truncated)
+inline std::vector<unsigned char> split_encode(const float *data, size_t n, int bits_to_zero) {
+    if (bits_to_zero < 0 || bits_to_zero > 23) throw std::runtime_error("bits_to_zero must be in [0, 23]");
+    const uint32_t *words = reinterpret_cast<const uint32_t *>(data);
+    SplitHeader h{};
+    h.mantissa_bits = uint8_t(23 - bits_to_zero);
+
+    std::vector<unsigned char> signs(packed_bytes(n, 1)), exponents(n);
+    pack_fields(words, n, detail::kSignMask, signs.data());
+    for (size_t i = 0; i < n; i++) exponents[i] = uint8_t(words[i] >> 23);
+
+    std::vector<unsigned char> out(sizeof h);
+    h.sign_coding = uint8_t(detail::append_plane(out, signs, h.sign_bytes));
+    h.exponent_coding = uint8_t(detail::append_plane(out, exponents, h.exponent_bytes));
+    if (h.mantissa_bits) {
+        size_t offset = out.size();
+        out.resize(offset + packed_bytes(n, h.mantissa_bits));
+        pack_fields(words, n, detail::split_mantissa_mask(h.mantissa_bits), out.data() + offset);
+    }
+    std::memcpy(out.data(), &h, sizeof h);
+    return out;
+}
+
+// This is to read the header of a split payload; throws if the planes do not fit in `bytes`
+inline SplitHeader split_header(const unsigned char *payload, size_t bytes, size_t n) {
+    SplitHeader h;
+    if (bytes < sizeof h) throw std::runtime_error("split payload truncated");
+    std::memcpy(&h, payload, sizeof h);
+    if (h.mantissa_bits > 23) throw std::runtime_error("bad split header");
+    const size_t mantissa = h.mantissa_bits ? packed_bytes(n, h.mantissa_bits) : 0;
+    if (h.sign_bytes > bytes || h.exponent_bytes > bytes ||
+        sizeof h + h.sign_bytes + h.exponent_bytes + mantissa != bytes)
+        throw std::runtime_error("split payload size mismatch");
+    return h;
+}
+
+// This is to decode n floats from a split_encode() payload
+inline void split_decode(const unsigned char *payload, size_t bytes, float *out, size_t n) {
+    const SplitHeader h = split_header(payload, bytes, n);
+    const unsigned char *sign_plane = payload + sizeof h;
+    const unsigned char *exponent_plane = sign_plane + h.sign_bytes;
+    const unsigned char *mantissa_plane = exponent_plane + h.exponent_bytes;
+
+    std::vector<unsigned char> signs(packed_bytes(n, 1)), exponents(n);
+    detail::read_plane(PlaneCoding(h.sign_coding), sign_plane, h.sign_bytes, signs.data(), signs.size());
+    detail::read_plane(PlaneCoding(h.exponent_coding), exponent_plane, h.exponent_bytes, exponents.data(), n);
+
+    uint32_t *words = reinterpret_cast<uint32_t *>(out);
+    if (h.mantissa_bits) {
+        unpack_fields(mantissa_plane, packed_bytes(n, h.mantissa_bits), n, detail::split_mantissa_mask(h.mantissa_bits),
+                      words);
+    } else {
+        std::fill(words, words + n, 0u);
+    }
+    // Signs are unpacked a cache-sized block at a time and merged with the exponents
+    uint32_t sign_words[detail::kSplitBlock];
+    for (size_t first = 0; first < n; first += detail::kSplitBlock) {
+        size_t count = std::min(detail::kSplitBlock, n - first);
+        unpack_fields(signs.data() + first / 8, packed_bytes(count, 1), count, detail::kSignMask, sign_words);
+        for (size_t i = 0; i < count; i++)
+            words[first + i] |= sign_words[i] | uint32_t(exponents[first + i]) << 23;
+    }
+}
+
+// This is to measure the split size and encode/decode speed of a buffer
+inline DeflateStats measure_split(const float *data, size_t n, int bits_to_zero) {
+    std::vector<unsigned char> packed;
+    std::vector<float> restored(n);
+    return measure_codec(n * sizeof(float), [&] { return (packed = split_encode(data, n, bits_to_zero)).size(); },
+                         [&] { split_decode(packed.data(), packed.size(), restored.data(), n); });
+}
+
+inline DeflateStats measure_split(const std::vector<float> &data, int bits_to_zero) {
+    return measure_split(data.data(), data.size(), bits_to_zero);
+}
+
+} // namespace lossy
@@ -0,0 +1,210 @@
+#pragma once
+
+// Out-of-core comparison of two raw float files.
+//
+// compare_files() streams an original and a reconstructed .bin file (raw
+// float32, float16 or one of the minifloats of minifloat.h, as written by
+// save_binary() and the 32-16bit tools) through the fused metrics pass one
+// block at a time, so memory use stays at a few blocks whatever the file
+// size. Files are either mmap()ed or read with pread() into page-aligned
+// buffers. In both modes the next block is prefetched (MADV_WILLNEED /
+// POSIX_FADV_WILLNEED) while the current one is summed, and finished blocks
+// are dropped again (MADV_DONTNEED / POSIX_FADV_DONTNEED). Blocks are whole
+// multiples of kMetricsPart, so the result is bit-identical to
+// compute_metrics() on the same arrays in memory.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "metrics.h"
+#include "minifloat.h"
+
+namespace lossy {
+
+struct StreamOptions {
+    size_t block_elements = 16 * kMetricsPart; // rounded up to whole kMetricsPart
+    bool use_mmap = true;                       // false: pread() into aligned buffers
+};
+
+// Sequential block reader over a raw file of any Precision; every block comes back as float32
+class FloatFileStream {
+public:
+    FloatFileStream(const std::string &filename, Precision precision, size_t block_elements, bool use_mmap)
+        : precision_(precision), elem_bytes_(precision_bytes(precision)) {
+        block_ = std::max(kMetricsPart, (block_elements + kMetricsPart - 1) / kMetricsPart * kMetricsPart);
+        fd_ = ::open(filename.c_str(), O_RDONLY);
+        if (fd_ < 0) throw std::runtime_error("cannot open " + filename);
+        struct stat st;
+        if (::fstat(fd_, &st) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("cannot stat " + filename);
+        }
+        bytes_ = size_t(st.st_size);
+        if (bytes_ % elem_bytes_ != 0) {
+            ::close(fd_);
+            throw std::runtime_error("file size is not a whole number of values: " + filename);
+        }
+        elements_ = bytes_ / elem_bytes_;
+
+        if (use_mmap && bytes_ > 0) {
+            void *p = ::mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (p != MAP_FAILED) {
+                map_ = static_cast<const unsigned char *>(p);
+                ::madvise(p, bytes_, MADV_SEQUENTIAL);
+            }
+        }
+        if (!map_) {
+            ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+            raw_ = aligned_buffer(block_ * elem_bytes_);
+        }
+        if (precision_ != Precision::Float32) floats_ = aligned_buffer(block_ * sizeof(float));
+        prefetch(0);
+    }
+
+    ~FloatFileStream() {
+        if (map_) ::munmap(const_cast<unsigned char *>(map_), bytes_);
+        ::close(fd_);
+    }
+    FloatFileStream(const FloatFileStream &) = delete;
+    FloatFileStream &operator=(const FloatFileStream &) = delete;
+
+    size_t size() const { return elements_; }
+    size_t block_elements() const { return block_; }
+    bool mapped() const { return map_ != nullptr; }
+
+    // This is to get the next block as float32 (count values); returns nullptr at the end
+    const float *next(size_t &count) {
+        if (cursor_ > 0) release(cursor_ - last_count_, last_count_);
+        if (cursor_ >= elements_) {
+            count = 0;
+            return nullptr;
+        }
+        count = std::min(block_, elements_ - cursor_);
+        prefetch(cursor_ + count);
+
+        const size_t offset = cursor_ * elem_bytes_, length = count * elem_bytes_;
+        const unsigned char *src = map_ ? map_ + offset : raw_.get();
+        if (!map_) read_exact(raw_.get(), length, offset);
+        cursor_ += count;
+        last_count_ = count;
+
+        if (precision_ == Precision::Float32) return reinterpret_cast<const float *>(src);
+        float *out = reinterpret_cast<float *>(floats_.get());
+        decode_precision(precision_, src, out, count);
+        return out;
+    }
+
+private:
+    using Buffer = std::unique_ptr<unsigned char, decltype(&std::free)>;
+
+    static Buffer aligned_buffer(size_t bytes) {
+        constexpr size_t kAlign = 4096; // page aligned, as O_DIRECT-style readers want
+        void *p = std::aligned_alloc(kAlign, (bytes + kAlign - 1) / kAlign * kAlign);
+        if (!p) throw std::bad_alloc();
+        return Buffer(static_cast<unsigned char *>(p), &std::free);
+    }
+
+    void read_exact(unsigned char *dst, size_t length, size_t offset) {
+        while (length > 0) {
+            ssize_t got = ::pread(fd_, dst, length, off_t(offset));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) throw std::runtime_error("read failed");
+            dst += got;
+            offset += size_t(got);
+            length -= size_t(got);
+        }
+    }
+
+    // This is to ask the kernel to start reading the block at `first` ahead of time
+    void prefetch(size_t first) {
+        if (first >= elements_) return;
+        size_t offset = first * elem_bytes_;
+        size_t length = std::min(block_, elements_ - first) * elem_bytes_;
+        if (map_) {
+            size_t start = page_floor(offset);
+            ::madvise(const_cast<unsigned char *>(map_) + start, offset + length - start, MADV_WILLNEED);
+        } else {
+            ::posix_fadvise(fd_, off_t(offset), off_t(length), POSIX_FADV_WILLNEED);
+        }
+    }
+
+    // This is to drop a finished block so resident memory stays bounded
+    void release(size_t first, size_t count) {
+        size_t offset = first * elem_bytes_, end = offset + count * elem_bytes_;
+        if (map_) {
+            // Only whole pages that do not reach into the next block
+            size_t start = page_floor(offset), stop = end == bytes_ ? end : page_floor(end);
+            if (stop > start) ::madvise(const_cast<unsigned char *>(map_) + start, stop - start, MADV_DONTNEED);
+        } else {
+            ::posix_fadvise(fd_, off_t(offset), off_t(end - offset), POSIX_FADV_DONTNEED);
+        }
+    }
+
+    static size_t page_floor(size_t offset) {
+        static const size_t page = size_t(::sysconf(_SC_PAGESIZE));
+        return offset / page * page;
+    }
+
+    Precision precision_;
+    size_t elem_bytes_;
+    size_t block_ = 0;
+    int fd_ = -1;
+    size_t bytes_ = 0;
+    size_t elements_ = 0;
+    size_t cursor_ = 0;
+    size_t last_count_ = 0;
+    const unsigned char *map_ = nullptr;
+    Buffer raw_{nullptr, &std::free};
+    Buffer floats_{nullptr, &std::free};
+};
+
+namespace detail {
+
+inline ErrorMetrics compare_files(const std::string &original, Precision original_precision,
+                                  const std::string &reconstructed, Precision reconstructed_precision,
+                                  const StreamOptions &opt, ThreadPool *pool) {
+    FloatFileStream a(original, original_precision, opt.block_elements, opt.use_mmap);
+    FloatFileStream b(reconstructed, reconstructed_precision, opt.block_elements, opt.use_mmap);
+    if (a.size() != b.size())
+        throw std::runtime_error("element counts differ: " + std::to_string(a.size()) + " vs " +
+                                 std::to_string(b.size()));
+    MetricsAccumulator total;
+    size_t na = 0, nb = 0;
+    for (;;) {
+        const float *pa = a.next(na);
+        const float *pb = b.next(nb);
+        if (!pa || !pb) break;
+        if (pool) {
+            accumulate_metrics(total, pa, pb, na, *pool);
+        } else {
+            accumulate_metrics(total, pa, pb, na);
+        }
+    }
+    return total.result();
+}
+
+} // namespace detail
+
+// This is to compute the metrics of two files in bounded memory
+inline ErrorMetrics compare_files(const std::string &original, Precision original_precision,
+                                  const std::string &reconstructed, Precision reconstructed_precision,
+                                  const StreamOptions &opt = StreamOptions()) {
+    return detail::compare_files(original, original_precision, reconstructed, reconstructed_precision, opt, nullptr);
+}
+
+inline ErrorMetrics compare_files(const std::string &original, Precision original_precision,
+                                  const std::string &reconstructed, Precision reconstructed_precision,
+                                  ThreadPool &pool, const StreamOptions &opt = StreamOptions()) {
+    return detail::compare_files(original, original_precision, reconstructed, reconstructed_precision, opt, &pool);
+}
+
+} // namespace lossy
@@ -0,0 +1,315 @@
+#pragma once
+
+// Bounded-memory streaming generate -> truncate -> encode -> write pipeline.
+//
+// stream_to_container() writes n values from a block source to a container
+// without ever holding the array. One container chunk is one block, and a
+// block moves through four stages:
+//
+//   source    a thread filling the block (e.g. a BlockGenerator)
+//   truncate  a thread running truncate_chunk() and, optionally, the metrics
+//   encode    encode_truncated_chunk() on the ThreadPool, window blocks at once
+//   write     the calling thread, appending the chunks in order
+//
+// Stages hand blocks over through BoundedQueues, and blocks come back to the
+// source once written, so at most StreamPipelineOptions::blocks() blocks
+// (plus their encoded payloads) exist whatever n is: a 10^10-value run
+// needs the same few MB as a 10^6 one, and each block is still in cache when
+// the next stage picks it up. A block is truncated and encoded exactly as
+// encode_chunk() would, so the file is byte-identical to ContainerWriter::
+// write() or write_parallel() of the whole array, for any thread count. The
+// metrics are folded in kMetricsPart parts and are bit-identical to
+// compute_metrics() on the array and its reconstruction when chunk_elements
+// is a multiple of 4096 (BlockGenerator needs a multiple of kRandomChunk).
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "container.h"
+#include "distributions.h"
+#include "metrics.h"
+#include "minifloat.h"
+#include "thread_pool.h"
+
+namespace lossy {
+
+// Blocking FIFO of at most `capacity` items between two stages
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(capacity, 1)) {}
+
+    // This is to append an item, waiting for room; returns false once the queue is closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return closed_ || items_.size() < capacity_; });
+        if (closed_) return false;
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // This is to take the oldest item, waiting for one; returns false when closed and drained
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return closed_ || !items_.empty(); });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // This is to end the stream: pop() drains what is left, push() fails
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+};
+
+struct StreamPipelineOptions {
+    size_t queue_depth = 2; // blocks waiting between source and truncate, and between truncate and encode
+    size_t window = 0;      // blocks encoding at once (0 = two per pool thread)
+    bool metrics = true;    // fold the error metrics of every block
+
+    // This is the most blocks that exist at once for a pool of `threads`
+    size_t blocks(size_t threads) const { return 2 + 2 * queue_depth + (window ? window : 2 * threads); }
+};
+
+struct StreamPipelineStats {
+    uint64_t elements = 0;
+    uint64_t bytes_written = 0;
+    size_t chunks = 0;
+    ErrorMetrics metrics;               // count 0 unless StreamPipelineOptions::metrics
+    size_t blocks = 0;                  // blocks allocated
+    size_t block_bytes = 0;             // their buffers (original and truncated values)
+    size_t peak_payload_bytes = 0;      // most encoded payload bytes alive at once
+    double seconds = 0.0;
+    // Busy time of each stage (encode summed over the pool); the largest one limits the pipeline
+    double source_seconds = 0.0, truncate_seconds = 0.0, encode_seconds = 0.0, write_seconds = 0.0;
+
+    double mbps() const { return seconds > 0 ? elements * sizeof(float) / 1e6 / seconds : 0.0; }
+};
+
+namespace detail {
+
+struct StreamBlock {
+    uint64_t first = 0;
+    size_t count = 0;
+    int bits_kept = 0;
+    double encode_seconds = 0.0;
+    std::vector<float> values;    // as produced by the source
+    std::vector<float> truncated; // as the codec stores them
+};
+
+// Folds consecutive ranges into kMetricsPart parts the way compute_metrics() splits the array
+class PartMetrics {
+public:
+    explicit PartMetrics(float clip) : total_(clip), part_(clip) {}
+
+    void add(const float *original, const float *reconstructed, size_t n, uint64_t first) {
+        while (n > 0) {
+            size_t take = std::min<uint64_t>(n, kMetricsPart - first % kMetricsPart);
+            part_.add(original, reconstructed, take);
+            original += take;
+            reconstructed += take;
+            n -= take;
+            first += take;
+            if (first % kMetricsPart == 0) {
+                total_.merge(part_);
+                part_ = MetricsAccumulator(total_.clip_limit());
+            }
+        }
+    }
+
+    ErrorMetrics result() {
+        total_.merge(part_);
+        part_ = MetricsAccumulator(total_.clip_limit());
+        return total_.result();
+    }
+
+private:
+    MetricsAccumulator total_, part_;
+};
+
+} // namespace detail
+
+// This is to stream n values from source(out, count) into writer; source is called with
+// consecutive blocks of writer.options().chunk_elements values (the last may be shorter)
+inline StreamPipelineStats stream_to_container(ContainerWriter &writer, uint64_t n,
+                                               const std::function<void(float *, size_t)> &source, ThreadPool &pool,
+                                               const StreamPipelineOptions &sopt = {}) {
+    using Clock = std::chrono::steady_clock;
+    using detail::StreamBlock;
+    auto since = [](Clock::time_point t) { return std::chrono::duration<double>(Clock::now() - t).count(); };
+    if (writer.has_pending()) throw std::runtime_error("stream_to_container needs a writer without buffered values");
+    const ContainerOptions &opt = writer.options();
+    const size_t chunk = opt.chunk_elements;
+    const uint64_t base = writer.elements_written();
+    const size_t max_blocks = sopt.blocks(pool.size());
+    const size_t window = max_blocks - 2 - 2 * sopt.queue_depth;
+
+    StreamPipelineStats stats;
+    stats.elements = n;
+    uint64_t start_bytes = writer.bytes_written();
+    auto t0 = Clock::now();
+
+    // Written blocks go back to the source; the source allocates until max_blocks exist
+    std::vector<std::unique_ptr<StreamBlock>> storage;
+    BoundedQueue<StreamBlock *> free_blocks(max_blocks), filled(sopt.queue_depth), truncated(sopt.queue_depth);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto fail = [&](std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = e;
+        }
+        free_blocks.close();
+        filled.close();
+        truncated.close();
+    };
+
+    std::thread source_thread([&] {
+        try {
+            for (uint64_t first = 0; first < n; first += chunk) {
+                StreamBlock *block = nullptr;
+                if (storage.size() < max_blocks) {
+                    storage.push_back(std::make_unique<StreamBlock>());
+                    block = storage.back().get();
+                    block->values.resize(chunk);
+                    block->truncated.resize(chunk);
+                } else if (!free_blocks.pop(block)) {
+                    return;
+                }
+                auto t = Clock::now();
+                block->first = base + first;
+                block->count = size_t(std::min<uint64_t>(chunk, n - first));
+                source(block->values.data(), block->count);
+                stats.source_seconds += since(t);
+                if (!filled.push(block)) return;
+            }
+            filled.close();
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    });
+
+    std::thread truncate_thread([&] {
+        try {
+            // Other precisions are converted by the codec; their metrics compare against a round trip
+            const bool convert = opt.precision != Precision::Float32;
+            detail::PartMetrics metrics(precision_max(opt.precision));
+            std::vector<unsigned char> raw(convert && sopt.metrics ? chunk * precision_bytes(opt.precision) : 0);
+            std::vector<float> reconstructed(convert && sopt.metrics ? chunk : 0);
+            StreamBlock *block = nullptr;
+            while (filled.pop(block)) {
+                auto t = Clock::now();
+                block->bits_kept = truncate_chunk(block->values.data(), block->truncated.data(), block->count,
+                                                  block->first, opt);
+                if (sopt.metrics) {
+                    const float *r = block->truncated.data();
+                    if (convert) {
+                        encode_precision(opt.precision, block->values.data(), raw.data(), block->count);
+                        decode_precision(opt.precision, raw.data(), reconstructed.data(), block->count);
+                        r = reconstructed.data();
+                    }
+                    metrics.add(block->values.data(), r, block->count, block->first - base);
+                }
+                stats.truncate_seconds += since(t);
+                if (!truncated.push(block)) return;
+            }
+            if (sopt.metrics) stats.metrics = metrics.result();
+            truncated.close();
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    });
+
+    // Encoding on the pool, writing here in block order, as write_parallel() does
+    struct InFlight {
+        StreamBlock *block;
+        std::future<EncodedChunk> chunk;
+    };
+    std::deque<InFlight> in_flight;
+    std::atomic<size_t> payload_bytes{0}, peak_payload{0};
+    try {
+        bool more = true;
+        while (true) {
+            while (more && in_flight.size() < window) {
+                StreamBlock *block = nullptr;
+                if (!truncated.pop(block)) {
+                    more = false;
+                    break;
+                }
+                in_flight.push_back({block, pool.submit_future([block, &opt, &payload_bytes, &peak_payload, since] {
+                                         auto t = Clock::now();
+                                         EncodedChunk c = encode_truncated_chunk(block->truncated.data(), block->count,
+                                                                                 block->first, block->bits_kept, opt);
+                                         block->encode_seconds = since(t);
+                                         size_t live = payload_bytes += c.payload.size();
+                                         size_t peak = peak_payload.load();
+                                         while (live > peak && !peak_payload.compare_exchange_weak(peak, live)) {
+                                         }
+                                         return c;
+                                     })});
+            }
+            if (in_flight.empty()) break;
+            // Out of the deque first, so the catch below only sees futures not yet consumed
+            InFlight front = std::move(in_flight.front());
+            in_flight.pop_front();
+            EncodedChunk encoded = front.chunk.get();
+            stats.encode_seconds += front.block->encode_seconds;
+            auto t = Clock::now();
+            writer.write_encoded(encoded);
+            stats.write_seconds += since(t);
+            payload_bytes -= encoded.payload.size();
+            stats.chunks++;
+            free_blocks.push(front.block);
+        }
+    } catch (...) {
+        // Nothing here may throw: both threads must be joined before the error goes up
+        fail(std::current_exception());
+        for (InFlight &f : in_flight)
+            if (f.chunk.valid()) f.chunk.wait();
+    }
+    source_thread.join();
+    truncate_thread.join();
+    if (error) std::rethrow_exception(error);
+
+    stats.seconds = since(t0);
+    stats.bytes_written = writer.bytes_written() - start_bytes;
+    stats.blocks = storage.size();
+    stats.block_bytes = stats.blocks * 2 * chunk * sizeof(float);
+    stats.peak_payload_bytes = peak_payload.load();
+    return stats;
+}
+
+// This is to stream n values of Dist (the data of generate<float, Dist>(n, seed)) into writer
+template <typename Dist>
+StreamPipelineStats stream_generated(ContainerWriter &writer, uint64_t n, uint64_t seed, ThreadPool &pool,
+                                     const StreamPipelineOptions &sopt = {}) {
+    BlockGenerator<float, Dist> generator(seed);
+    return stream_to_container(writer, n, [&](float *out, size_t count) { generator.next(out, count); }, pool, sopt);
+}
+
+} // namespace lossy
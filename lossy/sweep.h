@@ -0,0 +1,206 @@
+#pragma once
+
+// Parametric sweep: one measured row per (distribution, N, bits_to_zero,
+// codec, threads) configuration, written as CSV and JSON.
+//
+// run_sweep_point() encodes a dataset chunk by chunk on a ThreadPool with
+// the container codecs, decodes it again and records the size ratio, the
+// error metrics of the round trip and the encode/decode throughput (best of
+// a few repetitions). Rows are stored with the CSV/JSON helpers of
+// results.h, so plots and reports are generated from measurements instead of
+// numbers copied from console output.
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "compressor.h"
+#include "container.h"
+#include "results.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+namespace lossy {
+
+// A named container configuration (codec + filter + storage precision)
+struct CodecConfig {
+    std::string name;
+    ContainerOptions options;
+};
+
+// This is to list the codec names understood by parse_codec_config() at their default levels
+inline std::vector<std::string> codec_config_names() {
+    std::vector<std::string> names{"raw", "gorilla", "bitpack", "split", "f16", "bf16", "e8m15", "e5m2", "e4m3"};
+    for (const std::string &backend : compressor_backends()) {
+        names.push_back(backend);
+        for (const char *prefix : {"shuffle-", "bitshuffle-", "f16-", "bf16-", "e8m15-", "e5m2-", "e4m3-"})
+            names.push_back(prefix + backend);
+    }
+    return names;
+}
+
+// Codec names: raw, gorilla, bitpack, split, or [<filter>-]<backend>[@level] where the backend is one of
+// compressor_backends() and the filter is shuffle/bitshuffle (float32) or a storage format (f16, bf16, e8m15,
+// e5m2, e4m3). A storage format alone is stored raw. A float32 name may end in ":rne" or ":stochastic" to round
+// instead of truncate.
+inline CodecConfig parse_codec_config(const std::string &full_name) {
+    CodecConfig c;
+    c.name = full_name;
+    ContainerOptions &o = c.options;
+    size_t colon = full_name.find(':');
+    std::string name = full_name.substr(0, colon);
+    if (colon != std::string::npos) o.rounding = parse_rounding(full_name.substr(colon + 1));
+    size_t at = name.find('@');
+    const std::string level = at == std::string::npos ? "" : name.substr(at + 1);
+    name = name.substr(0, at);
+
+    o.shuffle = Shuffle::None;
+    if (name == "raw") {
+        o.codec = Codec::Raw;
+    } else if (name == "gorilla") {
+        o.codec = Codec::Gorilla;
+    } else if (name == "bitpack") {
+        o.codec = Codec::BitPack;
+    } else if (name == "split") {
+        o.codec = Codec::Split;
+    } else {
+        // The longest backend name the codec name ends with; what precedes it is the filter
+        std::string backend, filter = name;
+        for (const std::string candidate : {"gzip", "zstd", "zstd-long", "lz4", "lz4hc", "libdeflate"}) {
+            const std::string suffix = "-" + candidate;
+            const bool bare = name == candidate;
+            const bool filtered = name.size() > suffix.size() &&
+                                  name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+            if ((bare || filtered) && candidate.size() > backend.size()) {
+                backend = candidate;
+                filter = bare ? "" : name.substr(0, name.size() - suffix.size());
+            }
+        }
+        if (filter == "shuffle") {
+            o.shuffle = Shuffle::Byte;
+        } else if (filter == "bitshuffle") {
+            o.shuffle = Shuffle::Bit;
+        } else if (!filter.empty()) {
+            try {
+                o.precision = parse_precision(filter);
+            } catch (const std::runtime_error &) {
+                throw std::runtime_error("unknown codec: " + name);
+            }
+            if (o.precision == Precision::Float32) throw std::runtime_error("unknown codec: " + name);
+        }
+        if (backend.empty()) {
+            o.codec = Codec::Raw;
+        } else {
+            if (!compressor_available(backend))
+                throw std::runtime_error(backend + " support is not compiled in: " + full_name);
+            o.long_window = backend == "zstd-long";
+            if (o.long_window) backend = "zstd";
+            for (Codec codec : {Codec::Gzip, Codec::Zstd, Codec::Lz4, Codec::Lz4HC, Codec::Libdeflate})
+                if (backend == codec_backend(codec)) o.codec = codec;
+            if (!level.empty()) {
+                size_t used = 0;
+                try {
+                    o.level = std::stoi(level, &used);
+                } catch (const std::exception &) {
+                    used = 0;
+                }
+                if (used != level.size()) throw std::runtime_error("bad level in codec: " + full_name);
+                make_compressor(backend, o.level); // checks the range
+            }
+        }
+    }
+    if (!level.empty() && codec_backend(o.codec) == nullptr)
+        throw std::runtime_error("only lossless backends take a level: " + full_name);
+    if (o.precision != Precision::Float32 && o.rounding != Rounding::Truncate)
+        throw std::runtime_error("format conversion always rounds to nearest-even: " + full_name);
+    return c;
+}
+
+// This is to expand a level range in a codec name: "zstd@1..19" gives zstd@1 ... zstd@19, "lz4hc@all" every
+// level of the backend. Other names come back unchanged.
+inline std::vector<std::string> expand_codec_levels(const std::string &full_name) {
+    size_t at = full_name.find('@');
+    if (at == std::string::npos) return {full_name};
+    size_t colon = full_name.find(':', at);
+    const std::string head = full_name.substr(0, at + 1);
+    const std::string level = full_name.substr(at + 1, colon == std::string::npos ? std::string::npos : colon - at - 1);
+    const std::string tail = colon == std::string::npos ? "" : full_name.substr(colon);
+
+    int lowest, highest;
+    size_t dots = level.find("..");
+    if (level == "all") {
+        // The backend is whatever parse_codec_config() finds; it checks the name as well
+        CodecConfig probe = parse_codec_config(head.substr(0, at) + tail);
+        std::string backend = codec_backend(probe.options.codec);
+        if (probe.options.long_window) backend += "-long";
+        std::tie(lowest, highest) = level_range(backend);
+    } else if (dots != std::string::npos) {
+        try {
+            lowest = std::stoi(level.substr(0, dots));
+            highest = std::stoi(level.substr(dots + 2));
+        } catch (const std::exception &) {
+            throw std::runtime_error("bad level range in codec: " + full_name);
+        }
+    } else {
+        return {full_name};
+    }
+    std::vector<std::string> names;
+    for (int l = lowest; l <= highest; l++) names.push_back(head + std::to_string(l) + tail);
+    return names;
+}
+
+// This is to measure one configuration; best-of-`repetitions` timing, metrics from the last round trip
+inline SweepResult run_sweep_point(const std::string &distribution, const std::vector<float> &data,
+                                   int bits_to_zero, const CodecConfig &codec, ThreadPool &pool,
+                                   int repetitions = 3) {
+    using Clock = std::chrono::steady_clock;
+    ContainerOptions opt = codec.options;
+    opt.bits_to_zero = bits_to_zero;
+    const size_t n = data.size();
+    const size_t chunks = (n + opt.chunk_elements - 1) / opt.chunk_elements;
+
+    std::vector<EncodedChunk> encoded(chunks);
+    std::vector<float> decoded(n);
+    double encode_s = 1e300, decode_s = 1e300;
+    for (int r = 0; r < std::max(1, repetitions); r++) {
+        auto t0 = Clock::now();
+        parallel_for(pool, chunks, [&](size_t c) {
+            size_t first = c * opt.chunk_elements;
+            encoded[c] = encode_chunk(data.data() + first, std::min(opt.chunk_elements, n - first), first, opt);
+        });
+        auto t1 = Clock::now();
+        parallel_for(pool, chunks, [&](size_t c) {
+            decode_chunk(encoded[c].header, encoded[c].payload.data(), decoded.data() + encoded[c].header.first_element);
+        });
+        auto t2 = Clock::now();
+        encode_s = std::min(encode_s, std::chrono::duration<double>(t1 - t0).count());
+        decode_s = std::min(decode_s, std::chrono::duration<double>(t2 - t1).count());
+    }
+
+    SweepResult r;
+    r.distribution = distribution;
+    r.n = n;
+    // A narrower format keeps its own mantissa width whatever was asked for (float16: 10 of 23 bits)
+    r.bits_to_zero = opt.precision == Precision::Float32 ? bits_to_zero : 23 - precision_mantissa_bits(opt.precision);
+    r.codec = codec.name;
+    r.threads = pool.size();
+    r.raw_bytes = n * sizeof(float);
+    // Size of the .lfc file these chunks would make
+    r.compressed_bytes = sizeof(FileHeader) + sizeof(Footer);
+    for (const EncodedChunk &c : encoded) r.compressed_bytes += sizeof(ChunkHeader) + sizeof(IndexEntry) + c.payload.size();
+    r.ratio = double(r.raw_bytes) / r.compressed_bytes;
+    ErrorMetrics m = compute_metrics(data, decoded, pool, precision_max(opt.precision));
+    r.mse = m.mse;
+    r.mae = m.mae;
+    r.max_abs_error = m.max_abs_error;
+    r.psnr = m.psnr;
+    r.encode_mbps = r.raw_bytes / 1e6 / encode_s;
+    r.decode_mbps = r.raw_bytes / 1e6 / decode_s;
+    r.clipped = m.overflowed + m.underflowed;
+    return r;
+}
+
+} // namespace lossy
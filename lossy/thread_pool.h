@@ -0,0 +1,194 @@
+#pragma once
+
+// Work-stealing thread pool.
+//
+// Every worker owns a deque: it pops its own tasks LIFO (cache-warm) and,
+// when that runs dry, steals FIFO from the other workers. Tasks submitted
+// from outside the pool are spread round-robin over the deques. Each worker
+// records how long it spent running tasks, so stats() shows busy vs idle
+// time per thread and where scaling stops.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lossy {
+
+struct WorkerStats {
+    uint64_t tasks = 0;
+    uint64_t steals = 0;
+    double busy_seconds = 0.0;
+    double idle_seconds = 0.0;
+};
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < threads; i++) workers_.push_back(std::make_unique<Worker>());
+        epoch_ = Clock::now();
+        for (size_t i = 0; i < threads; i++) threads_.emplace_back([this, i] { run(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        sleep_cv_.notify_all();
+        for (std::thread &t : threads_) t.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // This is to queue a task; tasks must not throw (use submit_future for results/errors)
+    void submit(std::function<void()> task) {
+        size_t target = (current_pool() == this) ? current_index()
+                                                 : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        // Count first so pending_ never drops below the number of queued tasks
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            pending_++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+            workers_[target]->queue.push_back(std::move(task));
+        }
+        sleep_cv_.notify_one();
+    }
+
+    // This is to queue a task and get its result (or exception) through a future
+    template <typename Fn>
+    auto submit_future(Fn fn) -> std::future<decltype(fn())> {
+        using R = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::move(fn));
+        std::future<R> result = task->get_future();
+        submit([task] { (*task)(); });
+        return result;
+    }
+
+    // Busy/idle time per worker since construction or the last reset_stats()
+    std::vector<WorkerStats> stats() const {
+        double elapsed = std::chrono::duration<double>(Clock::now() - epoch_).count();
+        std::vector<WorkerStats> out(workers_.size());
+        for (size_t i = 0; i < workers_.size(); i++) {
+            out[i].tasks = workers_[i]->tasks.load();
+            out[i].steals = workers_[i]->steals.load();
+            out[i].busy_seconds = workers_[i]->busy_ns.load() * 1e-9;
+            out[i].idle_seconds = std::max(0.0, elapsed - out[i].busy_seconds);
+        }
+        return out;
+    }
+
+    void reset_stats() {
+        for (auto &w : workers_) {
+            w->tasks = 0;
+            w->steals = 0;
+            w->busy_ns = 0;
+        }
+        epoch_ = Clock::now();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> queue;
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busy_ns{0};
+    };
+
+    static ThreadPool *&current_pool() {
+        static thread_local ThreadPool *pool = nullptr;
+        return pool;
+    }
+
+    static size_t &current_index() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    bool pop_local(size_t i, std::function<void()> &task) {
+        std::lock_guard<std::mutex> lock(workers_[i]->mutex);
+        if (workers_[i]->queue.empty()) return false;
+        task = std::move(workers_[i]->queue.back());
+        workers_[i]->queue.pop_back();
+        return true;
+    }
+
+    bool steal(size_t thief, std::function<void()> &task) {
+        for (size_t k = 1; k < workers_.size(); k++) {
+            Worker &victim = *workers_[(thief + k) % workers_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.queue.empty()) continue;
+            task = std::move(victim.queue.front());
+            victim.queue.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t i) {
+        current_pool() = this;
+        current_index() = i;
+        Worker &self = *workers_[i];
+        for (;;) {
+            std::function<void()> task;
+            bool stolen = false;
+            if (!pop_local(i, task)) stolen = steal(i, task);
+            if (task) {
+                {
+                    std::lock_guard<std::mutex> lock(sleep_mutex_);
+                    pending_--;
+                }
+                auto t0 = Clock::now();
+                task();
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+                self.busy_ns.fetch_add(uint64_t(ns), std::memory_order_relaxed);
+                self.tasks.fetch_add(1, std::memory_order_relaxed);
+                if (stolen) self.steals.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.wait(lock, [this] { return stop_ || pending_ > 0; });
+            if (stop_ && pending_ == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    size_t pending_ = 0; // queued but not yet started, guarded by sleep_mutex_
+    bool stop_ = false;
+    Clock::time_point epoch_;
+};
+
+// This is to run fn(i) for i in [0, n) on the pool and wait; rethrows the first error.
+// Call it from outside the pool: a worker blocked here does not run other tasks.
+template <typename Fn>
+void parallel_for(ThreadPool &pool, size_t n, Fn fn) {
+    std::vector<std::future<void>> done;
+    done.reserve(n);
+    for (size_t i = 0; i < n; i++) done.push_back(pool.submit_future([&fn, i] { fn(i); }));
+    for (auto &f : done) f.wait();
+    for (auto &f : done) f.get();
+}
+
+} // namespace lossy
@@ -0,0 +1,124 @@
+// Storage Savings vs. MSE for one distribution of a sweep CSV, with the Pareto front and the chosen setting.
+//
+// Usage: ./sweet_spot [sweep.csv] [distribution] [max_mse] [min_encode_mbps]
+//
+// Rows are measured by benchmarks/sweep (./sweep --out sweep writes sweep.csv). The selected
+// setting is the smallest output with MSE < max_mse and encode >= min_encode_mbps (lossy/pareto.h).
+// The plot goes to sweet_spot_<distribution>.png.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <TCanvas.h>
+#include <TGraph.h>
+#include <TAxis.h>
+#include <TLatex.h>
+#include <TMarker.h>
+#include <TLegend.h>
+#include <TStyle.h>
+#include "lossy/pareto.h"
+
+// MSE is drawn on a log axis, so lossless settings are placed at this floor
+const double mseFloor = 1e-16;
+
+// This is to convert a compression ratio into storage savings (%)
+double storageSavings(const lossy::SweepResult& r) {
+    return 100.0 * (1.0 - 1.0 / r.ratio);
+}
+
+std::string settingName(const lossy::SweepResult& r) {
+    if (r.codec.rfind("f16", 0) == 0) return r.codec;
+    return r.codec + " " + std::to_string(r.bits_to_zero) + "b";
+}
+
+// This is to Plot Storage Savings vs MSE with the computed Pareto front and the selected setting
+void plotSweetSpot(const std::string& distribution, const std::vector<lossy::SweepResult>& rows,
+                   const std::vector<size_t>& front, int bestIndex) {
+    TCanvas* c3 = new TCanvas("c3", "Storage Savings vs MSE (Pareto Front)", 800, 600);
+    TGraph* all = new TGraph(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        all->SetPoint(i, rows[i].mse + mseFloor, storageSavings(rows[i]));
+    }
+    TGraph* frontier = new TGraph(front.size());
+    for (size_t k = 0; k < front.size(); k++) {
+        frontier->SetPoint(k, rows[front[k]].mse + mseFloor, storageSavings(rows[front[k]]));
+    }
+
+    c3->SetLogx();
+    all->SetTitle(Form("Storage Savings (%%) vs. MSE, %s (Pareto Front Highlighted)", distribution.c_str()));
+    all->GetXaxis()->SetTitle("Mean Squared Error (MSE) [Log Scale]");
+    all->GetYaxis()->SetTitle("Storage Savings (%)");
+    all->SetMarkerStyle(24);
+    all->SetMarkerColor(kGray + 1);
+    all->Draw("AP");
+    frontier->SetMarkerStyle(21);
+    frontier->SetMarkerColor(kBlue);
+    frontier->SetLineColor(kBlue);
+    frontier->Draw("PL SAME");
+
+    TLegend* legend = new TLegend(0.12, 0.7, 0.5, 0.88);
+    legend->AddEntry(all, "Measured settings", "P");
+    legend->AddEntry(frontier, "Pareto front (savings vs MSE)", "LP");
+    if (bestIndex >= 0) {
+        const lossy::SweepResult& best = rows[bestIndex];
+        TMarker* sweetSpot = new TMarker(best.mse + mseFloor, storageSavings(best), 29);
+        sweetSpot->SetMarkerColor(kRed);
+        sweetSpot->SetMarkerSize(2.0);
+        sweetSpot->Draw();
+        legend->AddEntry(sweetSpot, Form("Selected: %s", settingName(best).c_str()), "P");
+    }
+    legend->Draw();
+
+    // This is to Label the front, alternating offsets to reduce clutter
+    for (size_t k = 0; k < front.size(); k++) {
+        const lossy::SweepResult& r = rows[front[k]];
+        double y_offset = (k % 2 == 0) ? 1.5 : -2.5;
+        TLatex* tex = new TLatex((r.mse + mseFloor) * 1.3, storageSavings(r) + y_offset, settingName(r).c_str());
+        tex->SetTextSize(0.02);
+        tex->Draw();
+    }
+
+    c3->SaveAs(Form("sweet_spot_%s.png", distribution.c_str()));
+}
+
+int main(int argc, char** argv) {
+    gStyle->SetOptStat(0);
+    std::string file = argc > 1 ? argv[1] : "sweep.csv";
+    std::string distribution = argc > 2 ? argv[2] : "gaussian";
+
+    lossy::Constraints scope;
+    scope.distribution = distribution;
+    std::vector<lossy::SweepResult> rows = lossy::filter_rows(lossy::read_sweep_csv(file), scope);
+    if (rows.empty()) {
+        std::cerr << "No " << distribution << " rows in " << file << std::endl;
+        return 1;
+    }
+    // This is to Keep one thread count (the largest measured), so every setting appears once
+    size_t threads = 0;
+    for (const lossy::SweepResult& r : rows) threads = std::max(threads, r.threads);
+    scope.threads = threads;
+    rows = lossy::filter_rows(rows, scope);
+
+    // The plot shows the two-objective front; speed limits are applied by the query
+    std::vector<size_t> front = lossy::pareto_front(rows, {lossy::Objective::Ratio, lossy::Objective::MSE});
+
+    lossy::Constraints limits;
+    limits.max_mse = argc > 3 ? std::atof(argv[3]) : 1e-7;
+    limits.min_encode_mbps = argc > 4 ? std::atof(argv[4]) : 0.0;
+    std::optional<size_t> best = lossy::best_for(rows, limits);
+
+    plotSweetSpot(distribution, rows, front, best ? int(*best) : -1);
+
+    if (best) {
+        std::cout << "Sweet Spot: " << settingName(rows[*best])
+                  << " (Storage Savings: " << storageSavings(rows[*best])
+                  << "%, MSE: " << rows[*best].mse
+                  << ", encode " << rows[*best].encode_mbps << " MB/s)" << std::endl;
+    } else {
+        std::cout << "No setting meets MSE < " << limits.max_mse
+                  << " and encode >= " << limits.min_encode_mbps << " MB/s" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+// Compares an original and a reconstructed raw .bin file without loading them.
+//
+// Usage: ./bin_compare <original.bin> <reconstructed.bin> [format] [format|auto] [threads] [mmap|pread]
+//
+// Both files are streamed in fixed-size blocks, so files far larger than RAM
+// can be checked after the fact. With "auto" (the default) the reconstructed
+// file is read as float16 when it is half the size of the original. A format
+// is f32, f16, bf16, e4m3, e5m2 or e8m15 (minifloat.h).
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include "lossy/stream_metrics.h"
+
+//This is to parse a format argument; auto picks float16 when the file is half the original's size
+lossy::Precision parseFormat(const std::string &arg, const std::string &file, size_t original_elements) {
+    if (arg != "auto") return lossy::parse_precision(arg);
+    if (std::filesystem::file_size(file) == original_elements * sizeof(uint16_t)) return lossy::Precision::Float16;
+    return lossy::Precision::Float32;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <original.bin> <reconstructed.bin> [format] [format|auto] [threads] [mmap|pread]\n";
+        return 1;
+    }
+    try {
+        std::string original = argv[1], reconstructed = argv[2];
+        lossy::Precision original_format = parseFormat(argc > 3 ? argv[3] : "f32", original, 0);
+        size_t elements = std::filesystem::file_size(original) / lossy::precision_bytes(original_format);
+        lossy::Precision reconstructed_format = parseFormat(argc > 4 ? argv[4] : "auto", reconstructed, elements);
+        lossy::ThreadPool pool(argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 0);
+        lossy::StreamOptions options;
+        options.use_mmap = !(argc > 6 && std::string(argv[6]) == "pread");
+
+        auto t0 = std::chrono::steady_clock::now();
+        lossy::ErrorMetrics m = lossy::compare_files(original, original_format, reconstructed, reconstructed_format,
+                                                     pool, options);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        double bytes = double(m.count) * (lossy::precision_bytes(original_format) +
+                                          lossy::precision_bytes(reconstructed_format));
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+
+        std::cout << "Elements: " << m.count << " (" << lossy::precision_name(original_format) << " vs "
+                  << lossy::precision_name(reconstructed_format) << ", " << (options.use_mmap ? "mmap" : "pread") << ", "
+                  << pool.size() << " threads)\n";
+        std::cout << "Original: Mean = " << m.mean_original << ", Std Dev = " << m.std_original << "\n";
+        std::cout << "Reconstructed: Mean = " << m.mean_reconstructed << ", Std Dev = " << m.std_reconstructed << "\n";
+        std::cout << "Mean Squared Error: " << m.mse << "\n";
+        std::cout << "Mean Absolute Error: " << m.mae << "\n";
+        std::cout << "Maximum Absolute Error: " << m.max_abs_error << "\n";
+        std::cout << "PSNR: " << m.psnr << " dB\n";
+        std::cout << "Clipped: " << m.overflowed << " to Inf/NaN, " << m.underflowed << " flushed to zero\n";
+        std::cout << "Read " << bytes / 1e9 << " GB in " << seconds << " s (" << bytes / 1e9 / seconds
+                  << " GB/s), peak RSS " << usage.ru_maxrss / 1024.0 << " MB\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Generates a synthetic dataset straight into a .lfc container in constant memory.
+//
+// Usage: ./lfc_generate <out.lfc> [--dist gaussian] [--n 1e6] [--codec shuffle-gzip] [--bits 10]
+//                       [--chunk 262144] [--threads 0] [--seed 42] [--metrics 1] [--async 0]
+//                       [--check 0]
+//
+// The values are drawn block by block, truncated, encoded on the pool and
+// written in order by stream_to_container() (stream_pipeline.h), so memory
+// stays at a few chunks for any --n: 1e10 floats need no 40 GB array. The
+// codec is any name of parse_codec_config() (sweep.h); --chunk must be a
+// multiple of 65536. --async 1 writes through an AsyncWriter. --check 1
+// also builds the same container the in-memory way (generate(), then
+// write_parallel()) and checks that both files and the metrics are identical,
+// that an encoding error in the stream reaches the caller, and that the reader
+// rejects a footer version or chunk shuffle it does not know; it needs the
+// whole array, so keep --n small with it.
+
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "lossy/pipeline.h"
+#include "lossy/stream_pipeline.h"
+#include "lossy/sweep.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <out.lfc> [--dist name] [--n count] [--codec name] [--bits n] [--chunk n] [--threads n]"
+                     " [--seed n] [--metrics 0|1] [--async 0|1] [--check 0|1]\n";
+        return 1;
+    }
+    std::string output = argv[1], dist = "gaussian", codec = "shuffle-gzip";
+    uint64_t n = 1000000, seed = lossy::kDefaultSeed;
+    size_t chunk = size_t(1) << 18, threads = 0;
+    int bits = 10;
+    bool metrics = true, async = false, check = false;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string key = argv[i], value = argv[i + 1];
+        if (key == "--dist") dist = value;
+        else if (key == "--n") n = uint64_t(std::stod(value));
+        else if (key == "--codec") codec = value;
+        else if (key == "--bits") bits = std::atoi(value.c_str());
+        else if (key == "--chunk") chunk = std::strtoull(value.c_str(), nullptr, 10);
+        else if (key == "--threads") threads = std::strtoull(value.c_str(), nullptr, 10);
+        else if (key == "--seed") seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (key == "--metrics") metrics = value != "0";
+        else if (key == "--async") async = value != "0";
+        else if (key == "--check") check = value != "0";
+        else {
+            std::cerr << "Unknown option " << key << "\n";
+            return 1;
+        }
+    }
+
+    try {
+        lossy::ContainerOptions opt = lossy::parse_codec_config(codec).options;
+        opt.bits_to_zero = bits;
+        opt.chunk_elements = chunk;
+        lossy::ThreadPool pool(threads);
+        lossy::StreamPipelineOptions sopt;
+        sopt.metrics = metrics || check;
+
+        lossy::StreamPipelineStats stats;
+        {
+            std::unique_ptr<lossy::ContainerWriter> writer =
+                async ? std::make_unique<lossy::ContainerWriter>(output, opt, lossy::AsyncWriterOptions{})
+                      : std::make_unique<lossy::ContainerWriter>(output, opt);
+            bool known = lossy::with_distribution(dist, [&](auto d) {
+                stats = lossy::stream_generated<decltype(d)>(*writer, n, seed, pool, sopt);
+            });
+            if (!known) throw std::runtime_error("unknown distribution: " + dist);
+            writer->close();
+            stats.bytes_written = writer->bytes_written();
+        }
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        const double mb = n * sizeof(float) / 1e6;
+        std::cout << "Elements: " << n << " (" << dist << ", " << mb << " MB), codec " << codec << ", bits " << bits
+                  << ", chunk " << chunk << ", " << pool.size() << " threads" << (async ? ", async" : "") << "\n";
+        std::cout << "Wrote " << output << ": " << stats.bytes_written / 1e6 << " MB in " << stats.chunks
+                  << " chunks, ratio " << (stats.bytes_written ? mb * 1e6 / stats.bytes_written : 0.0) << "\n";
+        std::cout << "Time: " << stats.seconds << " s (" << stats.mbps() << " MB/s); busy s: generate "
+                  << stats.source_seconds << ", truncate " << stats.truncate_seconds << ", encode "
+                  << stats.encode_seconds << ", write " << stats.write_seconds << "\n";
+        std::cout << "Memory: " << stats.blocks << " blocks, " << stats.block_bytes / 1e6 << " MB of buffers, "
+                  << stats.peak_payload_bytes / 1e6 << " MB of payloads at most, peak RSS "
+                  << usage.ru_maxrss / 1024.0 << " MB\n";
+        if (sopt.metrics)
+            std::cout << "MSE " << stats.metrics.mse << ", max error " << stats.metrics.max_abs_error << ", PSNR "
+                      << stats.metrics.psnr << " dB\n";
+
+        if (!check) return 0;
+        // The in-memory way: the whole array, write_parallel(), then metrics of the decoded file
+        const std::string reference = output + ".ref";
+        std::vector<float> data;
+        lossy::with_distribution(dist, [&](auto d) { data = lossy::generate<float, decltype(d)>(n, seed, pool); });
+        {
+            lossy::ContainerWriter writer(reference, opt);
+            lossy::write_parallel(writer, data, pool);
+            writer.close();
+        }
+        std::vector<float> decoded = lossy::ContainerReader(reference).read(0, n);
+        lossy::ErrorMetrics m = lossy::compute_metrics(data, decoded, pool, lossy::precision_max(opt.precision));
+        const bool same_file = lossy::file_crc32(output) == lossy::file_crc32(reference);
+
+        // Overwrite one byte of the reference file; reading it back must fail
+        auto rejects = [&](size_t offset, uint8_t value) {
+            std::fstream file(reference, std::ios::in | std::ios::out | std::ios::binary);
+            char old = 0;
+            file.seekg(std::streamoff(offset));
+            file.get(old);
+            file.seekp(std::streamoff(offset));
+            file.put(char(value));
+            file.close();
+            bool rejected = false;
+            try {
+                lossy::ContainerReader(reference).read(0, n);
+            } catch (const std::runtime_error &) {
+                rejected = true;
+            }
+            file.open(reference, std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(std::streamoff(offset));
+            file.put(old);
+            return rejected;
+        };
+        const size_t footer = lossy::ContainerReader(reference).file_bytes() - sizeof(lossy::Footer);
+        const bool rejected = rejects(footer + offsetof(lossy::Footer, version), lossy::kContainerVersion + 1) &&
+                              rejects(sizeof(lossy::FileHeader) + offsetof(lossy::ChunkHeader, shuffle), 7);
+        const bool same_metrics = m.count == stats.metrics.count && m.mse == stats.metrics.mse &&
+                                  m.mae == stats.metrics.mae && m.max_abs_error == stats.metrics.max_abs_error &&
+                                  m.mean_original == stats.metrics.mean_original &&
+                                  m.std_original == stats.metrics.std_original &&
+                                  m.mean_reconstructed == stats.metrics.mean_reconstructed &&
+                                  m.std_reconstructed == stats.metrics.std_reconstructed;
+        std::remove(reference.c_str());
+        std::cout << "Matches the in-memory container: " << (same_file ? "yes" : "NO") << ", metrics: "
+                  << (same_metrics ? "yes" : "NO") << "\n";
+        std::cout << "Unknown footer version and chunk shuffle rejected: " << (rejected ? "yes" : "NO") << "\n";
+
+        // Gorilla refuses float16 storage, so every block fails on the pool
+        bool reported = false;
+        {
+            lossy::ContainerOptions bad = opt;
+            bad.codec = lossy::Codec::Gorilla;
+            bad.precision = lossy::Precision::Float16;
+            lossy::ContainerWriter writer(reference, bad);
+            try {
+                lossy::with_distribution(dist, [&](auto d) {
+                    lossy::stream_generated<decltype(d)>(writer, n, seed, pool, sopt);
+                });
+            } catch (const std::runtime_error &) {
+                reported = true;
+            }
+        }
+        std::remove(reference.c_str());
+        std::cout << "Encoding errors reach the caller: " << (reported ? "yes" : "NO") << "\n";
+        return same_file && same_metrics && rejected && reported ? 0 : 1;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
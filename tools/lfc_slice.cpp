@@ -0,0 +1,41 @@
+// Prints the layout of a .lfc container and decodes an element range from it.
+//
+// Usage: ./lfc_slice <file.lfc> [first] [count]
+//
+// Only the chunks overlapping [first, first + count) are read from disk.
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "lossy/container.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.lfc> [first] [count]\n";
+        return 1;
+    }
+    try {
+        lossy::ContainerReader reader(argv[1]);
+        std::cout << "Elements: " << reader.size() << ", chunks: " << reader.chunk_count()
+                  << " x " << reader.chunk_elements() << ", file: " << reader.file_bytes() / 1024.0 << " KB\n";
+        for (size_t i = 0; i < reader.chunk_count(); i++) {
+            lossy::ChunkHeader h = reader.chunk_header(i);
+            std::cout << "  chunk " << i << ": first " << h.first_element << ", " << h.element_count << " values, "
+                      << lossy::codec_name(lossy::Codec(h.codec)) << "/" << lossy::shuffle_name(lossy::Shuffle(h.shuffle))
+                      << ", " << lossy::precision_name(lossy::Precision(h.precision))
+                      << ", " << int(h.bits_kept) << " mantissa bits, " << h.compressed_length << " bytes\n";
+        }
+
+        size_t first = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+        size_t count = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 10;
+        if (first > reader.size()) first = reader.size();
+        if (count > reader.size() - first) count = reader.size() - first;
+        std::vector<float> values = reader.read(first, count);
+        for (size_t i = 0; i < values.size(); i++) std::cout << "[" << first + i << "] " << values[i] << "\n";
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Prints the Pareto front of a sweep CSV and answers a constrained query.
+//
+// Usage: ./pareto_select <sweep.csv> [--dist gaussian] [--threads 4] [--max-mse 1e-8]
+//                        [--max-error 1e-3] [--min-ratio 1.5] [--min-encode 2000]
+//                        [--min-decode 2000] [--front front.csv]
+//
+// The front is taken over ratio, MSE and encode/decode speed of the rows that
+// match --dist/--threads. The answer is the smallest output (highest ratio)
+// meeting every limit; --front writes the front rows back out as a sweep CSV.
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "lossy/pareto.h"
+
+void printRow(const lossy::SweepResult &r) {
+    std::cout << std::left << std::setw(12) << r.distribution << std::setw(16) << r.codec << "bits " << std::setw(3)
+              << r.bits_to_zero << r.threads << " thr  ratio " << std::setw(9) << r.ratio << " MSE " << std::setw(12)
+              << r.mse << " max " << std::setw(12) << r.max_abs_error << " enc " << std::setw(9) << r.encode_mbps
+              << " dec " << r.decode_mbps << " MB/s\n";
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <sweep.csv> [--dist name] [--threads n] [--max-mse x] [--max-error x] [--min-ratio x]"
+                     " [--min-encode MB/s] [--min-decode MB/s] [--front front.csv]\n";
+        return 1;
+    }
+    try {
+        lossy::Constraints limits, scope;
+        std::string front_file;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            std::string key = argv[i];
+            const char *value = argv[i + 1];
+            if (key == "--dist") scope.distribution = value;
+            else if (key == "--threads") scope.threads = std::strtoull(value, nullptr, 10);
+            else if (key == "--max-mse") limits.max_mse = std::atof(value);
+            else if (key == "--max-error") limits.max_abs_error = std::atof(value);
+            else if (key == "--min-ratio") limits.min_ratio = std::atof(value);
+            else if (key == "--min-encode") limits.min_encode_mbps = std::atof(value);
+            else if (key == "--min-decode") limits.min_decode_mbps = std::atof(value);
+            else if (key == "--front") front_file = value;
+            else {
+                std::cerr << "Unknown option " << key << "\n";
+                return 1;
+            }
+        }
+
+        std::vector<lossy::SweepResult> rows = lossy::filter_rows(lossy::read_sweep_csv(argv[1]), scope);
+        std::vector<size_t> front = lossy::pareto_front(rows);
+        std::cout << "Pareto front (" << front.size() << " of " << rows.size() << " rows):\n";
+        std::vector<lossy::SweepResult> front_rows;
+        for (size_t i : front) {
+            printRow(rows[i]);
+            front_rows.push_back(rows[i]);
+        }
+        if (!front_file.empty()) lossy::write_sweep_csv(front_file, front_rows);
+
+        std::optional<size_t> best = lossy::best_for(rows, limits);
+        std::cout << "\nSmallest output meeting the limits: ";
+        if (best) {
+            std::cout << "\n";
+            printRow(rows[*best]);
+        } else {
+            std::cout << "none\n";
+        }
+        return best ? 0 : 2;
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}